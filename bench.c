@@ -0,0 +1,414 @@
+/*
+ * bench.c — Cycle-accurate h11_parse benchmark over a request corpus
+ *
+ * Usage: h11_bench [-n iters] [-w warmup] [-c cpu] [-f table|csv|json] [-s] [-p] [-b] [-k] [-l] [path...]
+ * Each path is a request file or a directory of them (default:
+ * sample_requests). Every sample is parsed to completion, including its
+ * body, from a 64-byte aligned buffer; only the parse is timed.
+ *
+ * -s repeats the run under every SIMD level the host supports, prints the
+ * median speedup of each level over scalar, and fails if any level ends a
+ * sample with a different status than scalar.
+ *
+ * -p parses with H11_CFG_PADDED_INPUT; every sample buffer already carries
+ * at least H11_INPUT_PADDING bytes of slack.
+ *
+ * -b parses with H11_CFG_BLOCK_VALIDATE.
+ *
+ * -k parses with H11_CFG_SHAPE_CACHE. Every sample is parsed over and over on
+ * one parser, so this times the keep-alive case where all names repeat.
+ *
+ * -l parses with H11_CFG_LAZY_HEADERS and never touches the lazy fields.
+ */
+#define _GNU_SOURCE
+#include "h11.h"
+#include "clock_cycles.h"
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SAMPLES 1024
+
+typedef enum { FMT_TABLE, FMT_CSV, FMT_JSON } out_fmt_t;
+
+typedef struct {
+    char       *name;
+    char       *buf;
+    usize       len;
+} sample_t;
+
+typedef struct {
+    h11_error_t status;
+    u64         median;
+    u64         p99;
+    u64         min;
+} result_t;
+
+typedef struct {
+    u32       iters;
+    u32       warmup;
+    int       cpu;
+    out_fmt_t fmt;
+    bool      all_levels;
+    bool      padded;
+    bool      block;
+    bool      shape;
+    bool      lazy;
+} bench_opts_t;
+
+static sample_t samples[MAX_SAMPLES];
+static u32 sample_count;
+
+static int cmp_u64(const void *a, const void *b) {
+    u64 x = *(const u64 *)a, y = *(const u64 *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_sample(const void *a, const void *b) {
+    return strcmp(((const sample_t *)a)->name, ((const sample_t *)b)->name);
+}
+
+static int load_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return -1;
+    }
+    long flen = ftell(f);
+    if (flen <= 0 || sample_count == MAX_SAMPLES || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return flen == 0 ? 0 : -1;
+    }
+    usize len = (usize)flen;
+    /* Round up with a spare cache line so vector scanners never straddle
+     * into another allocation's line; it doubles as the -p padding. */
+    char *buf = aligned_alloc(64, (len + H11_INPUT_PADDING + 63) & ~(usize)63);
+    if (buf == NULL || fread(buf, 1, len, f) != len) {
+        free(buf);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    memset(buf + len, 0, H11_INPUT_PADDING);
+    const char *slash = strrchr(path, '/');
+    samples[sample_count].name = strdup(slash != NULL ? slash + 1 : path);
+    samples[sample_count].buf = buf;
+    samples[sample_count].len = len;
+    sample_count++;
+    return 0;
+}
+
+static int load_path(const char *path) {
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return load_file(path);
+    struct dirent *e;
+    char full[4096];
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.')
+            continue;
+        snprintf(full, sizeof(full), "%s/%s", path, e->d_name);
+        if (load_file(full) != 0)
+            fprintf(stderr, "h11_bench: skipping %s\n", full);
+    }
+    closedir(d);
+    return 0;
+}
+
+/* Parse one complete request, body included; the same loop a server runs. */
+static h11_error_t parse_once(h11_parser_t *p, const char *buf, usize len) {
+    usize off = 0;
+    for (;;) {
+        usize c = 0;
+        h11_error_t err = h11_parse(p, buf + off, len - off, &c);
+        off += c;
+        if (err != H11_OK || h11_get_state(p) == H11_STATE_COMPLETE)
+            return err;
+        const char *body;
+        usize body_len;
+        err = h11_read_body(p, buf + off, len - off, &c, &body, &body_len);
+        off += c;
+        if (err != H11_OK)
+            return err;
+    }
+}
+
+/* Smallest back-to-back rdtsc_start/rdtsc_end interval, subtracted from
+ * every sample so that small requests are not dominated by fencing. */
+static u64 timer_overhead(void) {
+    u64 best = UINT64_MAX;
+    for (int i = 0; i < 10000; i++) {
+        u64 t0 = rdtsc_start();
+        u64 t1 = rdtsc_end();
+        if (t1 - t0 < best)
+            best = t1 - t0;
+    }
+    return best;
+}
+
+static void bench_sample(h11_parser_t *p, const sample_t *s, const bench_opts_t *o,
+                         u64 overhead, u64 *cycles, result_t *r) {
+    h11_error_t status = H11_OK;
+    for (u32 i = 0; i < o->warmup; i++) {
+        h11_parser_reset(p);
+        status = parse_once(p, s->buf, s->len);
+    }
+    for (u32 i = 0; i < o->iters; i++) {
+        h11_parser_reset(p);
+        u64 t0 = rdtsc_start();
+        status = parse_once(p, s->buf, s->len);
+        u64 t1 = rdtsc_end();
+        u64 dt = t1 - t0;
+        cycles[i] = dt > overhead ? dt - overhead : 0;
+    }
+    qsort(cycles, o->iters, sizeof(*cycles), cmp_u64);
+    r->status = status;
+    r->min = cycles[0];
+    r->median = cycles[o->iters / 2];
+    r->p99 = cycles[(u64)o->iters * 99 / 100];
+}
+
+static int run_corpus(const bench_opts_t *o, result_t *results) {
+    h11_config_t cfg = h11_config_default();
+    if (o->padded)
+        cfg.flags |= H11_CFG_PADDED_INPUT;
+    if (o->block)
+        cfg.flags |= H11_CFG_BLOCK_VALIDATE;
+    if (o->shape)
+        cfg.flags |= H11_CFG_SHAPE_CACHE;
+    if (o->lazy)
+        cfg.flags |= H11_CFG_LAZY_HEADERS;
+    h11_parser_t *p = h11_parser_new(&cfg);
+    u64 *cycles = malloc(sizeof(*cycles) * o->iters);
+    if (p == NULL || cycles == NULL) {
+        free(cycles);
+        h11_parser_free(p);
+        return -1;
+    }
+    u64 overhead = timer_overhead();
+    for (u32 i = 0; i < sample_count; i++)
+        bench_sample(p, &samples[i], o, overhead, cycles, &results[i]);
+    free(cycles);
+    h11_parser_free(p);
+    return 0;
+}
+
+static void print_results(const bench_opts_t *o, const result_t *r) {
+    u64 total_median = 0, total_bytes = 0;
+    if (o->fmt == FMT_CSV)
+        printf("sample,bytes,status,median_cycles,p99_cycles,min_cycles,cycles_per_byte\n");
+    else if (o->fmt == FMT_JSON)
+        printf("{\"iters\":%u,\"warmup\":%u,\"cpu\":%d,\"samples\":[\n", o->iters, o->warmup, o->cpu);
+    else
+        printf("%-28s %8s %10s %10s %10s %8s  %s\n", "sample", "bytes", "median", "p99", "min",
+               "cyc/B", "status");
+    for (u32 i = 0; i < sample_count; i++) {
+        const sample_t *s = &samples[i];
+        double cpb = (double)r[i].median / (double)s->len;
+        total_median += r[i].median;
+        total_bytes += s->len;
+        if (o->fmt == FMT_CSV) {
+            printf("%s,%zu,%s,%llu,%llu,%llu,%.3f\n", s->name, s->len,
+                   h11_error_name(r[i].status), (unsigned long long)r[i].median,
+                   (unsigned long long)r[i].p99, (unsigned long long)r[i].min, cpb);
+        } else if (o->fmt == FMT_JSON) {
+            printf("  {\"sample\":\"%s\",\"bytes\":%zu,\"status\":\"%s\",\"median_cycles\":%llu,"
+                   "\"p99_cycles\":%llu,\"min_cycles\":%llu,\"cycles_per_byte\":%.3f}%s\n",
+                   s->name, s->len, h11_error_name(r[i].status),
+                   (unsigned long long)r[i].median, (unsigned long long)r[i].p99,
+                   (unsigned long long)r[i].min, cpb, i + 1 < sample_count ? "," : "");
+        } else {
+            printf("%-28s %8zu %10llu %10llu %10llu %8.3f  %s\n", s->name, s->len,
+                   (unsigned long long)r[i].median, (unsigned long long)r[i].p99,
+                   (unsigned long long)r[i].min, cpb, h11_error_name(r[i].status));
+        }
+    }
+    double total_cpb = total_bytes ? (double)total_median / (double)total_bytes : 0.0;
+    if (o->fmt == FMT_JSON)
+        printf("],\"total_median_cycles\":%llu,\"total_bytes\":%llu,\"cycles_per_byte\":%.3f}\n",
+               (unsigned long long)total_median, (unsigned long long)total_bytes, total_cpb);
+    else if (o->fmt == FMT_TABLE)
+        printf("%-28s %8llu %10llu %10s %10s %8.3f\n", "total", (unsigned long long)total_bytes,
+               (unsigned long long)total_median, "", "", total_cpb);
+}
+
+static double speedup(u64 base, u64 v) {
+    return v != 0 ? (double)base / (double)v : 0.0;
+}
+
+/* r[lv * sample_count + i] holds sample i under level lv. */
+static void print_levels(const bench_opts_t *o, const result_t *r, u32 levels) {
+    u64 total[H11_SIMD_AVX512 + 1] = { 0 };
+    for (u32 lv = 0; lv < levels; lv++) {
+        for (u32 i = 0; i < sample_count; i++)
+            total[lv] += r[lv * sample_count + i].median;
+    }
+    if (o->fmt == FMT_CSV) {
+        printf("sample,bytes,level,median_cycles,p99_cycles,speedup_vs_scalar\n");
+        for (u32 i = 0; i < sample_count; i++) {
+            for (u32 lv = 0; lv < levels; lv++) {
+                const result_t *x = &r[lv * sample_count + i];
+                printf("%s,%zu,%s,%llu,%llu,%.3f\n", samples[i].name, samples[i].len,
+                       h11_simd_name((h11_simd_level_t)lv), (unsigned long long)x->median,
+                       (unsigned long long)x->p99, speedup(r[i].median, x->median));
+            }
+        }
+        return;
+    }
+    if (o->fmt == FMT_JSON) {
+        printf("{\"iters\":%u,\"warmup\":%u,\"cpu\":%d,\"levels\":[\n", o->iters, o->warmup,
+               o->cpu);
+        for (u32 lv = 0; lv < levels; lv++) {
+            printf("  {\"level\":\"%s\",\"total_median_cycles\":%llu,"
+                   "\"speedup_vs_scalar\":%.3f}%s\n",
+                   h11_simd_name((h11_simd_level_t)lv), (unsigned long long)total[lv],
+                   speedup(total[0], total[lv]), lv + 1 < levels ? "," : "");
+        }
+        printf("]}\n");
+        return;
+    }
+    printf("%-28s %8s", "sample", "bytes");
+    for (u32 lv = 0; lv < levels; lv++)
+        printf(" %10s %6s", h11_simd_name((h11_simd_level_t)lv), "x");
+    printf("\n");
+    for (u32 i = 0; i < sample_count; i++) {
+        printf("%-28s %8zu", samples[i].name, samples[i].len);
+        for (u32 lv = 0; lv < levels; lv++) {
+            u64 m = r[lv * sample_count + i].median;
+            printf(" %10llu %6.2f", (unsigned long long)m, speedup(r[i].median, m));
+        }
+        printf("\n");
+    }
+    printf("%-28s %8s", "total", "");
+    for (u32 lv = 0; lv < levels; lv++)
+        printf(" %10llu %6.2f", (unsigned long long)total[lv], speedup(total[0], total[lv]));
+    printf("\n");
+}
+
+/* Differential check: every level must end every sample the same way. */
+static int check_levels(const result_t *r, u32 levels) {
+    int bad = 0;
+    for (u32 lv = 1; lv < levels; lv++) {
+        for (u32 i = 0; i < sample_count; i++) {
+            h11_error_t want = r[i].status, got = r[lv * sample_count + i].status;
+            if (got != want) {
+                fprintf(stderr, "h11_bench: %s: %s under %s, %s under scalar\n",
+                        samples[i].name, h11_error_name(got),
+                        h11_simd_name((h11_simd_level_t)lv), h11_error_name(want));
+                bad = 1;
+            }
+        }
+    }
+    return bad;
+}
+
+static void pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        fprintf(stderr, "h11_bench: could not pin to cpu %d, timings may be noisy\n", cpu);
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-n iters] [-w warmup] [-c cpu] [-f table|csv|json] [-s] [-p] [-b] "
+            "[-k] [-l] [path...]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    bench_opts_t o = { .iters = 10000, .warmup = 1000, .cpu = 0, .fmt = FMT_TABLE };
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            o.all_levels = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            o.padded = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-b") == 0) {
+            o.block = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-k") == 0) {
+            o.shape = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-l") == 0) {
+            o.lazy = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        const char *v = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'n': o.iters = (u32)strtoul(v, NULL, 10); break;
+        case 'w': o.warmup = (u32)strtoul(v, NULL, 10); break;
+        case 'c': o.cpu = atoi(v); break;
+        case 'f':
+            if (strcmp(v, "csv") == 0)
+                o.fmt = FMT_CSV;
+            else if (strcmp(v, "json") == 0)
+                o.fmt = FMT_JSON;
+            else if (strcmp(v, "table") == 0)
+                o.fmt = FMT_TABLE;
+            else
+                return usage(argv[0]);
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (o.iters == 0)
+        return usage(argv[0]);
+    if (i == argc)
+        load_path("sample_requests");
+    for (; i < argc; i++)
+        load_path(argv[i]);
+    if (sample_count == 0) {
+        fprintf(stderr, "h11_bench: no samples loaded\n");
+        return 1;
+    }
+    qsort(samples, sample_count, sizeof(samples[0]), cmp_sample);
+
+    pin_cpu(o.cpu);
+    u32 levels = o.all_levels ? (u32)h11_simd_supported() + 1 : 1;
+    result_t *results = calloc((usize)sample_count * levels, sizeof(*results));
+    if (results == NULL)
+        return 1;
+    int rc = 0;
+    for (u32 lv = 0; lv < levels && rc == 0; lv++) {
+        if (o.all_levels)
+            h11_simd_force((h11_simd_level_t)lv);
+        if (run_corpus(&o, results + (usize)lv * sample_count) != 0)
+            rc = 1;
+    }
+    if (rc == 0 && o.all_levels) {
+        print_levels(&o, results, levels);
+        rc = check_levels(results, levels);
+        h11_simd_calibration_t cal;
+        h11_simd_calibrate(&cal);
+        fprintf(stderr, "h11_bench: calibration picks %s in %llu ns (", h11_simd_name(cal.chosen),
+                (unsigned long long)cal.elapsed_ns);
+        for (u32 lv = 0; lv < levels; lv++)
+            fprintf(stderr, "%s%s %u MB/s", lv ? ", " : "", h11_simd_name((h11_simd_level_t)lv),
+                    cal.mb_per_s[lv]);
+        fprintf(stderr, ")\n");
+    } else if (rc == 0) {
+        print_results(&o, results);
+    }
+    free(results);
+    for (u32 k = 0; k < sample_count; k++) {
+        free(samples[k].name);
+        free(samples[k].buf);
+    }
+    return rc;
+}
@@ -0,0 +1,94 @@
+/*
+ * cookie.c — Cookie header parsing (RFC 6265 S4.2) with per-name lookup
+ */
+#include "h11_internal.h"
+#include <string.h>
+
+H11_INLINE u32 skip_ows(const char *p, u32 i, u32 end) {
+    while (i < end && h11_is_ows(p[i]))
+        i++;
+    return i;
+}
+
+H11_INLINE u32 trim_ows_end(const char *p, u32 start, u32 end) {
+    while (end > start && h11_is_ows(p[end - 1]))
+        end--;
+    return end;
+}
+
+/* Value ends at the next ';' (or the end of the field); a DQUOTE pair around
+ * the cookie-value is stripped. */
+static h11_span_t cookie_value(const char *p, u32 off, u32 start, u32 len, u32 *next) {
+    u32 semi = start + (u32)h11_find_char(p + start, len - start, ';');
+    *next = semi < len ? semi + 1 : len;
+    u32 vs = skip_ows(p, start, semi);
+    u32 ve = trim_ows_end(p, vs, semi);
+    if (ve - vs >= 2 && p[vs] == '"' && p[ve - 1] == '"') {
+        vs++;
+        ve--;
+    }
+    return (h11_span_t){ .off = off + vs, .len = ve - vs };
+}
+
+bool h11_cookie_next(const char *base, const h11_header_t *header, u32 *pos,
+                     h11_span_t *name, h11_span_t *value) {
+    if (base == NULL || header == NULL || pos == NULL || name == NULL || value == NULL)
+        return false;
+    const u32 off = header->value.off;
+    const u32 len = header->value.len;
+    const char *p = base + off;
+    u32 i = *pos;
+    while (i < len) {
+        u32 start = skip_ows(p, i, len);
+        u32 delim = start + (u32)h11_find_char2(p + start, len - start, ';', '=');
+        u32 nend = trim_ows_end(p, start, delim);
+        if (delim < len && p[delim] == '=') {
+            *value = cookie_value(p, off, delim + 1, len, &i);
+        } else {
+            i = delim < len ? delim + 1 : len;
+            *value = (h11_span_t){ .off = off + nend, .len = 0 };
+        }
+        if (nend == start && value->len == 0)
+            continue;
+        name->off = off + start;
+        name->len = nend - start;
+        *pos = i;
+        return true;
+    }
+    *pos = len;
+    return false;
+}
+
+bool h11_cookie_find(const char *base, const h11_header_t *header, const char *name,
+                     h11_span_t *value) {
+    if (base == NULL || header == NULL || name == NULL || value == NULL || name[0] == '\0')
+        return false;
+    const u32 off = header->value.off;
+    const u32 len = header->value.len;
+    const char *p = base + off;
+    const usize nlen = strlen(name);
+    u32 i = 0;
+    while (i < len) {
+        i = skip_ows(p, i, len);
+        /* First byte and the '=' that must follow a name of this length
+         * reject almost every non-matching pair before the full compare. */
+        if (len - i > nlen && p[i] == name[0] && p[i + nlen] == '=' &&
+            memcmp(p + i, name, nlen) == 0) {
+            u32 next;
+            *value = cookie_value(p, off, i + (u32)nlen + 1, len, &next);
+            return true;
+        }
+        i += (u32)h11_find_char(p + i, len - i, ';') + 1;
+    }
+    return false;
+}
+
+bool h11_request_cookie(const h11_request_t *req, const char *base, const char *name,
+                        h11_span_t *value) {
+    for (int i = h11_find_header_next(req, base, "cookie", -1); i >= 0;
+         i = h11_find_header_next(req, base, "cookie", i)) {
+        if (h11_cookie_find(base, &req->headers[i], name, value))
+            return true;
+    }
+    return false;
+}
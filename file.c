@@ -0,0 +1,663 @@
+/*
+ * file.c — Static file responder: a per-thread cache of open files with
+ *          pre-built response heads, conditional GET, single byte ranges,
+ *          and a sendfile body path
+ */
+#define _GNU_SOURCE
+#include "h11_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#if defined(__has_include)
+#if __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#define H11_OPENAT2 1
+#endif
+#endif
+#endif
+
+enum { PATH_MAX_LEN = 1024, SEND_CHUNK = 1u << 20 };
+
+/* How long a cache hit is trusted before the path is stat'ed again. */
+#define FILE_RECHECK_NS 1000000000ull
+
+/* An entry leaves the table when it is evicted but is only freed once the
+ * last reference from h11_file_open is released, so a reply still being
+ * written keeps its head, data and fd. dev, ino and mtim identify the file
+ * that was opened, for the recheck against the disk. */
+typedef struct file_entry {
+    h11_file_t         f;
+    u32                hash;
+    u32                path_len;
+    u32                refs;
+    bool               cached;
+    dev_t              dev;
+    ino_t              ino;
+    struct timespec    mtim;
+    u64                checked_ns;
+    struct file_entry *newer;
+    struct file_entry *older;
+    char               path[];
+} file_entry_t;
+
+struct h11_file_cache {
+    int            root;
+    u32            mask;
+    u32            count;
+    u32            max_files;
+    file_entry_t **slot;
+    file_entry_t  *newest;
+    file_entry_t  *oldest;
+};
+
+static const struct {
+    const char *ext;
+    const char *type;
+} mime_types[] = {
+    { "html", "text/html; charset=utf-8" },
+    { "htm", "text/html; charset=utf-8" },
+    { "css", "text/css; charset=utf-8" },
+    { "js", "text/javascript; charset=utf-8" },
+    { "mjs", "text/javascript; charset=utf-8" },
+    { "json", "application/json" },
+    { "txt", "text/plain; charset=utf-8" },
+    { "xml", "application/xml" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "webp", "image/webp" },
+    { "avif", "image/avif" },
+    { "ico", "image/x-icon" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "wasm", "application/wasm" },
+    { "pdf", "application/pdf" },
+    { "mp4", "video/mp4" },
+};
+
+static const char *mime_type(const char *path, usize len) {
+    usize dot = len;
+    while (dot > 0 && path[dot - 1] != '.' && path[dot - 1] != '/')
+        dot--;
+    if (dot > 0 && path[dot - 1] == '.') {
+        h11_span_t ext = { .off = (u32)dot, .len = (u32)(len - dot) };
+        for (usize i = 0; i < H11_ARRAY_LEN(mime_types); i++) {
+            usize n = strlen(mime_types[i].ext);
+            if (ext.len == n && h11_span_eq_case(path, ext, mime_types[i].ext, n))
+                return mime_types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static u32 path_hash(const char *p, usize len) {
+    u32 h = 2166136261u;
+    for (usize i = 0; i < len; i++)
+        h = (h ^ (u8)p[i]) * 16777619u;
+    return h;
+}
+
+/* An absolute path that cannot leave the root: no empty, "." or ".."
+ * segment (a trailing '/' aside), no NUL or backslash. */
+static bool path_ok(const char *p, usize len) {
+    if (len == 0 || len >= PATH_MAX_LEN || p[0] != '/')
+        return false;
+    usize seg = 1;
+    for (usize i = 1; i <= len; i++) {
+        if (i < len && p[i] != '/') {
+            if (p[i] == '\0' || p[i] == '\\')
+                return false;
+            continue;
+        }
+        usize n = i - seg;
+        if ((n == 0 && i < len) || (n == 1 && p[seg] == '.') || (n == 2 && p[seg] == '.' && p[seg + 1] == '.'))
+            return false;
+        seg = i + 1;
+    }
+    return true;
+}
+
+/* Percent-decodes a target path (RFC 3986 S2.1). '+' is not a space here,
+ * and an encoded '/' or NUL is refused: neither may sit inside a segment. */
+static bool path_decode(const char *p, usize len, char *out, usize *out_len) {
+    usize n = 0;
+    for (usize i = 0; i < len; i++, n++) {
+        char ch = p[i];
+        if (ch == '%') {
+            int hi, lo;
+            if (len - i < 3 || (hi = h11_hexval(p[i + 1])) < 0 || (lo = h11_hexval(p[i + 2])) < 0)
+                return false;
+            ch = (char)(hi << 4 | lo);
+            if (ch == '/' || ch == '\0')
+                return false;
+            i += 2;
+        }
+        if (n == PATH_MAX_LEN)
+            return false;
+        out[n] = ch;
+    }
+    *out_len = n;
+    return true;
+}
+
+h11_file_cache_t *h11_file_cache_new(const char *root, u32 max_files) {
+    if (root == NULL || max_files == 0 || max_files > (1u << 24))
+        return NULL;
+    h11_file_cache_t *c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return NULL;
+    u32 cap = 16;
+    while (cap < max_files + max_files / 3)
+        cap <<= 1;
+    c->slot = calloc(cap, sizeof(*c->slot));
+    c->root = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (c->slot == NULL || c->root < 0) {
+        int e = errno;
+        h11_file_cache_free(c);
+        errno = e;
+        return NULL;
+    }
+    c->mask = cap - 1;
+    c->max_files = max_files;
+    return c;
+}
+
+static void entry_free(file_entry_t *e) {
+    close(e->f.fd);
+    free(e->f.head);
+    free((void *)e->f.data);
+    free(e);
+}
+
+/* Entries are allocated by the cache; callers only get a const view. */
+static file_entry_t *entry_of(const h11_file_t *f) {
+    return (file_entry_t *)((const char *)f - offsetof(file_entry_t, f));
+}
+
+/* Drops the table's hold on e; an entry still referenced is freed by the
+ * last h11_file_release instead. */
+static void entry_uncache(file_entry_t *e) {
+    e->cached = false;
+    if (e->refs == 0)
+        entry_free(e);
+}
+
+void h11_file_cache_clear(h11_file_cache_t *c) {
+    if (c == NULL || c->slot == NULL)
+        return;
+    for (u32 i = 0; i <= c->mask; i++) {
+        if (c->slot[i] != NULL)
+            entry_uncache(c->slot[i]);
+        c->slot[i] = NULL;
+    }
+    c->count = 0;
+    c->newest = c->oldest = NULL;
+}
+
+void h11_file_release(const h11_file_t *f) {
+    if (f == NULL)
+        return;
+    file_entry_t *e = entry_of(f);
+    if (--e->refs == 0 && !e->cached)
+        entry_free(e);
+}
+
+void h11_file_cache_free(h11_file_cache_t *c) {
+    if (c == NULL)
+        return;
+    h11_file_cache_clear(c);
+    if (c->root >= 0)
+        close(c->root);
+    free(c->slot);
+    free(c);
+}
+
+/* Builds the 200 head:
+ *   status line | ETag, Last-Modified | Content-Type, Accept-Ranges |
+ *   Content-Length | CRLF
+ * and records where the validators and the rest of the metadata sit. */
+static bool build_head(h11_file_t *f, const struct stat *st, const char *path, usize len) {
+    char lm[40];
+    struct tm tm;
+    time_t mtime = st->st_mtim.tv_sec;
+    if (gmtime_r(&mtime, &tm) == NULL ||
+        strftime(lm, sizeof(lm), "%a, %d %b %Y %H:%M:%S GMT", &tm) == 0)
+        return false;
+    u64 mns = (u64)st->st_mtim.tv_sec * 1000000000u + (u64)st->st_mtim.tv_nsec;
+    char buf[H11_FILE_HEAD_MAX];
+    int s = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\n");
+    int n = snprintf(buf + s, sizeof(buf) - (usize)s, "ETag: \"%llx-%llx\"\r\n",
+                     (unsigned long long)mns, (unsigned long long)f->size);
+    f->etag = (h11_span_t){ .off = (u32)s + 6, .len = (u32)n - 8 };
+    f->last_modified = (h11_span_t){ .off = (u32)(s + n) + 15, .len = (u32)strlen(lm) };
+    n += snprintf(buf + s + n, sizeof(buf) - (usize)(s + n), "Last-Modified: %s\r\n", lm);
+    int vlen = n;
+    n += snprintf(buf + s + n, sizeof(buf) - (usize)(s + n),
+                  "Content-Type: %s\r\nAccept-Ranges: bytes\r\n", mime_type(path, len));
+    int meta = n;
+    n += snprintf(buf + s + n, sizeof(buf) - (usize)(s + n), "Content-Length: %llu\r\n\r\n",
+                  (unsigned long long)f->size);
+    if (s + n >= (int)sizeof(buf))
+        return false;
+    f->head = malloc((usize)(s + n));
+    if (f->head == NULL)
+        return false;
+    memcpy(f->head, buf, (usize)(s + n));
+    f->head_len = (u32)(s + n);
+    f->meta = (h11_span_t){ .off = (u32)s, .len = (u32)meta };
+    f->validators = (h11_span_t){ .off = (u32)s, .len = (u32)vlen };
+    return true;
+}
+
+static void close_keep_errno(int fd) {
+    int e = errno;
+    close(fd);
+    errno = e;
+}
+
+/* Opens rel under root without letting a symlink lead out of it:
+ * openat2(RESOLVE_BENEATH) where the kernel has it, else one component at a
+ * time with O_NOFOLLOW, which refuses symlinks altogether. */
+static int open_beneath(int root, char *rel) {
+    if (rel[0] == '/') {
+        errno = EINVAL;
+        return -1;
+    }
+#if defined(H11_OPENAT2)
+    struct open_how how = {
+        .flags = O_RDONLY | O_CLOEXEC | O_NOCTTY,
+        .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+    };
+    long r = syscall(SYS_openat2, root, rel, &how, sizeof(how));
+    if (r >= 0 || errno != ENOSYS)
+        return (int)r;
+#endif
+    int dir = root;
+    char *seg = rel;
+    for (char *slash; (slash = strchr(seg, '/')) != NULL; seg = slash + 1) {
+        *slash = '\0';
+        int next = openat(dir, seg, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        *slash = '/';
+        if (dir != root)
+            close_keep_errno(dir);
+        if (next < 0)
+            return -1;
+        dir = next;
+    }
+    int fd = openat(dir, seg, O_RDONLY | O_NOFOLLOW | O_CLOEXEC | O_NOCTTY);
+    if (dir != root)
+        close_keep_errno(dir);
+    return fd;
+}
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (u64)ts.tv_sec * 1000000000u + (u64)ts.tv_nsec;
+}
+
+/* The path relative to the root, with index.html after a trailing '/'. */
+static usize rel_path(const char *path, usize len, char *rel) {
+    memcpy(rel, path + 1, len - 1);
+    usize rlen = len - 1;
+    if (rlen == 0 || rel[rlen - 1] == '/') {
+        memcpy(rel + rlen, "index.html", 10);
+        rlen += 10;
+    }
+    rel[rlen] = '\0';
+    return rlen;
+}
+
+/* Whether the path still names the file e was opened from. Only metadata
+ * is read here; anything that changed is reopened through open_beneath. */
+static bool entry_fresh(h11_file_cache_t *c, file_entry_t *e, u64 now) {
+    char rel[PATH_MAX_LEN + 16];
+    rel_path(e->path, e->path_len, rel);
+    struct stat st;
+    if (fstatat(c->root, rel, &st, 0) != 0 || st.st_dev != e->dev || st.st_ino != e->ino ||
+        (u64)st.st_size != e->f.size || st.st_mtim.tv_sec != e->mtim.tv_sec ||
+        st.st_mtim.tv_nsec != e->mtim.tv_nsec)
+        return false;
+    e->checked_ns = now;
+    return true;
+}
+
+static file_entry_t *entry_open(h11_file_cache_t *c, const char *path, usize len, u32 hash) {
+    char rel[PATH_MAX_LEN + 16];
+    usize rlen = rel_path(path, len, rel);
+    int fd = open_beneath(c->root, rel);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    int err = 0;
+    if (fstat(fd, &st) != 0)
+        err = errno;
+    else if (!S_ISREG(st.st_mode))
+        err = S_ISDIR(st.st_mode) ? EISDIR : EACCES;
+    if (err != 0) {
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    file_entry_t *e = calloc(1, sizeof(*e) + len);
+    if (e == NULL) {
+        close(fd);
+        return NULL;
+    }
+    e->f.fd = fd;
+    e->f.size = (u64)st.st_size;
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->mtim = st.st_mtim;
+    e->checked_ns = now_ns();
+    e->hash = hash;
+    e->path_len = (u32)len;
+    memcpy(e->path, path, len);
+    if (!build_head(&e->f, &st, rel, rlen)) {
+        entry_free(e);
+        errno = ENOMEM;
+        return NULL;
+    }
+    /* Small files are kept in memory; their bodies go out with the head in
+     * one write instead of a second sendfile call. */
+    if (e->f.size <= H11_FILE_INLINE_MAX) {
+        char *data = malloc(e->f.size > 0 ? (usize)e->f.size : 1);
+        if (data == NULL || pread(fd, data, (usize)e->f.size, 0) != (ssize_t)e->f.size) {
+            free(data);
+            entry_free(e);
+            errno = EIO;
+            return NULL;
+        }
+        e->f.data = data;
+    }
+    return e;
+}
+
+static void lru_unlink(h11_file_cache_t *c, file_entry_t *e) {
+    *(e->newer != NULL ? &e->newer->older : &c->newest) = e->older;
+    *(e->older != NULL ? &e->older->newer : &c->oldest) = e->newer;
+}
+
+static void lru_push(h11_file_cache_t *c, file_entry_t *e) {
+    e->newer = NULL;
+    e->older = c->newest;
+    *(c->newest != NULL ? &c->newest->newer : &c->oldest) = e;
+    c->newest = e;
+}
+
+/* Removes e from the table, shifting later members of its probe run back
+ * into the hole so lookups never stop early. */
+static void entry_remove(h11_file_cache_t *c, file_entry_t *e) {
+    u32 hole = e->hash & c->mask;
+    while (c->slot[hole] != e)
+        hole = (hole + 1) & c->mask;
+    for (u32 i = (hole + 1) & c->mask; c->slot[i] != NULL; i = (i + 1) & c->mask) {
+        u32 home = c->slot[i]->hash & c->mask;
+        if (((i - home) & c->mask) >= ((i - hole) & c->mask)) {
+            c->slot[hole] = c->slot[i];
+            hole = i;
+        }
+    }
+    c->slot[hole] = NULL;
+    c->count--;
+    lru_unlink(c, e);
+    entry_uncache(e);
+}
+
+const h11_file_t *h11_file_open(h11_file_cache_t *c, const char *target, usize target_len) {
+    char path[PATH_MAX_LEN];
+    usize len = 0;
+    if (c == NULL || target == NULL || !path_decode(target, target_len, path, &len) ||
+        !path_ok(path, len)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    u32 hash = path_hash(path, len);
+    u32 s = hash & c->mask;
+    for (file_entry_t *e; (e = c->slot[s]) != NULL; s = (s + 1) & c->mask) {
+        if (e->hash == hash && e->path_len == len && memcmp(e->path, path, len) == 0) {
+            /* A file replaced or rewritten since it was opened is dropped and
+             * opened again; holders of the old entry keep their copy. */
+            u64 now = now_ns();
+            if (now - e->checked_ns >= FILE_RECHECK_NS && !entry_fresh(c, e, now)) {
+                entry_remove(c, e);
+                break;
+            }
+            if (c->newest != e) {
+                lru_unlink(c, e);
+                lru_push(c, e);
+            }
+            e->refs++;
+            return &e->f;
+        }
+    }
+    file_entry_t *e = entry_open(c, path, len, hash);
+    if (e == NULL)
+        return NULL;
+    if (c->count == c->max_files)
+        entry_remove(c, c->oldest);
+    s = hash & c->mask;
+    while (c->slot[s] != NULL)
+        s = (s + 1) & c->mask;
+    c->slot[s] = e;
+    c->count++;
+    e->cached = true;
+    e->refs = 1;
+    lru_push(c, e);
+    return &e->f;
+}
+
+/* ---- replies ---- */
+
+static bool field_value(const h11_request_t *req, const char *base, const char *name,
+                        h11_span_t *v) {
+    int i = h11_find_header(req, base, name);
+    if (i < 0)
+        return false;
+    *v = req->headers[i].value;
+    return true;
+}
+
+/* If-None-Match uses the weak comparison (RFC 9110 S13.1.2). */
+static bool etag_matches(const h11_file_t *f, const char *base, h11_span_t v) {
+    const char *etag = f->head + f->etag.off;
+    h11_token_iter_t it;
+    h11_token_t tok;
+    h11_token_iter_init(&it, base, v);
+    while (h11_token_next(&it, &tok)) {
+        const char *t = base + tok.token.off;
+        u32 n = tok.token.len;
+        if (n == 1 && t[0] == '*')
+            return true;
+        if (n > 2 && t[0] == 'W' && t[1] == '/') {
+            t += 2;
+            n -= 2;
+        }
+        if (n == f->etag.len && memcmp(t, etag, n) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool span_is(const char *base, h11_span_t v, const char *s, u32 len) {
+    return v.len == len && memcmp(base + v.off, s, len) == 0;
+}
+
+/* If-Range must match the strong validator exactly; a date only counts
+ * when it is the Last-Modified we sent. */
+static bool if_range_holds(const h11_file_t *f, const h11_request_t *req, const char *base) {
+    h11_span_t v;
+    if (!field_value(req, base, "if-range", &v))
+        return true;
+    return span_is(base, v, f->head + f->etag.off, f->etag.len) ||
+           span_is(base, v, f->head + f->last_modified.off, f->last_modified.len);
+}
+
+static usize put(char *dst, usize pos, const char *src, usize len) {
+    if (pos + len <= H11_FILE_HEAD_MAX)
+        memcpy(dst + pos, src, len);
+    return pos + len;
+}
+
+h11_error_t h11_file_reply(const h11_file_t *f, const h11_request_t *req, const char *base,
+                           h11_file_reply_t *r) {
+    if (f == NULL || req == NULL || base == NULL || r == NULL)
+        return H11_ERR_INTERNAL;
+    const char *conn = "";
+    if (!(req->flags & H11_REQF_KEEP_ALIVE))
+        conn = "Connection: close\r\n";
+    else if ((req->version & 0xFF) == 0)
+        conn = "Connection: keep-alive\r\n";
+    bool head = req->method.len == 4 && memcmp(base + req->method.off, "HEAD", 4) == 0;
+    r->status = 200;
+    r->fd = f->fd;
+    r->off = 0;
+    r->len = f->size;
+    r->data = NULL;
+    h11_range_t range = { 0, 0 };
+    h11_span_t v;
+    if (field_value(req, base, "if-none-match", &v)) {
+        if (etag_matches(f, base, v))
+            r->status = 304;
+    } else if (field_value(req, base, "if-modified-since", &v) &&
+               span_is(base, v, f->head + f->last_modified.off, f->last_modified.len)) {
+        r->status = 304;
+    }
+    if (r->status == 200 && !head && field_value(req, base, "range", &v) &&
+        if_range_holds(f, req, base)) {
+        u32 n = 0;
+        h11_error_t err = h11_range_parse(base, v, f->size, &range, 1, &n);
+        if (err == H11_OK) {
+            r->status = 206;
+            r->off = range.first;
+            r->len = range.last - range.first + 1;
+        } else if (err == H11_ERR_RANGE_NOT_SATISFIABLE) {
+            r->status = 416;
+        }
+        /* Unparsable or multi-range requests get the whole file. */
+    }
+    if (r->status == 200 && conn[0] == '\0') {
+        r->head = f->head;
+        r->head_len = f->head_len;
+    } else {
+        static const char *const lines[] = {
+            "HTTP/1.1 304 Not Modified\r\n",
+            "HTTP/1.1 206 Partial Content\r\n",
+            "HTTP/1.1 416 Range Not Satisfiable\r\n",
+        };
+        char *b = r->buf;
+        usize pos = 0;
+        if (r->status == 200) {
+            pos = put(b, pos, f->head, f->meta.off + f->meta.len);
+        } else {
+            const char *sl = lines[r->status == 304 ? 0 : r->status == 206 ? 1 : 2];
+            pos = put(b, pos, sl, strlen(sl));
+            h11_span_t m = r->status == 304 ? f->validators : f->meta;
+            pos = put(b, pos, f->head + m.off, m.len);
+        }
+        char tmp[96];
+        int n = 0;
+        if (r->status == 206)
+            n = snprintf(tmp, sizeof(tmp), "Content-Range: bytes %llu-%llu/%llu\r\n",
+                         (unsigned long long)range.first, (unsigned long long)range.last,
+                         (unsigned long long)f->size);
+        else if (r->status == 416)
+            n = snprintf(tmp, sizeof(tmp), "Content-Range: bytes */%llu\r\n",
+                         (unsigned long long)f->size);
+        pos = put(b, pos, tmp, (usize)n);
+        if (r->status != 304) {
+            n = snprintf(tmp, sizeof(tmp), "Content-Length: %llu\r\n",
+                         (unsigned long long)(r->status == 416 ? 0 : r->len));
+            pos = put(b, pos, tmp, (usize)n);
+        }
+        pos = put(b, pos, conn, strlen(conn));
+        pos = put(b, pos, "\r\n", 2);
+        if (pos > H11_FILE_HEAD_MAX)
+            return H11_ERR_INTERNAL;
+        r->head = b;
+        r->head_len = pos;
+    }
+    if (head || r->status == 304 || r->status == 416)
+        r->len = 0;
+    if (f->data != NULL)
+        r->data = f->data + r->off;
+    return H11_OK;
+}
+
+/* ---- sending ---- */
+
+static ssize_t send_body(int sock, h11_file_reply_t *r) {
+    usize n = r->len < SEND_CHUNK ? (usize)r->len : SEND_CHUNK;
+#if defined(__linux__)
+    off_t off = (off_t)r->off;
+    return sendfile(sock, r->fd, &off, n);
+#else
+    char buf[16384];
+    ssize_t got = pread(r->fd, buf, n < sizeof(buf) ? n : sizeof(buf), (off_t)r->off);
+    if (got <= 0)
+        return got;
+    return write(sock, buf, (usize)got);
+#endif
+}
+
+h11_error_t h11_file_send(int sock, h11_file_reply_t *r, u64 *sent) {
+    if (sent != NULL)
+        *sent = 0;
+    if (r == NULL || sent == NULL)
+        return H11_ERR_INTERNAL;
+    while (r->head_len > 0 || r->len > 0) {
+        ssize_t n;
+        if (r->head_len > 0 || r->data != NULL) {
+            struct iovec iov[2] = {
+                { .iov_base = (void *)r->head, .iov_len = r->head_len },
+                { .iov_base = (void *)r->data, .iov_len = r->data != NULL ? (usize)r->len : 0 },
+            };
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+            /* MSG_MORE holds a head back until sendfile supplies the body. */
+            int flags = MSG_NOSIGNAL | (r->data == NULL && r->len > 0 ? MSG_MORE : 0);
+            n = sendmsg(sock, &msg, flags);
+            if (n < 0 && errno == ENOTSOCK)
+                n = writev(sock, iov, 2);
+            if (n > 0) {
+                usize h = (usize)n < r->head_len ? (usize)n : r->head_len;
+                r->head += h;
+                r->head_len -= h;
+                if ((usize)n > h) {
+                    r->data += (usize)n - h;
+                    r->off += (usize)n - h;
+                    r->len -= (usize)n - h;
+                }
+            }
+        } else {
+            n = send_body(sock, r);
+            if (n > 0) {
+                r->off += (u64)n;
+                r->len -= (u64)n;
+            }
+        }
+        if (n > 0) {
+            *sent += (u64)n;
+        } else if (n == 0) {
+            errno = EIO;   /* the file shrank under us */
+            return H11_ERR_INTERNAL;
+        } else if (errno == EAGAIN) {
+            return H11_NEED_MORE_DATA;
+        } else if (errno != EINTR) {
+            return H11_ERR_INTERNAL;
+        }
+    }
+    return H11_OK;
+}
@@ -0,0 +1,152 @@
+/*
+ * form.c — Streaming application/x-www-form-urlencoded decoder and
+ *          query-string iteration
+ */
+#include "h11_internal.h"
+#include <string.h>
+
+void h11_form_init(h11_form_t *f, char *buf, u32 cap) {
+    if (f == NULL)
+        return;
+    f->buf = buf;
+    f->cap = buf != NULL ? cap : 0;
+    f->len = 0;
+}
+
+h11_error_t h11_form_decode(char *dst, const char *src, usize len, usize *out_len) {
+    if (dst == NULL || out_len == NULL || (src == NULL && len > 0))
+        return H11_ERR_INTERNAL;
+    usize i = 0, o = 0;
+    while (i < len) {
+        usize run = h11_find_char2(src + i, len - i, '%', '+');
+        if (run > 0) {
+            memmove(dst + o, src + i, run);
+            o += run;
+            i += run;
+            if (i == len)
+                break;
+        }
+        if (src[i] == '+') {
+            dst[o++] = ' ';
+            i++;
+            continue;
+        }
+        if (len - i < 3)
+            return H11_ERR_INVALID_FORM_ENCODING;
+        int hi = h11_hexval(src[i + 1]);
+        int lo = h11_hexval(src[i + 2]);
+        if (hi < 0 || lo < 0)
+            return H11_ERR_INVALID_FORM_ENCODING;
+        dst[o++] = (char)((hi << 4) | lo);
+        i += 3;
+    }
+    *out_len = o;
+    return H11_OK;
+}
+
+/* Split the raw pair held in f->buf at the first '=' and decode both halves
+ * in place; decoding only ever shrinks, so the halves cannot overlap. */
+static h11_error_t form_emit_buffered(h11_form_t *f, h11_form_pair_t *pair) {
+    usize n = f->len;
+    usize eq = h11_find_char(f->buf, n, '=');
+    usize vstart = eq < n ? eq + 1 : n;
+    usize klen = 0, vlen = 0;
+    f->len = 0;
+    h11_error_t err = h11_form_decode(f->buf, f->buf, eq, &klen);
+    if (err == H11_OK)
+        err = h11_form_decode(f->buf + vstart, f->buf + vstart, n - vstart, &vlen);
+    if (err != H11_OK)
+        return err;
+    pair->key = f->buf;
+    pair->key_len = klen;
+    pair->value = f->buf + vstart;
+    pair->value_len = vlen;
+    return H11_OK;
+}
+
+static h11_error_t form_append(h11_form_t *f, const char *data, usize n) {
+    if (n > (usize)(f->cap - f->len)) {
+        f->len = 0;
+        return H11_ERR_FORM_FIELD_TOO_LONG;
+    }
+    if (n > 0)
+        memcpy(f->buf + f->len, data, n);
+    f->len += (u32)n;
+    return H11_OK;
+}
+
+static h11_error_t form_emit(h11_form_t *f, const char *raw, usize n, h11_form_pair_t *pair) {
+    if (h11_find_char2(raw, n, '%', '+') == n) {
+        usize eq = h11_find_char(raw, n, '=');
+        usize vstart = eq < n ? eq + 1 : n;
+        pair->key = raw;
+        pair->key_len = eq;
+        pair->value = raw + vstart;
+        pair->value_len = n - vstart;
+        return H11_OK;
+    }
+    h11_error_t err = form_append(f, raw, n);
+    return err != H11_OK ? err : form_emit_buffered(f, pair);
+}
+
+h11_error_t h11_form_next(h11_form_t *f, const char *data, usize len, usize *consumed,
+                          h11_form_pair_t *pair) {
+    if (f == NULL || consumed == NULL || pair == NULL || (data == NULL && len > 0))
+        return H11_ERR_INTERNAL;
+    usize pos = 0;
+    for (;;) {
+        usize rem = len - pos;
+        usize amp = h11_find_char(data + pos, rem, '&');
+        if (amp == rem) {
+            h11_error_t err = form_append(f, data + pos, rem);
+            *consumed = err == H11_OK ? len : pos;
+            return err != H11_OK ? err : H11_NEED_MORE_DATA;
+        }
+        *consumed = pos + amp + 1;
+        if (f->len > 0) {
+            h11_error_t err = form_append(f, data + pos, amp);
+            return err != H11_OK ? err : form_emit_buffered(f, pair);
+        }
+        if (amp > 0)
+            return form_emit(f, data + pos, amp, pair);
+        pos++;
+    }
+}
+
+h11_error_t h11_form_finish(h11_form_t *f, h11_form_pair_t *pair) {
+    if (f == NULL || pair == NULL)
+        return H11_ERR_INTERNAL;
+    if (f->len == 0)
+        return H11_NEED_MORE_DATA;
+    return form_emit_buffered(f, pair);
+}
+
+bool h11_query_next(const char *base, h11_span_t target, u32 *pos,
+                    h11_span_t *key, h11_span_t *value) {
+    if (base == NULL || pos == NULL || key == NULL || value == NULL)
+        return false;
+    const char *t = base + target.off;
+    usize i = *pos;
+    if (i == 0) {
+        i = h11_find_char(t, target.len, '?');
+        if (i < target.len)
+            i++;
+    }
+    while (i < target.len) {
+        usize start = i;
+        usize n = h11_find_char(t + start, target.len - start, '&');
+        i = start + n + 1;
+        if (n == 0)
+            continue;
+        usize eq = h11_find_char(t + start, n, '=');
+        usize vstart = eq < n ? eq + 1 : n;
+        key->off = target.off + (u32)start;
+        key->len = (u32)eq;
+        value->off = target.off + (u32)(start + vstart);
+        value->len = (u32)(n - vstart);
+        *pos = (u32)(i < target.len ? i : target.len);
+        return true;
+    }
+    *pos = target.len;
+    return false;
+}
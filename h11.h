@@ -45,6 +45,16 @@ typedef enum {
     H11_ERR_CHUNK_EXT_TOO_LONG,
     H11_ERR_INVALID_CHUNK_DATA,
     H11_ERR_INVALID_TRAILER,
+    H11_ERR_INVALID_FORM_ENCODING,
+    H11_ERR_FORM_FIELD_TOO_LONG,
+    H11_ERR_INVALID_RANGE,
+    H11_ERR_RANGE_NOT_SATISFIABLE,
+    H11_ERR_TOO_MANY_RANGES,
+    H11_ERR_WS_HANDSHAKE,
+    H11_ERR_WS_VERSION,
+    H11_ERR_WS_PROTOCOL,
+    H11_ERR_WS_INVALID_UTF8,
+    H11_ERR_WS_MESSAGE_TOO_LARGE,
     H11_ERR_CONNECTION_CLOSED,
     H11_ERR_INTERNAL,
     H11_ERR__COUNT
@@ -93,8 +103,34 @@ enum {
     H11_CFG_ALLOW_LEADING_CRLF    = 1u << 3,
     H11_CFG_TOLERATE_SPACES       = 1u << 4,
     H11_CFG_REJECT_TE_CL_CONFLICT = 1u << 5,
+    H11_CFG_PADDED_INPUT          = 1u << 6,
+    H11_CFG_BLOCK_VALIDATE        = 1u << 7,
+    H11_CFG_SHAPE_CACHE           = 1u << 8,
+    H11_CFG_LAZY_HEADERS          = 1u << 9,
 };
 
+/* H11_CFG_BLOCK_VALIDATE classifies all buffered header bytes in one vector
+ * pass; each field line then only checks that its name and value ranges hold
+ * no illegal byte. Results and error offsets match the per-field checks.
+ *
+ * H11_CFG_SHAPE_CACHE keeps the previous request's field names on the
+ * parser. A keep-alive client that repeats them in the same order skips name
+ * validation and known-header classification for every name that matches.
+ *
+ * H11_CFG_LAZY_HEADERS fully parses only the framing headers (Host,
+ * Content-Length, Transfer-Encoding, Connection, Expect, Upgrade). Every other
+ * field is stored with its exact name and OWS-trimmed value and flagged
+ * H11_HEADER_F_LAZY; its bytes are only checked by h11_header_validate,
+ * h11_find_header or h11_header_next, none of which modify the request. A
+ * malformed non-framing field does not fail h11_parse (unless it has
+ * whitespace before the colon, or a CR or LF inside it). One holding
+ * obs-text the config disallows is flagged H11_HEADER_F_INVALID at once.
+ * H11_CFG_BLOCK_VALIDATE takes precedence, validating every field eagerly. */
+
+/* With H11_CFG_PADDED_INPUT the caller promises that this many bytes past
+ * data + len are readable on every h11_parse call (contents arbitrary). */
+enum { H11_INPUT_PADDING = 64 };
+
 enum {
     H11_REQF_KEEP_ALIVE            = 1u << 0,
     H11_REQF_EXPECT_CONTINUE       = 1u << 1,
@@ -103,14 +139,46 @@ enum {
     H11_REQF_HAS_CONTENT_LENGTH    = 1u << 4,
     H11_REQF_HAS_TRANSFER_ENCODING = 1u << 5,
     H11_REQF_IS_CHUNKED            = 1u << 6,
+    H11_REQF_EXPECT_UNSUPPORTED    = 1u << 8,
 };
 
 enum {
     H11_HEADER_F_KNOWN_NAME = 1u << 0,
+    H11_HEADER_F_LAZY       = 1u << 1,
+    H11_HEADER_F_INVALID    = 1u << 2,
+};
+
+enum {
+    H11_TOKEN_F_HAS_PARAMS = 1u << 0,
+    H11_TOKEN_F_BAD_WEIGHT = 1u << 1,
 };
 
 enum { H11_INDEX_NONE = 0xFFFF };
 
+typedef enum {
+    H11_SIMD_SCALAR   = 0,
+    H11_SIMD_SSE42    = 1,
+    H11_SIMD_AVX2     = 2,
+    H11_SIMD_AVX512VL = 3,
+    H11_SIMD_AVX512   = 4
+} h11_simd_level_t;
+
+/* Result of the startup scanner microbenchmark (H11_SIMD=auto or
+ * h11_simd_calibrate). mb_per_s is 0 for levels the host does not support. */
+typedef struct {
+    h11_simd_level_t chosen;
+    h11_simd_level_t supported;
+    u32              mb_per_s[H11_SIMD_AVX512 + 1];
+    u64              elapsed_ns;
+} h11_simd_calibration_t;
+
+enum { H11_MAX_OFFERS = 16 };
+
+typedef enum {
+    H11_NEGOTIATE_ENCODING = 0,
+    H11_NEGOTIATE_MEDIA
+} h11_negotiate_kind_t;
+
 typedef struct {
     u32 off;
     u32 len;
@@ -153,6 +221,195 @@ typedef struct {
 
 typedef struct h11_parser h11_parser_t;
 
+/* Walks a request's header fields, checking lazy ones on the way; cur holds
+ * the copy returned for a lazy field. */
+typedef struct {
+    const h11_request_t *req;
+    const char          *base;
+    u32                  pos;
+    h11_header_t         cur;
+} h11_header_iter_t;
+
+/* One application/x-www-form-urlencoded pair. Pointers reference either the
+ * caller's fragment (zero-copy, nothing to decode) or the decoder's scratch
+ * buffer; both stay valid until the next h11_form_* call. */
+typedef struct {
+    const char *key;
+    const char *value;
+    usize       key_len;
+    usize       value_len;
+} h11_form_pair_t;
+
+typedef struct {
+    char *buf;
+    u32   cap;
+    u32   len;
+} h11_form_t;
+
+/* One element of a comma-separated field value. token is never empty:
+ * h11_token_next skips empty elements and parameter-only ones such as
+ * ";q=0.5". weight is the q parameter in thousandths (1000 when absent);
+ * params covers everything after the first ';'. */
+typedef struct {
+    h11_span_t token;
+    h11_span_t params;
+    u16        weight;
+    u16        flags;
+} h11_token_t;
+
+typedef struct {
+    const char *base;
+    u32         pos;
+    u32         end;
+} h11_token_iter_t;
+
+/* Server offers for content negotiation, compiled once by h11_offers_compile
+ * in preference order. Names are borrowed and must outlive the table; slot
+ * is an open-addressed, case-insensitive hash of the names holding
+ * offer index + 1 (0 = empty). */
+typedef struct {
+    const char *name[H11_MAX_OFFERS];
+    u8          len[H11_MAX_OFFERS];
+    u8          type_len[H11_MAX_OFFERS];
+    u8          slot[64];
+    u8          count;
+    u8          kind;
+    u8          identity;
+} h11_offers_t;
+
+/* A pipe used as the in-kernel buffer between two splice() calls (Linux).
+ * buffered counts bytes taken from the source that have not reached the
+ * sink yet; cap is the pipe's capacity. */
+typedef struct {
+    int fd[2];
+    u32 cap;
+    u32 buffered;
+} h11_pipe_t;
+
+/* One direction of a tunnel: in -> pipe -> out. prefix holds bytes already
+ * read into user memory (borrowed until they are sent); they go first.
+ * done is set once in reached EOF, everything was delivered and out was
+ * shut down for writing. moved counts bytes delivered to out. */
+typedef struct {
+    h11_pipe_t  pipe;
+    const char *prefix;
+    u32         prefix_len;
+    int         in;
+    int         out;
+    bool        eof;
+    bool        done;
+    u64         moved;
+} h11_relay_t;
+
+/* A CONNECT or Upgrade tunnel: up carries client -> upstream, down
+ * upstream -> client. */
+typedef struct {
+    h11_relay_t up;
+    h11_relay_t down;
+} h11_tunnel_t;
+
+typedef enum {
+    H11_WS_CONTINUATION = 0x0,
+    H11_WS_TEXT         = 0x1,
+    H11_WS_BINARY       = 0x2,
+    H11_WS_CLOSE        = 0x8,
+    H11_WS_PING         = 0x9,
+    H11_WS_PONG         = 0xA
+} h11_ws_opcode_t;
+
+/* Sec-WebSocket-Accept is 28 base64 characters; the 101 reply built around
+ * it is always H11_WS_RESPONSE_LEN bytes. A frame header is 2 to 14 bytes;
+ * control payloads are at most 125. */
+enum {
+    H11_WS_ACCEPT_LEN   = 28,
+    H11_WS_RESPONSE_LEN = 129,
+    H11_WS_HEADER_MAX   = 14,
+    H11_WS_CONTROL_MAX  = 125,
+};
+
+/* Streaming frame parser for one direction of a connection. A server
+ * (h11_ws_init with server set) requires masked frames, a client unmasked
+ * ones. Control frames are collected in ctrl and reported whole; data
+ * frames are reported as they arrive. Fields are internal. */
+typedef struct {
+    u64         max_message;
+    u64         message_len;
+    u64         length;
+    u64         remaining;
+    h11_error_t last_error;
+    u32         key;
+    u8          state;
+    u8          opcode;
+    u8          message;
+    u8          utf8;
+    u8          hdr_len;
+    u8          ctrl_len;
+    bool        fin;
+    bool        server;
+    u8          hdr[H11_WS_HEADER_MAX];
+    char        ctrl[H11_WS_CONTROL_MAX];
+} h11_ws_t;
+
+/* One step of h11_ws_parse. data/len are payload bytes of the current
+ * frame, unmasked in place (control payloads point into the parser).
+ * opcode is the frame's own, message the data message it belongs to
+ * (TEXT or BINARY, also for continuation frames; the opcode itself for
+ * control frames). end is set on the frame's last bytes, so a message is
+ * complete when end and fin are both set. */
+typedef struct {
+    char *data;
+    usize len;
+    u64   length;
+    u8    opcode;
+    u8    message;
+    bool  fin;
+    bool  end;
+} h11_ws_frame_t;
+
+/* Files up to H11_FILE_INLINE_MAX bytes are cached in memory; every reply
+ * head fits in H11_FILE_HEAD_MAX bytes. */
+enum { H11_FILE_INLINE_MAX = 8192, H11_FILE_HEAD_MAX = 512 };
+
+typedef struct h11_file_cache h11_file_cache_t;
+
+/* One cached file, valid until the h11_file_open that returned it is
+ * matched by h11_file_release. head is the complete HTTP/1.1 keep-alive
+ * 200 head; the spans point into it. meta covers the ETag, Last-Modified,
+ * Content-Type and Accept-Ranges lines, validators only the first two.
+ * data holds the whole file when it is small, else NULL. */
+typedef struct {
+    int         fd;
+    u32         head_len;
+    u64         size;
+    char       *head;
+    const char *data;
+    h11_span_t  meta;
+    h11_span_t  validators;
+    h11_span_t  etag;
+    h11_span_t  last_modified;
+} h11_file_t;
+
+/* What to send for one request: head_len bytes of head, then len body
+ * bytes, from data when set, else from fd at off. head may point into
+ * buf, so a reply must not be copied. h11_file_send advances the fields
+ * as it writes. */
+typedef struct {
+    const char *head;
+    usize       head_len;
+    const char *data;
+    u64         off;
+    u64         len;
+    int         fd;
+    u16         status;
+    char        buf[H11_FILE_HEAD_MAX];
+} h11_file_reply_t;
+
+/* Inclusive byte range resolved against the representation length. */
+typedef struct {
+    u64 first;
+    u64 last;
+} h11_range_t;
+
 h11_config_t h11_config_default(void);
 h11_parser_t *h11_parser_new(const h11_config_t *config);
 void h11_parser_free(h11_parser_t *parser);
@@ -162,11 +419,83 @@ h11_state_t h11_get_state(const h11_parser_t *p);
 const h11_request_t *h11_get_request(const h11_parser_t *p);
 h11_error_t h11_read_body(h11_parser_t *p, const char *data, usize len, usize *consumed,
                           const char **body_out, usize *body_len);
+u64 h11_body_pending(const h11_parser_t *p);
+h11_error_t h11_body_advance(h11_parser_t *p, u64 n);
 const char *h11_error_name(h11_error_t error);
 const char *h11_error_message(h11_error_t error);
+u16 h11_error_status(h11_error_t error);
+const char *h11_error_response(h11_error_t error, usize *len);
 usize h11_error_offset(const h11_parser_t *p);
+u16 h11_expect_response(const h11_parser_t *p, const char **resp, usize *len);
 bool h11_header_name_eq(const char *base, h11_span_t name, const char *cmp);
 int h11_find_header(const h11_request_t *req, const char *base, const char *name);
+int h11_find_header_next(const h11_request_t *req, const char *base, const char *name,
+                         int prev);
+h11_error_t h11_header_validate(const h11_request_t *req, const char *base, u32 idx);
+void h11_header_iter_init(h11_header_iter_t *it, const h11_request_t *req, const char *base);
+const h11_header_t *h11_header_next(h11_header_iter_t *it);
+
+h11_simd_level_t h11_simd_supported(void);
+h11_simd_level_t h11_simd_active(void);
+h11_simd_level_t h11_simd_force(h11_simd_level_t level);
+const char *h11_simd_name(h11_simd_level_t level);
+bool h11_simd_from_name(const char *name, h11_simd_level_t *level);
+h11_simd_level_t h11_simd_calibrate(h11_simd_calibration_t *out);
+bool h11_simd_calibration(h11_simd_calibration_t *out);
+
+void h11_form_init(h11_form_t *f, char *buf, u32 cap);
+h11_error_t h11_form_next(h11_form_t *f, const char *data, usize len, usize *consumed,
+                          h11_form_pair_t *pair);
+h11_error_t h11_form_finish(h11_form_t *f, h11_form_pair_t *pair);
+h11_error_t h11_form_decode(char *dst, const char *src, usize len, usize *out_len);
+bool h11_query_next(const char *base, h11_span_t target, u32 *pos,
+                    h11_span_t *key, h11_span_t *value);
+
+void h11_token_iter_init(h11_token_iter_t *it, const char *base, h11_span_t value);
+bool h11_token_next(h11_token_iter_t *it, h11_token_t *tok);
+bool h11_token_list_has(const char *base, h11_span_t value, const char *token);
+
+h11_error_t h11_offers_compile(h11_offers_t *o, h11_negotiate_kind_t kind,
+                               const char *const *offers, u32 count);
+int h11_negotiate(const h11_offers_t *o, const char *base, h11_span_t value);
+int h11_request_negotiate(const h11_offers_t *o, const h11_request_t *req, const char *base);
+
+bool h11_cookie_find(const char *base, const h11_header_t *header, const char *name,
+                     h11_span_t *value);
+bool h11_cookie_next(const char *base, const h11_header_t *header, u32 *pos,
+                     h11_span_t *name, h11_span_t *value);
+bool h11_request_cookie(const h11_request_t *req, const char *base, const char *name,
+                        h11_span_t *value);
+
+h11_error_t h11_range_parse(const char *base, h11_span_t value, u64 size,
+                            h11_range_t *ranges, u32 max_ranges, u32 *count);
+
+h11_file_cache_t *h11_file_cache_new(const char *root, u32 max_files);
+void h11_file_cache_free(h11_file_cache_t *c);
+void h11_file_cache_clear(h11_file_cache_t *c);
+const h11_file_t *h11_file_open(h11_file_cache_t *c, const char *target, usize target_len);
+void h11_file_release(const h11_file_t *f);
+h11_error_t h11_file_reply(const h11_file_t *f, const h11_request_t *req, const char *base,
+                           h11_file_reply_t *r);
+h11_error_t h11_file_send(int sock, h11_file_reply_t *r, u64 *sent);
+
+h11_error_t h11_pipe_open(h11_pipe_t *pp, u32 size);
+void h11_pipe_close(h11_pipe_t *pp);
+h11_error_t h11_body_splice(h11_parser_t *p, h11_pipe_t *pp, int in, int out, u64 *moved);
+h11_error_t h11_tunnel_open(h11_tunnel_t *t, int client, int upstream, const char *buffered,
+                            usize len, u32 pipe_size);
+void h11_tunnel_close(h11_tunnel_t *t);
+h11_error_t h11_tunnel_relay(h11_tunnel_t *t);
+
+h11_error_t h11_ws_accept(const h11_request_t *req, const char *base, char *accept);
+usize h11_ws_response(const char *accept, char *out);
+void h11_ws_init(h11_ws_t *ws, bool server, u64 max_message);
+h11_error_t h11_ws_parse(h11_ws_t *ws, char *data, usize len, usize *consumed,
+                         h11_ws_frame_t *frame);
+usize h11_ws_frame_header(char *out, h11_ws_opcode_t opcode, bool fin, u64 len,
+                          const u8 *mask);
+void h11_ws_mask(char *data, usize len, const u8 *mask, u64 offset);
+u16 h11_ws_close_code(h11_error_t error);
 
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
 _Static_assert(sizeof(h11_span_t) == 8, "h11_span_t must stay compact");
@@ -3,13 +3,6 @@
 
 #include "h11.h"
 
-typedef enum {
-    H11_SIMD_SCALAR = 0,
-    H11_SIMD_SSE42  = 1,
-    H11_SIMD_AVX2   = 2,
-    H11_SIMD_AVX512 = 3
-} h11_simd_level_t;
-
 extern h11_simd_level_t h11_simd_level;
 
 #if defined(__GNUC__) || defined(__clang__)
@@ -42,6 +35,29 @@ H11_INLINE bool h11_is_htab(char c)   { return (u8)c == 0x09; }
 H11_INLINE bool h11_is_ows(char c)    { return h11_is_sp(c) || h11_is_htab(c); }
 H11_INLINE bool h11_is_cr(char c)     { return (u8)c == 0x0D; }
 H11_INLINE bool h11_is_lf(char c)     { return (u8)c == 0x0A; }
+H11_INLINE u8 h11_ascii_fold(u8 c)    { return (c >= 'A' && c <= 'Z') ? (u8)(c | 0x20u) : c; }
+
+/* Index of the lowest set bit; m must be non-zero. */
+H11_INLINE usize h11_ctz64(u64 m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (usize)__builtin_ctzll(m);
+#else
+    usize i = 0;
+    while (!(m & 1)) {
+        m >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* One field name of the previous request on the connection
+ * (H11_CFG_SHAPE_CACHE); the bytes live in h11_parser.shape_names. */
+typedef struct {
+    u32 off;
+    u16 len;
+    u16 name_id;
+} h11_shape_entry_t;
 
 struct h11_parser {
     h11_config_t  config;
@@ -49,6 +65,8 @@ struct h11_parser {
     h11_error_t   last_error;
     usize         error_offset;
     h11_request_t request;
+    u32           header_cap;
+    u32           trailer_cap;
     usize         total_consumed;
     usize         line_start;
     usize         headers_size;
@@ -61,10 +79,46 @@ struct h11_parser {
     bool          seen_transfer_encoding;
     bool          is_chunked;
     bool          leading_crlf_consumed;
+    u64          *block_masks;
+    usize         block_words;
+    h11_shape_entry_t *shape;
+    char         *shape_names;
+    u32           shape_count;
+    u32           shape_cap;
+    u32           shape_names_cap;
+    u32           shape_hits;
 };
 
 bool h11_span_eq_case(const char *base, h11_span_t a, const char *b, usize blen);
 int h11_hexval(char c);
 void h11_init(void);
 
+/* Scanners return the offset of the first match, or len when none is found.
+ * h11_find_crlf reports the offset of the CR of the first CRLF pair. */
+usize h11_find_char(const char *data, usize len, char target);
+usize h11_find_char2(const char *data, usize len, char a, char b);
+usize h11_find_crlf(const char *data, usize len);
+
+/* Offset of the first byte >= 0x80, or len. */
+usize h11_find_nonascii(const char *data, usize len);
+
+/* XORs data[i] with byte (i & 3) of key, little-endian: byte 0 is key & 0xFF.
+ * The WebSocket (un)masking kernel; callers rotate key to the payload offset. */
+void h11_mask_xor(char *data, usize len, u32 key);
+
+/* Same results, for input followed by H11_INPUT_PADDING readable bytes: no
+ * tail handling, every block is a full-width load. */
+usize h11_find_char_padded(const char *data, usize len, char target);
+usize h11_find_crlf_padded(const char *data, usize len);
+
+/* One classification pass over a header block (H11_CFG_BLOCK_VALIDATE).
+ * Bit i of word i / 64 describes data[i]; each array holds (len + 63) / 64
+ * words and bits past len are zero.
+ *   nontchar: byte is not a tchar
+ *   badval:   byte may not appear in a field value (CTL other than HTAB,
+ *             DEL, and obs-text unless obs_text is set)
+ *   eol:      LF that ends a line; with strict_crlf only an LF preceded by CR */
+void h11_classify_block(const char *data, usize len, bool strict_crlf, bool obs_text,
+                        u64 *nontchar, u64 *badval, u64 *eol);
+
 #endif
@@ -0,0 +1,1062 @@
+/*
+ * h11d.c — Reference HTTP/1.1 server: one edge-triggered epoll loop or one
+ *          io_uring per core
+ *
+ * Usage: h11d [-a addr] [-p port] [-t threads] [-c first_cpu] [-u] [-r root]
+ * Every worker owns a SO_REUSEPORT listener on the same port, so the kernel
+ * spreads connections across workers and nothing is shared between them.
+ * Each worker keeps a pool of parsers that outlive their connections.
+ *
+ * With -u a worker drives its connections through an io_uring instead: one
+ * multishot accept, one multishot recv per connection drawing from a
+ * provided-buffer ring, and sends submitted once per batch of input. Requests
+ * are parsed straight out of the provided buffers; a connection only owns a
+ * read buffer while it holds an unfinished request.
+ *
+ * Every request, pipelined or not, gets the same small 200 response once its
+ * body has been read and discarded; a parse error gets the constant
+ * h11_error_response() for its error and the connection is closed after it
+ * is written. SIGINT/SIGTERM stop the workers, which then report their
+ * connection and request counts.
+ *
+ * With -r (epoll only) GET and HEAD are served from the files under root
+ * instead, through a per-worker h11_file_cache_t: small files leave with
+ * their head in one sendmsg, larger ones follow it with sendfile.
+ */
+#define _GNU_SOURCE
+#include "h11.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define H11D_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#ifndef H11D_URING
+#define H11D_URING 0
+#endif
+
+#define MAX_WORKERS   256
+#define MAX_EVENTS    256
+#define RBUF_INITIAL  16384
+#define RBUF_MAX      (128 * 1024)
+#define RBUF_MIN_READ 4096
+#define OUT_HIGH       (256 * 1024)   /* stop parsing above this much queued output */
+#define OUT_BATCH_MAX  (64 * 1024)    /* flush a batch early past this size */
+#define OUT_LARGE_BODY (16 * 1024)    /* ...or right after a body this large */
+#define OUT_IOV_MAX    1024           /* iovecs per sendmsg (IOV_MAX) */
+#define FILE_CACHE     4096           /* -r: open files cached per worker */
+
+typedef struct {
+    const char *addr;
+    u16         port;
+    u32         threads;
+    int         first_cpu;
+    bool        uring;
+    const char *root;
+} server_opts_t;
+
+typedef struct conn {
+    int           fd;
+    h11_parser_t *parser;
+    char         *rbuf;
+    usize         rcap;
+    usize         rlen;
+    usize         rstart;     /* first byte the current request still needs */
+    usize         roff;       /* first byte the parser has not consumed */
+    struct iovec *out;        /* queued responses; all point at static data */
+    u32           out_cap;
+    u32           out_len;
+    u32           out_pos;    /* first iovec not fully written */
+    usize         out_bytes;  /* queued bytes not yet written */
+    bool          head_done;  /* current request's header section parsed */
+    bool          keep_alive;
+    bool          is_head;
+    bool          http10;
+    bool          closing;    /* close once the output drains */
+    bool          drain;      /* hold input until the output drains */
+    bool          file_body;  /* reply's body still to go out with sendfile */
+    h11_file_reply_t *reply;  /* -r: reply for the current request */
+    const h11_file_t **held;  /* -r: files queued output still points into */
+    u32           held_len;
+    u32           held_cap;
+    /* io_uring only: the kernel reads sout while a send is in flight, so new
+     * responses queue in out and the two swap when it completes. */
+    struct iovec *sout;
+    u32           sout_cap;
+    u32           sout_len;
+    u32           sout_pos;
+    struct msghdr msg;
+    u32           ops;        /* submitted operations not yet completed */
+    bool          recv_armed; /* a multishot recv is outstanding */
+    bool          recv_cancel;
+    bool          eof;        /* the client half-closed; answer what is buffered */
+    bool          sending;
+    bool          dead;       /* shut down; freed once ops reaches zero */
+} conn_t;
+
+struct uring;
+
+typedef struct {
+    u32            id;
+    int            cpu;
+    pthread_t      thread;
+    int            lfd;
+    int            ep;
+    struct uring  *ring;
+    h11_parser_t **pool;
+    h11_file_cache_t *files;
+    u32            pool_len;
+    u32            pool_cap;
+    u64            conns;
+    u64            requests;
+    u64            errors;
+} worker_t;
+
+static const char resp_body[] = "Hello, World!\n";
+static const char resp_200[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 14\r\n\r\n";
+static const char resp_200_close[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 14\r\n"
+    "Connection: close\r\n\r\n";
+static const char resp_200_keep[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 14\r\n"
+    "Connection: keep-alive\r\n\r\n";
+
+static server_opts_t opts = { .addr = "127.0.0.1", .port = 8080, .threads = 1 };
+static volatile sig_atomic_t stopping;
+static const h11_config_t *parser_config;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+/* ---- parser pool ---- */
+
+static h11_parser_t *pool_get(worker_t *w) {
+    if (w->pool_len > 0)
+        return w->pool[--w->pool_len];
+    return h11_parser_new(parser_config);
+}
+
+static void pool_put(worker_t *w, h11_parser_t *p) {
+    if (w->pool_len == w->pool_cap) {
+        u32 ncap = w->pool_cap ? w->pool_cap * 2 : 64;
+        h11_parser_t **n = realloc(w->pool, ncap * sizeof(*n));
+        if (n == NULL) {
+            h11_parser_free(p);
+            return;
+        }
+        w->pool = n;
+        w->pool_cap = ncap;
+    }
+    h11_parser_reset(p);
+    w->pool[w->pool_len++] = p;
+}
+
+/* ---- connections ---- */
+
+static conn_t *conn_new(worker_t *w, int fd) {
+    conn_t *c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return NULL;
+    c->fd = fd;
+    c->parser = pool_get(w);
+    if (c->parser == NULL) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* Queued output is gone: the files it pointed into may be evicted. */
+static void conn_release(conn_t *c) {
+    for (u32 i = 0; i < c->held_len; i++)
+        h11_file_release(c->held[i]);
+    c->held_len = 0;
+}
+
+static void conn_close(worker_t *w, conn_t *c) {
+    conn_release(c);
+    free(c->held);
+    close(c->fd);
+    pool_put(w, c->parser);
+    free(c->rbuf);
+    free(c->out);
+    free(c->sout);
+    free(c->reply);
+    free(c);
+}
+
+static bool out_push(conn_t *c, const char *data, usize len) {
+    if (len == 0)
+        return true;
+    if (c->out_len == c->out_cap) {
+        u32 ncap = c->out_cap ? c->out_cap * 2 : 64;
+        struct iovec *n = realloc(c->out, ncap * sizeof(*n));
+        if (n == NULL)
+            return false;
+        c->out = n;
+        c->out_cap = ncap;
+    }
+    c->out[c->out_len].iov_base = (void *)data;
+    c->out[c->out_len].iov_len = len;
+    c->out_len++;
+    c->out_bytes += len;
+    return true;
+}
+
+/* Step past n written bytes, trimming a partly written iovec in place. */
+static void iov_advance(struct iovec *iov, u32 *pos, usize n) {
+    while (n > 0) {
+        struct iovec *v = &iov[*pos];
+        if (n < v->iov_len) {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= n;
+            return;
+        }
+        n -= v->iov_len;
+        (*pos)++;
+    }
+}
+
+#if H11D_URING
+static void uring_flush(worker_t *w, conn_t *c);
+#endif
+
+/* Write what is queued, OUT_IOV_MAX iovecs per sendmsg; false if the
+ * connection is dead. Under io_uring this submits the send instead. */
+static bool conn_flush(worker_t *w, conn_t *c) {
+#if H11D_URING
+    if (opts.uring) {
+        uring_flush(w, c);
+        return true;
+    }
+#endif
+    (void)w;
+    while (c->out_pos < c->out_len) {
+        struct msghdr m = { .msg_iov = c->out + c->out_pos };
+        m.msg_iovlen = c->out_len - c->out_pos < OUT_IOV_MAX ? c->out_len - c->out_pos
+                                                             : OUT_IOV_MAX;
+        /* MSG_MORE keeps a file's head back until sendfile adds its body. */
+        ssize_t n = sendmsg(c->fd, &m, MSG_NOSIGNAL | (c->file_body ? MSG_MORE : 0));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->out_bytes -= (usize)n;
+        iov_advance(c->out, &c->out_pos, (usize)n);
+    }
+    c->out_pos = c->out_len = 0;
+    if (c->file_body) {
+        u64 sent;
+        h11_error_t err = h11_file_send(c->fd, c->reply, &sent);
+        if (err != H11_OK)
+            return err == H11_NEED_MORE_DATA;
+        c->file_body = false;
+    }
+    c->drain = false;
+    conn_release(c);
+    return true;
+}
+
+/* Queue one response; head and body must outlive the write. Responses to
+ * everything parsed from one read leave together in one flush, which only
+ * happens early once the batch passes OUT_BATCH_MAX or a body alone reaches
+ * OUT_LARGE_BODY, so a big response is not held behind later parsing. */
+static bool conn_send(worker_t *w, conn_t *c, const char *head, usize head_len,
+                      const char *body, usize body_len) {
+    if (!out_push(c, head, head_len) || !out_push(c, body, body_len))
+        return false;
+    if (c->out_bytes < OUT_BATCH_MAX && body_len < OUT_LARGE_BODY)
+        return true;
+    return conn_flush(w, c);
+}
+
+/* -r: decide the reply while the header section is still buffered; a body
+ * may push it out of the read buffer before the request completes. */
+static bool file_prepare(worker_t *w, conn_t *c, const h11_request_t *r, const char *base) {
+    if (c->reply == NULL && (c->reply = malloc(sizeof(*c->reply))) == NULL)
+        return false;
+    h11_file_reply_t *fr = c->reply;
+    const char *m = base + r->method.off;
+    bool get = (r->method.len == 3 && memcmp(m, "GET", 3) == 0) || c->is_head;
+    const h11_file_t *f = NULL;
+    if (get && r->target_form == H11_TARGET_ORIGIN) {
+        const char *t = base + r->target.off;
+        const char *q = memchr(t, '?', r->target.len);
+        f = h11_file_open(w->files, t, q != NULL ? (usize)(q - t) : r->target.len);
+    }
+    if (f != NULL) {
+        if (c->held_len == c->held_cap) {
+            u32 ncap = c->held_cap ? c->held_cap * 2 : 8;
+            const h11_file_t **n = realloc(c->held, ncap * sizeof(*n));
+            if (n == NULL) {
+                h11_file_release(f);
+                return false;
+            }
+            c->held = n;
+            c->held_cap = ncap;
+        }
+        c->held[c->held_len++] = f;
+        return h11_file_reply(f, r, base, fr) == H11_OK;
+    }
+    fr->status = get ? 404 : 405;
+    fr->head = fr->buf;
+    const char *conn = !c->keep_alive ? "Connection: close\r\n"
+                       : c->http10    ? "Connection: keep-alive\r\n"
+                                      : "";
+    fr->head_len = (usize)snprintf(fr->buf, sizeof(fr->buf),
+                                   "HTTP/1.1 %s\r\n%sContent-Length: 0\r\n%s\r\n",
+                                   get ? "404 Not Found" : "405 Method Not Allowed",
+                                   get ? "" : "Allow: GET, HEAD\r\n", conn);
+    fr->data = NULL;
+    fr->len = 0;
+    return true;
+}
+
+/* A reply whose head lives in c->reply (anything but a cached keep-alive
+ * 200) or whose body needs sendfile holds further input until it is out. */
+static bool file_respond(worker_t *w, conn_t *c) {
+    h11_file_reply_t *fr = c->reply;
+    if (!c->keep_alive)
+        c->closing = true;
+    c->file_body = fr->data == NULL && fr->len > 0;
+    c->drain = c->file_body || fr->head == fr->buf;
+    const char *head = fr->head;
+    usize head_len = fr->head_len;
+    fr->head_len = 0;
+    return conn_send(w, c, head, head_len, fr->data, fr->data != NULL ? (usize)fr->len : 0);
+}
+
+static bool respond(worker_t *w, conn_t *c) {
+    w->requests++;
+    if (w->files != NULL)
+        return file_respond(w, c);
+    const char *head = resp_200;
+    usize head_len = sizeof(resp_200) - 1;
+    if (!c->keep_alive) {
+        head = resp_200_close;
+        head_len = sizeof(resp_200_close) - 1;
+        c->closing = true;
+    } else if (c->http10) {
+        head = resp_200_keep;
+        head_len = sizeof(resp_200_keep) - 1;
+    }
+    return conn_send(w, c, head, head_len, resp_body, c->is_head ? 0 : sizeof(resp_body) - 1);
+}
+
+/* Drive the parser over everything buffered, answering each complete
+ * request in order. Stops early while too much output is queued. */
+static bool conn_process(worker_t *w, conn_t *c) {
+    h11_parser_t *p = c->parser;
+    while (!c->closing && !c->drain && c->out_bytes < OUT_HIGH) {
+        h11_state_t st = h11_get_state(p);
+        usize used = 0;
+        h11_error_t err;
+        if (st == H11_STATE_COMPLETE) {
+            if (!respond(w, c))
+                return false;
+            h11_parser_reset(p);
+            c->head_done = false;
+            c->rstart = c->roff;
+            continue;
+        }
+        if (c->roff == c->rlen)
+            return true;
+        if (st == H11_STATE_BODY_IDENTITY || st == H11_STATE_BODY_CHUNKED_DATA) {
+            const char *body;
+            usize body_len;
+            err = h11_read_body(p, c->rbuf + c->roff, c->rlen - c->roff, &used, &body, &body_len);
+        } else {
+            err = h11_parse(p, c->rbuf + c->roff, c->rlen - c->roff, &used);
+        }
+        c->roff += used;
+        if (err == H11_NEED_MORE_DATA)
+            return true;
+        if (err != H11_OK) {
+            usize len;
+            const char *resp = h11_error_response(err, &len);
+            if (resp == NULL)
+                resp = h11_error_response(H11_ERR_INTERNAL, &len);
+            w->errors++;
+            c->closing = true;
+            return conn_send(w, c, resp, len, NULL, 0);
+        }
+        if (!c->head_done && h11_get_state(p) > H11_STATE_HEADERS) {
+            /* Everything the response needs is taken from the header section
+             * here, so the bytes before the body can be dropped. */
+            const h11_request_t *r = h11_get_request(p);
+            const char *base = c->rbuf + c->rstart;
+            c->head_done = true;
+            c->keep_alive = (r->flags & H11_REQF_KEEP_ALIVE) != 0;
+            c->http10 = (r->version & 0xFF) == 0;
+            c->is_head = r->method.len == 4 && memcmp(base + r->method.off, "HEAD", 4) == 0;
+            c->rstart = c->roff;
+            if (w->files != NULL && !file_prepare(w, c, r, base))
+                return false;
+            /* Answer Expect before reading the body. A client that sent body
+             * bytes without waiting gets no 100. */
+            const char *resp;
+            usize len;
+            u16 status = h11_expect_response(p, &resp, &len);
+            if (status == 417) {
+                w->errors++;
+                c->closing = true;
+                return conn_send(w, c, resp, len, NULL, 0);
+            }
+            if (status == 100 && c->roff == c->rlen && !conn_send(w, c, resp, len, NULL, 0))
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Make room for want more bytes: drop what the current request no longer
+ * needs, then grow up to max. Short of want, any free space at all still
+ * counts as success. */
+static bool rbuf_reserve(conn_t *c, usize want, usize max) {
+    if (c->rcap - c->rlen >= want)
+        return true;
+    if (c->rstart > 0) {
+        memmove(c->rbuf, c->rbuf + c->rstart, c->rlen - c->rstart);
+        c->rlen -= c->rstart;
+        c->roff -= c->rstart;
+        c->rstart = 0;
+        if (c->rcap - c->rlen >= want)
+            return true;
+    }
+    usize ncap = c->rcap ? c->rcap : RBUF_INITIAL;
+    while (ncap - c->rlen < want && ncap < max)
+        ncap *= 2;
+    if (ncap != c->rcap) {
+        char *n = realloc(c->rbuf, ncap);
+        if (n == NULL)
+            return false;
+        c->rbuf = n;
+        c->rcap = ncap;
+    }
+    return c->rlen < c->rcap;
+}
+
+/* Edge-triggered: read until EAGAIN, parsing after every read and writing
+ * the responses to each read's requests in one go. */
+static bool conn_readable(worker_t *w, conn_t *c) {
+    for (;;) {
+        if (c->closing || c->drain || c->out_bytes >= OUT_HIGH)
+            return true;
+        if (!rbuf_reserve(c, RBUF_MIN_READ, RBUF_MAX))
+            return false;
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, c->rcap - c->rlen, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (n == 0)
+            return false;
+        c->rlen += (usize)n;
+        if (!conn_process(w, c) || !conn_flush(w, c))
+            return false;
+    }
+}
+
+static bool conn_writable(worker_t *w, conn_t *c) {
+    if (!conn_flush(w, c))
+        return false;
+    if (c->out_bytes != 0 || c->file_body)
+        return true;
+    if (c->closing)
+        return false;
+    /* Output drained below the high-water mark: resume buffered input. */
+    return conn_process(w, c) && conn_flush(w, c) && conn_readable(w, c);
+}
+
+/* ---- io_uring backend ---- */
+
+#if H11D_URING
+
+#define URING_ENTRIES 1024
+#define PBUF_COUNT    1024    /* power of two */
+#define PBUF_SIZE     4096
+#define PBUF_GROUP    0
+
+/* user_data is the connection pointer with the operation in its low bits. */
+enum { OP_ACCEPT = 0, OP_RECV, OP_SEND, OP_SHUTDOWN, OP_CANCEL, OP_MASK = 7 };
+
+struct uring {
+    int                  fd;
+    u32                 *sq_head;
+    u32                 *sq_tail;
+    u32                  sq_mask;
+    u32                  sq_entries;
+    u32                  sq_local;     /* tail as filled; published by uring_enter */
+    struct io_uring_sqe *sqes;
+    u32                 *cq_head;
+    u32                 *cq_tail;
+    u32                  cq_mask;
+    struct io_uring_cqe *cqes;
+    void                *ring_map;
+    usize                ring_len;
+    usize                sqes_len;
+    struct io_uring_buf *br;           /* provided-buffer ring shared with the kernel */
+    u16                 *br_tail;
+    u16                  br_local;
+    char                *bufs;
+};
+
+static int uring_enter(struct uring *u, bool wait) {
+    u32 submit = u->sq_local - *u->sq_tail;
+    __atomic_store_n(u->sq_tail, u->sq_local, __ATOMIC_RELEASE);
+    struct __kernel_timespec ts = { .tv_nsec = 200 * 1000 * 1000 };
+    struct io_uring_getevents_arg arg = { .ts = (u64)(uintptr_t)&ts };
+    if (!wait)
+        return (int)syscall(__NR_io_uring_enter, u->fd, submit, 0, 0, NULL, 0);
+    return (int)syscall(__NR_io_uring_enter, u->fd, submit, 1,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/* Make sure n SQEs can be taken without a submission in between, so a
+ * linked chain never straddles two io_uring_enter calls. */
+static void uring_reserve(struct uring *u, u32 n) {
+    while (u->sq_local - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + n > u->sq_entries)
+        uring_enter(u, false);
+}
+
+static struct io_uring_sqe *uring_sqe(struct uring *u, u64 user_data) {
+    uring_reserve(u, 1);
+    struct io_uring_sqe *sqe = &u->sqes[u->sq_local++ & u->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+static void pbuf_put(struct uring *u, u16 bid) {
+    struct io_uring_buf *b = &u->br[u->br_local & (PBUF_COUNT - 1)];
+    b->addr = (u64)(uintptr_t)(u->bufs + (usize)bid * PBUF_SIZE);
+    b->len = PBUF_SIZE;
+    b->bid = bid;
+    __atomic_store_n(u->br_tail, ++u->br_local, __ATOMIC_RELEASE);
+}
+
+static void uring_free(struct uring *u) {
+    if (u->sqes != NULL && u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_len);
+    if (u->ring_map != NULL && u->ring_map != MAP_FAILED)
+        munmap(u->ring_map, u->ring_len);
+    if (u->br != NULL && u->br != MAP_FAILED)
+        munmap(u->br, PBUF_COUNT * sizeof(struct io_uring_buf));
+    if (u->fd >= 0)
+        close(u->fd);
+    free(u->bufs);
+}
+
+static bool uring_init(struct uring *u) {
+    memset(u, 0, sizeof(*u));
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = URING_ENTRIES * 8;
+    u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        /* Kernels before 6.1 lack DEFER_TASKRUN. */
+        p.flags = IORING_SETUP_CQSIZE;
+        u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    }
+    if (u->fd < 0)
+        return false;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        errno = ENOSYS;
+        goto fail;
+    }
+    usize sq_len = p.sq_off.array + p.sq_entries * sizeof(u32);
+    usize cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ring_len = sq_len > cq_len ? sq_len : cq_len;
+    u->ring_map = mmap(NULL, u->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       u->fd, IORING_OFF_SQ_RING);
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd,
+                   IORING_OFF_SQES);
+    if (u->ring_map == MAP_FAILED || u->sqes == MAP_FAILED)
+        goto fail;
+    char *m = u->ring_map;
+    u->sq_head = (u32 *)(m + p.sq_off.head);
+    u->sq_tail = (u32 *)(m + p.sq_off.tail);
+    u->sq_mask = *(u32 *)(m + p.sq_off.ring_mask);
+    u->sq_entries = p.sq_entries;
+    u->sq_local = *u->sq_tail;
+    u32 *array = (u32 *)(m + p.sq_off.array);
+    for (u32 i = 0; i < p.sq_entries; i++)
+        array[i] = i;
+    u->cq_head = (u32 *)(m + p.cq_off.head);
+    u->cq_tail = (u32 *)(m + p.cq_off.tail);
+    u->cq_mask = *(u32 *)(m + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(m + p.cq_off.cqes);
+
+    /* The ring's tail lives in the reserved field of its first entry. */
+    u->br = mmap(NULL, PBUF_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufs = malloc((usize)PBUF_COUNT * PBUF_SIZE);
+    if (u->br == MAP_FAILED || u->bufs == NULL)
+        goto fail;
+    u->br_tail = &u->br[0].resv;
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (u64)(uintptr_t)u->br, .ring_entries = PBUF_COUNT, .bgid = PBUF_GROUP
+    };
+    if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        goto fail;
+    for (u32 i = 0; i < PBUF_COUNT; i++)
+        pbuf_put(u, (u16)i);
+    return true;
+fail:;
+    int saved = errno;
+    uring_free(u);
+    u->fd = -1;
+    errno = saved;
+    return false;
+}
+
+static void arm_accept(worker_t *w) {
+    struct io_uring_sqe *sqe = uring_sqe(w->ring, OP_ACCEPT);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = w->lfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+static void arm_recv(worker_t *w, conn_t *c) {
+    struct io_uring_sqe *sqe = uring_sqe(w->ring, (u64)(uintptr_t)c | OP_RECV);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = PBUF_GROUP;
+    c->ops++;
+    c->recv_armed = true;
+}
+
+/* A multishot recv cannot be paused, so a connection whose output is backed
+ * up has it cancelled and re-armed once the output drains; the socket buffer
+ * then pushes back on the client the way an idle epoll reader would. */
+static void uring_throttle(worker_t *w, conn_t *c) {
+    if (c->dead || c->closing || c->eof)
+        return;
+    if (c->out_bytes < OUT_HIGH) {
+        if (!c->recv_armed)
+            arm_recv(w, c);
+    } else if (c->recv_armed && !c->recv_cancel) {
+        struct io_uring_sqe *sqe = uring_sqe(w->ring, (u64)(uintptr_t)c | OP_CANCEL);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = (u64)(uintptr_t)c | OP_RECV;
+        c->ops++;
+        c->recv_cancel = true;
+    }
+}
+
+/* Send the next OUT_IOV_MAX iovecs of sout as one sendmsg. The last
+ * response on a connection carries a linked shutdown, which also ends its
+ * multishot recv. MSG_WAITALL makes a short send a failure, so the link
+ * never cuts a response off. */
+static void uring_send(worker_t *w, conn_t *c) {
+    u32 n = c->sout_len - c->sout_pos < OUT_IOV_MAX ? c->sout_len - c->sout_pos : OUT_IOV_MAX;
+    memset(&c->msg, 0, sizeof(c->msg));
+    c->msg.msg_iov = c->sout + c->sout_pos;
+    c->msg.msg_iovlen = n;
+    uring_reserve(w->ring, 2);
+    struct io_uring_sqe *sqe = uring_sqe(w->ring, (u64)(uintptr_t)c | OP_SEND);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->fd;
+    sqe->addr = (u64)(uintptr_t)&c->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    c->sending = true;
+    c->ops++;
+    if (c->closing && c->out_len == 0 && c->sout_pos + n == c->sout_len) {
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe = uring_sqe(w->ring, (u64)(uintptr_t)c | OP_SHUTDOWN);
+        sqe->opcode = IORING_OP_SHUTDOWN;
+        sqe->fd = c->fd;
+        sqe->len = SHUT_RDWR;
+        c->ops++;
+        c->dead = true;
+    }
+}
+
+static void uring_kill(conn_t *c) {
+    if (c->dead)
+        return;
+    c->dead = true;
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+/* Submit everything queued since the last send as one batch. A closing
+ * connection with nothing left to send is shut down here. */
+static void uring_flush(worker_t *w, conn_t *c) {
+    if (c->sending || c->dead)
+        return;
+    if (c->out_len == 0) {
+        if (c->closing)
+            uring_kill(c);
+        return;
+    }
+    struct iovec *v = c->sout;
+    u32 cap = c->sout_cap;
+    c->sout = c->out;
+    c->sout_cap = c->out_cap;
+    c->sout_len = c->out_len;
+    c->sout_pos = 0;
+    c->out = v;
+    c->out_cap = cap;
+    c->out_len = c->out_pos = 0;
+    c->out_bytes = 0;
+    uring_send(w, c);
+}
+
+/* Parse what the connection holds; once nothing is pending, give its read
+ * buffer back. */
+static bool uring_resume(worker_t *w, conn_t *c) {
+    if (!conn_process(w, c))
+        return false;
+    /* After EOF, once no request is held back the connection closes; its
+     * last send carries the shutdown. */
+    if (c->eof && c->out_bytes < OUT_HIGH)
+        c->closing = true;
+    if (c->rstart == c->rlen) {
+        free(c->rbuf);
+        c->rbuf = NULL;
+        c->rcap = c->rlen = c->rstart = c->roff = 0;
+    }
+    return true;
+}
+
+/* With nothing pending the parser runs directly on the provided buffer and
+ * only an unfinished request is copied out; otherwise the data joins the
+ * pending bytes. */
+static bool uring_input(worker_t *w, conn_t *c, char *data, usize n) {
+    if (c->rlen == 0) {
+        char *own = c->rbuf;
+        usize own_cap = c->rcap;
+        c->rbuf = data;
+        c->rcap = c->rlen = n;
+        c->rstart = c->roff = 0;
+        bool ok = conn_process(w, c);
+        usize start = c->rstart, off = c->roff;
+        c->rbuf = own;
+        c->rcap = own_cap;
+        c->rlen = c->rstart = c->roff = 0;
+        if (!ok || start == n)
+            return ok;
+        if (!rbuf_reserve(c, n - start, RBUF_MAX) || c->rcap < n - start)
+            return false;
+        memcpy(c->rbuf, data + start, n - start);
+        c->rlen = n - start;
+        c->roff = off - start;
+        return true;
+    }
+    /* Throttled input keeps arriving until the cancel lands; the provided
+     * buffers bound how much. */
+    usize max = c->out_bytes >= OUT_HIGH ? RBUF_MAX + (usize)PBUF_COUNT * PBUF_SIZE : RBUF_MAX;
+    if (!rbuf_reserve(c, n, max) || c->rcap - c->rlen < n)
+        return false;
+    memcpy(c->rbuf + c->rlen, data, n);
+    c->rlen += n;
+    return uring_resume(w, c);
+}
+
+static void uring_accept(worker_t *w, int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn_t *c = conn_new(w, fd);
+    if (c == NULL) {
+        close(fd);
+        return;
+    }
+    w->conns++;
+    arm_recv(w, c);
+}
+
+static void uring_complete(worker_t *w, const struct io_uring_cqe *cqe) {
+    struct uring *u = w->ring;
+    conn_t *c = (conn_t *)(uintptr_t)(cqe->user_data & ~(u64)OP_MASK);
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    int res = cqe->res;
+    switch (cqe->user_data & OP_MASK) {
+    case OP_ACCEPT:
+        if (res >= 0)
+            uring_accept(w, res);
+        if (!more && !stopping)
+            arm_accept(w);
+        return;
+    case OP_RECV:
+        if (!more) {
+            c->ops--;
+            c->recv_armed = c->recv_cancel = false;
+        }
+        if (res > 0) {
+            u16 bid = (u16)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            char *data = u->bufs + (usize)bid * PBUF_SIZE;
+            if (!c->dead && !c->closing && !uring_input(w, c, data, (usize)res))
+                uring_kill(c);
+            pbuf_put(u, bid);
+        } else if (res == 0) {
+            /* Responses to what arrived with the EOF may not be submitted
+             * yet, so the connection drains rather than dies. */
+            c->eof = true;
+            if (!c->dead && !c->closing && !uring_resume(w, c))
+                uring_kill(c);
+        } else if (res != -ENOBUFS && res != -ECANCELED) {
+            uring_kill(c);
+        }
+        uring_throttle(w, c);
+        break;
+    case OP_SEND:
+        c->ops--;
+        c->sending = false;
+        if (res < 0) {
+            uring_kill(c);
+            break;
+        }
+        iov_advance(c->sout, &c->sout_pos, (usize)res);
+        if (c->dead)
+            break;
+        if (c->sout_pos < c->sout_len) {
+            uring_send(w, c);
+            break;
+        }
+        /* The output queue has room again: parse any held-back input. */
+        if (!c->closing && !uring_resume(w, c))
+            uring_kill(c);
+        uring_throttle(w, c);
+        break;
+    case OP_SHUTDOWN:
+        c->ops--;
+        if (res < 0)
+            shutdown(c->fd, SHUT_RDWR);
+        break;
+    case OP_CANCEL:
+        c->ops--;
+        break;
+    }
+    uring_flush(w, c);
+    if (c->dead && c->ops == 0)
+        conn_close(w, c);
+}
+
+static void *uring_main(worker_t *w) {
+    struct uring u;
+    if (!uring_init(&u)) {
+        fprintf(stderr, "h11d: worker %u: io_uring unavailable: %s\n", w->id, strerror(errno));
+        stopping = 1;
+        return NULL;
+    }
+    w->ring = &u;
+    arm_accept(w);
+    while (!stopping) {
+        if (uring_enter(&u, true) < 0 && errno != EINTR && errno != ETIME && errno != EBUSY &&
+            errno != EAGAIN)
+            break;
+        u32 head = *u.cq_head;
+        u32 tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+            uring_complete(w, &u.cqes[head & u.cq_mask]);
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+    }
+    w->ring = NULL;
+    uring_free(&u);
+    return NULL;
+}
+
+#endif /* H11D_URING */
+
+/* ---- workers ---- */
+
+static int listen_socket(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(opts.port) };
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+        inet_pton(AF_INET, opts.addr, &sa.sin_addr) != 1 ||
+        bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 4096) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void accept_all(worker_t *w) {
+    for (;;) {
+        int fd = accept4(w->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conn_t *c = conn_new(w, fd);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET };
+        ev.data.ptr = c;
+        if (c == NULL || epoll_ctl(w->ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            if (c != NULL)
+                conn_close(w, c);
+            else
+                close(fd);
+            continue;
+        }
+        w->conns++;
+    }
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#if H11D_URING
+    if (opts.uring)
+        return uring_main(w);
+#endif
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = NULL };
+    if (epoll_ctl(w->ep, EPOLL_CTL_ADD, w->lfd, &ev) != 0)
+        return NULL;
+    struct epoll_event events[MAX_EVENTS];
+    while (!stopping) {
+        int n = epoll_wait(w->ep, events, MAX_EVENTS, 200);
+        for (int i = 0; i < n; i++) {
+            conn_t *c = events[i].data.ptr;
+            if (c == NULL) {
+                accept_all(w);
+                continue;
+            }
+            u32 e = events[i].events;
+            bool ok = !(e & EPOLLERR);
+            if (ok && (e & EPOLLIN))
+                ok = conn_readable(w, c);
+            if (ok && (e & EPOLLOUT))
+                ok = conn_writable(w, c);
+            if (ok && c->closing && c->out_bytes == 0 && !c->file_body)
+                ok = false;
+            if (!ok)
+                conn_close(w, c);
+        }
+    }
+    h11_file_cache_free(w->files);
+    return NULL;
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-a addr] [-p port] [-t threads] [-c first_cpu] [-u] [-r root]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    opts.threads = ncpu > 0 ? (u32)ncpu : 1;
+    opts.first_cpu = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-u") == 0) {
+            opts.uring = true;
+            continue;
+        }
+        if (argv[i][0] != '-' || i + 1 >= argc)
+            return usage(argv[0]);
+        const char *v = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'a': opts.addr = v; break;
+        case 'p': opts.port = (u16)strtoul(v, NULL, 10); break;
+        case 't': opts.threads = (u32)strtoul(v, NULL, 10); break;
+        case 'c': opts.first_cpu = atoi(v); break;
+        case 'r': opts.root = v; break;
+        default: return usage(argv[0]);
+        }
+    }
+    if (opts.threads == 0 || opts.threads > MAX_WORKERS)
+        return usage(argv[0]);
+    if (opts.uring && !H11D_URING) {
+        fprintf(stderr, "h11d: built without io_uring support\n");
+        return 1;
+    }
+    if (opts.uring && opts.root != NULL) {
+        fprintf(stderr, "h11d: -r needs the epoll engine\n");
+        return 1;
+    }
+
+    static h11_config_t cfg;
+    cfg = h11_config_default();
+    parser_config = &cfg;
+    /* Parsers are created on the workers; settle the SIMD level first. */
+    h11_parser_free(h11_parser_new(parser_config));
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    static worker_t workers[MAX_WORKERS];
+    for (u32 i = 0; i < opts.threads; i++) {
+        worker_t *w = &workers[i];
+        w->id = i;
+        w->cpu = opts.first_cpu >= 0 ? (opts.first_cpu + (int)i) % (int)(ncpu > 0 ? ncpu : 1) : -1;
+        w->lfd = listen_socket();
+        w->ep = opts.uring ? -1 : epoll_create1(EPOLL_CLOEXEC);
+        if (w->lfd < 0 || (!opts.uring && w->ep < 0)) {
+            fprintf(stderr, "h11d: cannot listen on %s:%u: %s\n", opts.addr, opts.port,
+                    strerror(errno));
+            return 1;
+        }
+        if (opts.root != NULL && (w->files = h11_file_cache_new(opts.root, FILE_CACHE)) == NULL) {
+            fprintf(stderr, "h11d: cannot open %s: %s\n", opts.root, strerror(errno));
+            return 1;
+        }
+    }
+    for (u32 i = 0; i < opts.threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "h11d: cannot start worker %u\n", i);
+            stopping = 1;
+            opts.threads = i;
+            break;
+        }
+    }
+    fprintf(stderr, "h11d: %u %s workers on %s:%u (simd %s)\n", opts.threads,
+            opts.uring ? "io_uring" : "epoll", opts.addr, opts.port,
+            h11_simd_name(h11_simd_active()));
+
+    u64 conns = 0, requests = 0, errors = 0;
+    for (u32 i = 0; i < opts.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        conns += workers[i].conns;
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        close(workers[i].lfd);
+        if (workers[i].ep >= 0)
+            close(workers[i].ep);
+        for (u32 k = 0; k < workers[i].pool_len; k++)
+            h11_parser_free(workers[i].pool[k]);
+        free(workers[i].pool);
+    }
+    fprintf(stderr, "h11d: %llu connections, %llu requests, %llu errors\n",
+            (unsigned long long)conns, (unsigned long long)requests, (unsigned long long)errors);
+    return 0;
+}
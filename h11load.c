@@ -0,0 +1,775 @@
+/*
+ * h11load.c — Loopback HTTP/1.1 load generator with pipelining and a latency
+ *             histogram corrected for coordinated omission
+ *
+ * Usage: h11load [-a addr] [-p port] [-c conns] [-t threads] [-d seconds]
+ *                [-D depth] [-r rate] [-g] [-H] [path...]
+ * Requests are replayed round-robin from each path, a request file or a
+ * directory of them (default: sample_requests); -g replaces the corpus with
+ * generated GETs. Every sample goes through h11_parse first and only complete
+ * keep-alive requests that do not switch protocols are kept.
+ *
+ * Each connection keeps up to depth requests in flight. With -r the total
+ * rate is split evenly over the connections and every request has an
+ * intended send time on a fixed schedule. Latency is measured from that time
+ * rather than from when the request actually went out, so a stalled server is
+ * charged for the requests it held back (the wrk2 correction for coordinated
+ * omission); the uncorrected send-to-response time is reported beside it.
+ * Without -r connections run closed-loop and only the latter exists.
+ *
+ * h11 parses requests only, so replies are framed here: status line, then a
+ * Content-Length or chunked body. 1xx responses are skipped; HEAD, 204 and
+ * 304 have no body. A reply with Connection: close reconnects.
+ *
+ * -H runs a half-close check instead of a load: conns connections, one at a
+ * time, each write depth requests, shut down their write side and must read
+ * every response before the server's EOF. The exit status is 1 if any falls
+ * short.
+ */
+#define _GNU_SOURCE
+#include "h11.h"
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES  1024
+#define MAX_THREADS  256
+#define MAX_EVENTS   256
+#define RBUF_SIZE    65536
+#define GEN_SAMPLES  64
+
+/* HDR histogram: 2048 linear sub-buckets per power of two keep three
+ * significant digits; 30 doublings reach about 18 minutes in nanoseconds. */
+#define HDR_SUB_BITS 11
+#define HDR_SUB_HALF (1u << (HDR_SUB_BITS - 1))
+#define HDR_BUCKETS  30
+#define HDR_SLOTS    ((HDR_BUCKETS + 1) * HDR_SUB_HALF)
+
+typedef struct {
+    u64 counts[HDR_SLOTS];
+    u64 total;
+    u64 sum;
+    u64 max;
+} hdr_t;
+
+typedef struct {
+    const char *addr;
+    u16         port;
+    u32         conns;
+    u32         threads;
+    u32         seconds;
+    u32         depth;
+    u64         rate;
+    bool        generate;
+    bool        half_close;
+} load_opts_t;
+
+typedef struct {
+    char *buf;
+    usize len;
+    bool  head;
+} sample_t;
+
+typedef struct {
+    u64  intended;
+    u64  sent;
+    bool head;
+} pending_t;
+
+enum { RESP_HEAD, RESP_BODY, RESP_CHUNK_SIZE, RESP_CHUNK_DATA, RESP_CHUNK_CRLF, RESP_TRAILERS };
+
+typedef struct {
+    int        fd;
+    u32        next_sample;
+    pending_t *q;            /* ring of depth entries, oldest first */
+    u32        q_head;
+    u32        q_len;
+    u64        interval;     /* -r: ns between this connection's intended sends */
+    u64        next_due;
+    char      *wbuf;
+    usize      wcap;
+    usize      wlen;
+    usize      wpos;
+    char      *rbuf;
+    usize      rlen;
+    usize      rpos;
+    u8         resp_state;
+    u16        status;
+    bool       chunked;
+    bool       has_length;
+    bool       resp_close;
+    u64        body_left;
+} conn_t;
+
+typedef struct {
+    u32       id;
+    pthread_t thread;
+    int       ep;
+    conn_t   *conns;
+    u32       nconns;
+    u32       cursor;        /* -r: next connection on the schedule */
+    hdr_t    *latency;       /* from intended send time */
+    hdr_t    *service;       /* from actual send time */
+    u64       responses;
+    u64       non2xx;
+    u64       bytes;
+    u64       errors;
+    u64       lost;          /* requests in flight on a connection that failed */
+    u64       reconnects;
+} thread_t;
+
+static load_opts_t opts = {
+    .addr = "127.0.0.1", .port = 8080, .conns = 64, .threads = 1, .seconds = 10, .depth = 1
+};
+static sample_t samples[MAX_SAMPLES];
+static u32 sample_count;
+static struct sockaddr_in target;
+static u64 start_ns, end_ns;
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000u + (u64)ts.tv_nsec;
+}
+
+/* ---- histogram ---- */
+
+static u32 hdr_index(u64 v) {
+    u32 bucket = (u32)(63 - __builtin_clzll(v | ((1u << HDR_SUB_BITS) - 1))) + 1 - HDR_SUB_BITS;
+    if (bucket > HDR_BUCKETS - 1)
+        return HDR_SLOTS - 1;
+    return bucket * HDR_SUB_HALF + (u32)(v >> bucket);
+}
+
+/* Highest value that lands in slot i. */
+static u64 hdr_value(u32 i) {
+    u32 bucket = i < 2 * HDR_SUB_HALF ? 0 : i / HDR_SUB_HALF - 1;
+    u64 sub = i - (u64)bucket * HDR_SUB_HALF;
+    return ((sub + 1) << bucket) - 1;
+}
+
+static void hdr_record(hdr_t *h, u64 v) {
+    h->counts[hdr_index(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+static void hdr_merge(hdr_t *dst, const hdr_t *src) {
+    for (u32 i = 0; i < HDR_SLOTS; i++)
+        dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+static u64 hdr_percentile(const hdr_t *h, double pct) {
+    u64 want = (u64)(pct / 100.0 * (double)h->total + 0.5);
+    u64 seen = 0;
+    if (want == 0)
+        want = 1;
+    for (u32 i = 0; i < HDR_SLOTS; i++) {
+        seen += h->counts[i];
+        if (seen >= want)
+            return hdr_value(i) < h->max ? hdr_value(i) : h->max;
+    }
+    return h->max;
+}
+
+/* ---- corpus ---- */
+
+static int load_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return -1;
+    }
+    long flen = ftell(f);
+    if (flen <= 0 || sample_count == MAX_SAMPLES || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return flen == 0 ? 0 : -1;
+    }
+    usize len = (usize)flen;
+    char *buf = malloc(len);
+    if (buf == NULL || fread(buf, 1, len, f) != len) {
+        free(buf);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    samples[sample_count].buf = buf;
+    samples[sample_count].len = len;
+    sample_count++;
+    return 0;
+}
+
+static int load_path(const char *path) {
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return load_file(path);
+    struct dirent *e;
+    char full[4096];
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.')
+            continue;
+        snprintf(full, sizeof(full), "%s/%s", path, e->d_name);
+        if (load_file(full) != 0)
+            fprintf(stderr, "h11load: skipping %s\n", full);
+    }
+    closedir(d);
+    return 0;
+}
+
+static void generate_corpus(void) {
+    for (u32 i = 0; i < GEN_SAMPLES; i++) {
+        char line[256];
+        int n = snprintf(line, sizeof(line),
+                         "GET /item/%u HTTP/1.1\r\nHost: localhost\r\nUser-Agent: h11load\r\n"
+                         "Accept: */*\r\n\r\n", i);
+        samples[i].buf = strdup(line);
+        samples[i].len = (usize)n;
+    }
+    sample_count = GEN_SAMPLES;
+}
+
+/* Keep a sample only if it is exactly one complete keep-alive request that
+ * leaves the connection speaking HTTP/1.1. */
+static bool sample_usable(h11_parser_t *p, sample_t *s) {
+    usize off = 0;
+    h11_parser_reset(p);
+    while (h11_get_state(p) != H11_STATE_COMPLETE) {
+        usize c = 0;
+        h11_error_t err = h11_parse(p, s->buf + off, s->len - off, &c);
+        off += c;
+        if (err != H11_OK)
+            return false;
+        if (h11_get_state(p) == H11_STATE_COMPLETE)
+            break;
+        const char *body;
+        usize body_len;
+        err = h11_read_body(p, s->buf + off, s->len - off, &c, &body, &body_len);
+        off += c;
+        if (err != H11_OK || c == 0)
+            return false;
+    }
+    const h11_request_t *r = h11_get_request(p);
+    const char *m = s->buf + r->method.off;
+    if (off != s->len || !(r->flags & H11_REQF_KEEP_ALIVE) || (r->flags & H11_REQF_HAS_UPGRADE))
+        return false;
+    if (r->method.len == 7 && memcmp(m, "CONNECT", 7) == 0)
+        return false;
+    s->head = r->method.len == 4 && memcmp(m, "HEAD", 4) == 0;
+    return true;
+}
+
+static u32 filter_corpus(void) {
+    h11_parser_t *p = h11_parser_new(NULL);
+    u32 kept = 0;
+    if (p == NULL)
+        return 0;
+    for (u32 i = 0; i < sample_count; i++) {
+        if (sample_usable(p, &samples[i]))
+            samples[kept++] = samples[i];
+        else
+            free(samples[i].buf);
+    }
+    h11_parser_free(p);
+    sample_count = kept;
+    return kept;
+}
+
+/* ---- response framing ---- */
+
+static bool parse_head(conn_t *c, const char *p, usize len) {
+    if (len < 12 || memcmp(p, "HTTP/1.", 7) != 0 || p[8] != ' ')
+        return false;
+    c->status = 0;
+    for (int i = 9; i < 12; i++) {
+        if (p[i] < '0' || p[i] > '9')
+            return false;
+        c->status = (u16)(c->status * 10 + (p[i] - '0'));
+    }
+    c->chunked = c->has_length = false;
+    c->resp_close = p[7] == '0';
+    c->body_left = 0;
+    const char *line = memchr(p, '\n', len);
+    while (line != NULL && (usize)(line + 1 - p) < len) {
+        u32 s = (u32)(line + 1 - p);
+        const char *nl = memchr(p + s, '\n', len - s);
+        if (nl == NULL)
+            break;
+        u32 e = (u32)(nl - p);
+        line = nl;
+        if (e > s && p[e - 1] == '\r')
+            e--;
+        const char *colon = memchr(p + s, ':', e - s);
+        if (colon == NULL)
+            continue;
+        h11_span_t name = { s, (u32)(colon - p) - s };
+        u32 vs = (u32)(colon + 1 - p);
+        while (vs < e && (p[vs] == ' ' || p[vs] == '\t'))
+            vs++;
+        h11_span_t value = { vs, e - vs };
+        if (h11_header_name_eq(p, name, "content-length")) {
+            c->has_length = true;
+            c->body_left = strtoull(p + vs, NULL, 10);
+        } else if (h11_header_name_eq(p, name, "transfer-encoding")) {
+            c->chunked = h11_token_list_has(p, value, "chunked");
+        } else if (h11_header_name_eq(p, name, "connection")) {
+            if (h11_token_list_has(p, value, "close"))
+                c->resp_close = true;
+            else if (h11_token_list_has(p, value, "keep-alive"))
+                c->resp_close = false;
+        }
+    }
+    return true;
+}
+
+static void resp_complete(thread_t *t, conn_t *c, u64 now) {
+    pending_t *q = &c->q[c->q_head];
+    hdr_record(t->latency, now - q->intended);
+    hdr_record(t->service, now - q->sent);
+    if (c->status < 200 || c->status >= 300)
+        t->non2xx++;
+    t->responses++;
+    c->q_head = (c->q_head + 1) % opts.depth;
+    c->q_len--;
+    c->resp_state = RESP_HEAD;
+}
+
+/* Consume every complete response in rbuf; false on a framing error. */
+static bool conn_frame(thread_t *t, conn_t *c, u64 now) {
+    for (;;) {
+        char *p = c->rbuf + c->rpos;
+        usize avail = c->rlen - c->rpos;
+        char *eol;
+        usize take;
+        switch (c->resp_state) {
+        case RESP_HEAD:
+            eol = memmem(p, avail, "\r\n\r\n", 4);
+            if (eol == NULL)
+                goto more;
+            if (c->q_len == 0 || !parse_head(c, p, (usize)(eol + 4 - p)))
+                return false;
+            c->rpos += (usize)(eol + 4 - p);
+            if (c->status < 200)
+                continue;
+            if (c->q[c->q_head].head || c->status == 204 || c->status == 304)
+                resp_complete(t, c, now);
+            else if (c->chunked)
+                c->resp_state = RESP_CHUNK_SIZE;
+            else if (!c->has_length)
+                return false;
+            else if (c->body_left == 0)
+                resp_complete(t, c, now);
+            else
+                c->resp_state = RESP_BODY;
+            continue;
+        case RESP_BODY:
+        case RESP_CHUNK_DATA:
+        case RESP_CHUNK_CRLF:
+            take = avail < c->body_left ? avail : (usize)c->body_left;
+            c->rpos += take;
+            c->body_left -= take;
+            if (c->body_left != 0)
+                goto more;
+            if (c->resp_state == RESP_BODY) {
+                resp_complete(t, c, now);
+            } else if (c->resp_state == RESP_CHUNK_DATA) {
+                c->resp_state = RESP_CHUNK_CRLF;
+                c->body_left = 2;
+            } else {
+                c->resp_state = RESP_CHUNK_SIZE;
+            }
+            continue;
+        case RESP_CHUNK_SIZE:
+        case RESP_TRAILERS:
+            eol = memmem(p, avail, "\r\n", 2);
+            if (eol == NULL)
+                goto more;
+            c->rpos += (usize)(eol + 2 - p);
+            if (c->resp_state == RESP_TRAILERS) {
+                if (eol == p)
+                    resp_complete(t, c, now);
+                continue;
+            }
+            char *end;
+            c->body_left = strtoull(p, &end, 16);
+            if (end == p)
+                return false;
+            c->resp_state = c->body_left != 0 ? RESP_CHUNK_DATA : RESP_TRAILERS;
+            continue;
+        }
+    }
+more:
+    if (c->rpos == 0 && c->rlen == RBUF_SIZE)
+        return false;
+    memmove(c->rbuf, c->rbuf + c->rpos, c->rlen - c->rpos);
+    c->rlen -= c->rpos;
+    c->rpos = 0;
+    return true;
+}
+
+/* ---- connections ---- */
+
+static bool conn_flush(conn_t *c) {
+    while (c->wpos < c->wlen) {
+        ssize_t n = send(c->fd, c->wbuf + c->wpos, c->wlen - c->wpos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+        }
+        c->wpos += (usize)n;
+    }
+    c->wpos = c->wlen = 0;
+    return true;
+}
+
+/* Queue every request the connection may send now: up to depth in flight
+ * and, under -r, only those whose intended time has come. */
+static bool conn_fill(conn_t *c, u64 now) {
+    bool queued = false;
+    while (c->q_len < opts.depth && (opts.rate == 0 || c->next_due <= now)) {
+        const sample_t *s = &samples[c->next_sample];
+        c->next_sample = (c->next_sample + 1) % sample_count;
+        if (c->wlen + s->len > c->wcap) {
+            usize ncap = c->wcap ? c->wcap : 4096;
+            while (ncap < c->wlen + s->len)
+                ncap *= 2;
+            char *n = realloc(c->wbuf, ncap);
+            if (n == NULL)
+                return false;
+            c->wbuf = n;
+            c->wcap = ncap;
+        }
+        memcpy(c->wbuf + c->wlen, s->buf, s->len);
+        c->wlen += s->len;
+        pending_t *q = &c->q[(c->q_head + c->q_len++) % opts.depth];
+        q->intended = opts.rate ? c->next_due : now;
+        q->sent = now;
+        q->head = s->head;
+        c->next_due += c->interval;
+        queued = true;
+    }
+    return !queued || conn_flush(c);
+}
+
+static bool conn_open(thread_t *t, conn_t *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET };
+    ev.data.ptr = c;
+    if ((connect(c->fd, (struct sockaddr *)&target, sizeof(target)) != 0 &&
+         errno != EINPROGRESS) ||
+        epoll_ctl(t->ep, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+        close(c->fd);
+        c->fd = -1;
+        return false;
+    }
+    c->q_head = c->q_len = 0;
+    c->wlen = c->wpos = c->rlen = c->rpos = 0;
+    c->resp_state = RESP_HEAD;
+    c->resp_close = false;
+    return true;
+}
+
+/* Drop the connection and what it had in flight, then dial again. A refused
+ * reconnect leaves it dead for the rest of the run. */
+static void conn_reset(thread_t *t, conn_t *c, bool error) {
+    close(c->fd);
+    c->fd = -1;
+    t->errors += error;
+    t->lost += c->q_len;
+    t->reconnects++;
+    if (!conn_open(t, c))
+        t->errors++;
+    else if (!conn_fill(c, now_ns()))
+        conn_reset(t, c, true);
+}
+
+static bool conn_readable(thread_t *t, conn_t *c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, RBUF_SIZE - c->rlen, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (n == 0)
+            return false;
+        u64 now = now_ns();
+        t->bytes += (u64)n;
+        c->rlen += (usize)n;
+        if (!conn_frame(t, c, now))
+            return false;
+        if (c->resp_close && c->q_len == 0 && c->resp_state == RESP_HEAD)
+            return false;
+        if (!conn_fill(c, now))
+            return false;
+    }
+}
+
+/* ---- threads ---- */
+
+static void *thread_main(void *arg) {
+    thread_t *t = arg;
+    struct epoll_event events[MAX_EVENTS];
+    for (u32 i = 0; i < t->nconns; i++) {
+        conn_t *c = &t->conns[i];
+        if (!conn_open(t, c) || !conn_fill(c, start_ns))
+            t->errors++;
+    }
+    for (;;) {
+        u64 now = now_ns();
+        if (now >= end_ns)
+            break;
+        u64 wake = end_ns;
+        if (opts.rate != 0) {
+            /* Connections come due in cursor order; one that is still
+             * waiting on depth catches up as its responses arrive. */
+            for (u32 k = 0; k < t->nconns; k++) {
+                conn_t *c = &t->conns[t->cursor];
+                if (c->fd >= 0 && c->next_due > now) {
+                    wake = c->next_due;
+                    break;
+                }
+                if (c->fd >= 0 && !conn_fill(c, now))
+                    conn_reset(t, c, true);
+                t->cursor = (t->cursor + 1) % t->nconns;
+            }
+        }
+        if (wake > now + 100000000u)
+            wake = now + 100000000u;
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)(wake > now ? wake - now : 0) };
+        int n = epoll_pwait2(t->ep, events, MAX_EVENTS, &ts, NULL);
+        for (int i = 0; i < n; i++) {
+            conn_t *c = events[i].data.ptr;
+            u32 e = events[i].events;
+            bool ok = c->fd >= 0 && !(e & EPOLLERR);
+            if (ok && (e & EPOLLOUT))
+                ok = conn_flush(c);
+            if (ok && (e & (EPOLLIN | EPOLLRDHUP)))
+                ok = conn_readable(t, c);
+            if (!ok && c->fd >= 0)
+                conn_reset(t, c, !c->resp_close);
+        }
+    }
+    for (u32 i = 0; i < t->nconns; i++) {
+        if (t->conns[i].fd >= 0)
+            close(t->conns[i].fd);
+    }
+    return NULL;
+}
+
+static bool thread_init(thread_t *t, u32 first, u32 count) {
+    t->nconns = count;
+    t->conns = calloc(count, sizeof(*t->conns));
+    t->latency = calloc(1, sizeof(hdr_t));
+    t->service = calloc(1, sizeof(hdr_t));
+    t->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (t->conns == NULL || t->latency == NULL || t->service == NULL || t->ep < 0)
+        return false;
+    for (u32 i = 0; i < count; i++) {
+        conn_t *c = &t->conns[i];
+        c->fd = -1;
+        c->next_sample = (first + i) % sample_count;
+        c->q = calloc(opts.depth, sizeof(*c->q));
+        c->rbuf = malloc(RBUF_SIZE);
+        if (c->q == NULL || c->rbuf == NULL)
+            return false;
+        if (opts.rate != 0) {
+            /* Stagger the schedules evenly across every connection. */
+            c->interval = (u64)opts.conns * 1000000000u / opts.rate;
+            c->next_due = start_ns + c->interval * (first + i) / opts.conns;
+        }
+    }
+    return true;
+}
+
+/* ---- half-close check ---- */
+
+static int half_close_check(void) {
+    thread_t t = { .latency = calloc(1, sizeof(hdr_t)), .service = calloc(1, sizeof(hdr_t)) };
+    conn_t c = { .q = calloc(opts.depth, sizeof(pending_t)), .rbuf = malloc(RBUF_SIZE) };
+    if (t.latency == NULL || t.service == NULL || c.q == NULL || c.rbuf == NULL) {
+        fprintf(stderr, "h11load: out of memory\n");
+        return 1;
+    }
+    struct timeval tv = { .tv_sec = 5 };
+    u32 cut = 0;
+    for (u32 k = 0; k < opts.conns; k++) {
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        c.q_head = c.q_len = 0;
+        c.wlen = c.wpos = c.rlen = c.rpos = 0;
+        c.resp_state = RESP_HEAD;
+        bool ok = c.fd >= 0 && setsockopt(c.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+                  connect(c.fd, (struct sockaddr *)&target, sizeof(target)) == 0 &&
+                  conn_fill(&c, now_ns()) && c.wlen == 0 && shutdown(c.fd, SHUT_WR) == 0;
+        while (ok) {
+            ssize_t n = recv(c.fd, c.rbuf + c.rlen, RBUF_SIZE - c.rlen, 0);
+            if (n <= 0) {
+                ok = n == 0;
+                break;
+            }
+            c.rlen += (usize)n;
+            ok = conn_frame(&t, &c, now_ns());
+        }
+        if (!ok || c.q_len != 0 || c.resp_state != RESP_HEAD)
+            cut++;
+        if (c.fd >= 0)
+            close(c.fd);
+    }
+    printf("h11load: half-close check on %s:%u, %u connections of %u requests: %u cut short\n",
+           opts.addr, opts.port, opts.conns, opts.depth, cut);
+    free(c.q);
+    free(c.rbuf);
+    free(c.wbuf);
+    free(t.latency);
+    free(t.service);
+    return cut != 0;
+}
+
+static void print_histogram(const char *title, const hdr_t *h) {
+    static const double pcts[] = { 50, 75, 90, 99, 99.9, 99.99, 100 };
+    printf("%s\n", title);
+    if (h->total == 0) {
+        printf("  (no responses)\n");
+        return;
+    }
+    printf("  %-8s %10.1f us\n", "mean", (double)h->sum / (double)h->total / 1000.0);
+    for (u32 i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+        printf("  %7.3f%% %10.1f us\n", pcts[i], (double)hdr_percentile(h, pcts[i]) / 1000.0);
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-a addr] [-p port] [-c conns] [-t threads] [-d seconds] [-D depth] "
+            "[-r rate] [-g] [-H] [path...]\n", argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-g") == 0) {
+            opts.generate = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-H") == 0) {
+            opts.half_close = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        const char *v = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'a': opts.addr = v; break;
+        case 'p': opts.port = (u16)strtoul(v, NULL, 10); break;
+        case 'c': opts.conns = (u32)strtoul(v, NULL, 10); break;
+        case 't': opts.threads = (u32)strtoul(v, NULL, 10); break;
+        case 'd': opts.seconds = (u32)strtoul(v, NULL, 10); break;
+        case 'D': opts.depth = (u32)strtoul(v, NULL, 10); break;
+        case 'r': opts.rate = strtoull(v, NULL, 10); break;
+        default: return usage(argv[0]);
+        }
+    }
+    if (opts.threads == 0 || opts.threads > MAX_THREADS || opts.conns < opts.threads ||
+        opts.depth == 0 || opts.seconds == 0)
+        return usage(argv[0]);
+    target.sin_family = AF_INET;
+    target.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.addr, &target.sin_addr) != 1)
+        return usage(argv[0]);
+
+    if (opts.generate) {
+        generate_corpus();
+    } else if (i == argc) {
+        load_path("sample_requests");
+    } else {
+        for (; i < argc; i++)
+            load_path(argv[i]);
+    }
+    u32 loaded = sample_count;
+    if (filter_corpus() == 0) {
+        fprintf(stderr, "h11load: no usable requests\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (opts.half_close)
+        return half_close_check();
+
+    static thread_t threads[MAX_THREADS];
+    start_ns = now_ns();
+    end_ns = start_ns + (u64)opts.seconds * 1000000000u;
+    for (u32 k = 0, first = 0; k < opts.threads; k++) {
+        u32 count = opts.conns / opts.threads + (k < opts.conns % opts.threads);
+        threads[k].id = k;
+        if (!thread_init(&threads[k], first, count)) {
+            fprintf(stderr, "h11load: out of memory\n");
+            return 1;
+        }
+        first += count;
+    }
+    for (u32 k = 0; k < opts.threads; k++) {
+        if (pthread_create(&threads[k].thread, NULL, thread_main, &threads[k]) != 0) {
+            fprintf(stderr, "h11load: cannot start thread %u\n", k);
+            return 1;
+        }
+    }
+
+    hdr_t *latency = calloc(1, sizeof(hdr_t));
+    hdr_t *service = calloc(1, sizeof(hdr_t));
+    u64 responses = 0, non2xx = 0, bytes = 0, errors = 0, lost = 0, reconnects = 0;
+    for (u32 k = 0; k < opts.threads; k++) {
+        thread_t *t = &threads[k];
+        pthread_join(t->thread, NULL);
+        if (latency != NULL && service != NULL) {
+            hdr_merge(latency, t->latency);
+            hdr_merge(service, t->service);
+        }
+        responses += t->responses;
+        non2xx += t->non2xx;
+        bytes += t->bytes;
+        errors += t->errors;
+        lost += t->lost;
+        reconnects += t->reconnects;
+    }
+    double secs = (double)(now_ns() - start_ns) / 1e9;
+    printf("h11load: %s:%u, %u threads, %u connections, depth %u, %u of %u samples\n",
+           opts.addr, opts.port, opts.threads, opts.conns, opts.depth, sample_count, loaded);
+    if (opts.rate != 0)
+        printf("  target     %llu req/s\n", (unsigned long long)opts.rate);
+    printf("  responses  %llu in %.2f s (%.1f req/s, %.2f MB/s)\n",
+           (unsigned long long)responses, secs, (double)responses / secs,
+           (double)bytes / secs / 1e6);
+    printf("  non-2xx    %llu\n", (unsigned long long)non2xx);
+    printf("  errors     %llu (%llu requests lost, %llu reconnects)\n",
+           (unsigned long long)errors, (unsigned long long)lost, (unsigned long long)reconnects);
+    if (latency == NULL || service == NULL)
+        return 1;
+    if (opts.rate != 0)
+        print_histogram("Latency from intended send (corrected for coordinated omission):",
+                        latency);
+    print_histogram("Latency from actual send:", service);
+    return errors != 0;
+}
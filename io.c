@@ -0,0 +1,248 @@
+/*
+ * io.c — Zero-copy descriptor helpers (Linux): body sinks that splice a
+ *        request body from the socket through a pipe without user copies,
+ *        and a bidirectional splice relay for CONNECT/Upgrade tunnels
+ *
+ * Every function leaves errno from the failing system call in place when it
+ * returns H11_ERR_INTERNAL for an I/O error.
+ */
+#define _GNU_SOURCE
+#include "h11_internal.h"
+#include <errno.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SPLICE_FLAGS (SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+
+h11_error_t h11_pipe_open(h11_pipe_t *pp, u32 size) {
+    if (pp == NULL)
+        return H11_ERR_INTERNAL;
+    pp->fd[0] = pp->fd[1] = -1;
+    pp->cap = pp->buffered = 0;
+    if (pipe2(pp->fd, O_CLOEXEC | O_NONBLOCK) != 0)
+        return H11_ERR_INTERNAL;
+    /* Growing past the default is best effort: unprivileged processes are
+     * capped by /proc/sys/fs/pipe-max-size. */
+    if (size > 0)
+        (void)fcntl(pp->fd[0], F_SETPIPE_SZ, (int)size);
+    int cap = fcntl(pp->fd[0], F_GETPIPE_SZ);
+    pp->cap = cap > 0 ? (u32)cap : 65536;
+    return H11_OK;
+}
+
+void h11_pipe_close(h11_pipe_t *pp) {
+    if (pp == NULL)
+        return;
+    for (int i = 0; i < 2; i++) {
+        if (pp->fd[i] >= 0)
+            close(pp->fd[i]);
+        pp->fd[i] = -1;
+    }
+    pp->buffered = 0;
+}
+
+/* Moves the rest of the current identity body (or chunk) from in to out:
+ * socket -> pipe -> file, socket or pipe. The parser is advanced as bytes
+ * leave the socket, so it stays in step with the stream even while some of
+ * them still sit in the pipe. Body bytes already read into user memory
+ * must be drained with h11_read_body first.
+ *
+ * Returns H11_OK once the run is complete and the pipe is empty,
+ * H11_NEED_MORE_DATA when a non-blocking descriptor would block (in if
+ * pp->buffered is 0, otherwise out), H11_ERR_CONNECTION_CLOSED if in hits
+ * EOF first. *moved counts bytes delivered to out by this call. */
+h11_error_t h11_body_splice(h11_parser_t *p, h11_pipe_t *pp, int in, int out, u64 *moved) {
+    if (moved != NULL)
+        *moved = 0;
+    if (p == NULL || pp == NULL || moved == NULL || pp->fd[0] < 0)
+        return H11_ERR_INTERNAL;
+    if (p->state == H11_STATE_ERROR)
+        return p->last_error;
+    if (pp->buffered == 0 && h11_body_pending(p) == 0)
+        return H11_ERR_INTERNAL;
+    for (;;) {
+        bool in_blocked = false;
+        u64 pending = h11_body_pending(p);
+        if (pending > 0 && pp->buffered < pp->cap) {
+            u64 want = pp->cap - pp->buffered;
+            ssize_t n = splice(in, NULL, pp->fd[1], NULL, (usize)(pending < want ? pending : want),
+                               SPLICE_FLAGS);
+            if (n > 0) {
+                pp->buffered += (u32)n;
+                h11_error_t err = h11_body_advance(p, (u64)n);
+                if (err != H11_OK)
+                    return err;
+            } else if (n == 0) {
+                return H11_ERR_CONNECTION_CLOSED;
+            } else if (errno == EAGAIN) {
+                in_blocked = true;
+            } else if (errno != EINTR) {
+                return H11_ERR_INTERNAL;
+            }
+        }
+        if (pp->buffered > 0) {
+            ssize_t n = splice(pp->fd[0], NULL, out, NULL, pp->buffered, SPLICE_FLAGS);
+            if (n > 0) {
+                pp->buffered -= (u32)n;
+                *moved += (u64)n;
+            } else if (n < 0 && errno == EAGAIN) {
+                return H11_NEED_MORE_DATA;
+            } else if (n == 0 || errno != EINTR) {
+                return H11_ERR_INTERNAL;
+            }
+        }
+        if (pp->buffered == 0) {
+            if (h11_body_pending(p) == 0)
+                return H11_OK;
+            if (in_blocked)
+                return H11_NEED_MORE_DATA;
+        }
+    }
+}
+
+/* ---- tunnels ---- */
+
+h11_error_t h11_tunnel_open(h11_tunnel_t *t, int client, int upstream, const char *buffered,
+                            usize len, u32 pipe_size) {
+    if (t == NULL || (buffered == NULL && len > 0) || len > UINT32_MAX)
+        return H11_ERR_INTERNAL;
+    *t = (h11_tunnel_t){ .up = { .in = client, .out = upstream, .prefix = buffered,
+                                 .prefix_len = (u32)len },
+                         .down = { .in = upstream, .out = client } };
+    t->up.pipe.fd[0] = t->up.pipe.fd[1] = t->down.pipe.fd[0] = t->down.pipe.fd[1] = -1;
+    if (h11_pipe_open(&t->up.pipe, pipe_size) != H11_OK ||
+        h11_pipe_open(&t->down.pipe, pipe_size) != H11_OK) {
+        int e = errno;
+        h11_tunnel_close(t);
+        errno = e;
+        return H11_ERR_INTERNAL;
+    }
+    return H11_OK;
+}
+
+void h11_tunnel_close(h11_tunnel_t *t) {
+    if (t == NULL)
+        return;
+    h11_pipe_close(&t->up.pipe);
+    h11_pipe_close(&t->down.pipe);
+}
+
+/* Runs one direction until it blocks or finishes. The prefix is written
+ * into the pipe ahead of anything spliced from in, so the pipe is the only
+ * queue and ordering holds. EOF from in is passed on as a half-close once
+ * the pipe drains. */
+static h11_error_t relay_run(h11_relay_t *r) {
+    h11_pipe_t *pp = &r->pipe;
+    while (!r->done) {
+        bool in_blocked = false;
+        if (!r->eof && pp->buffered < pp->cap) {
+            u32 room = pp->cap - pp->buffered;
+            ssize_t n;
+            if (r->prefix_len > 0)
+                n = write(pp->fd[1], r->prefix, r->prefix_len < room ? r->prefix_len : room);
+            else
+                n = splice(r->in, NULL, pp->fd[1], NULL, room, SPLICE_FLAGS);
+            if (n > 0) {
+                pp->buffered += (u32)n;
+                if (r->prefix_len > 0) {
+                    r->prefix += n;
+                    r->prefix_len -= (u32)n;
+                }
+            } else if (n == 0) {
+                r->eof = true;
+            } else if (errno == EAGAIN) {
+                in_blocked = true;
+            } else if (errno != EINTR) {
+                return H11_ERR_INTERNAL;
+            }
+        }
+        if (pp->buffered > 0) {
+            ssize_t n = splice(pp->fd[0], NULL, r->out, NULL, pp->buffered, SPLICE_FLAGS);
+            if (n > 0) {
+                pp->buffered -= (u32)n;
+                r->moved += (u64)n;
+            } else if (n < 0 && errno == EAGAIN) {
+                return H11_NEED_MORE_DATA;
+            } else if (n == 0 || errno != EINTR) {
+                return H11_ERR_INTERNAL;
+            }
+        }
+        if (pp->buffered == 0) {
+            if (r->eof) {
+                if (shutdown(r->out, SHUT_WR) != 0 && errno != ENOTSOCK && errno != ENOTCONN)
+                    return H11_ERR_INTERNAL;
+                r->done = true;
+            } else if (in_blocked) {
+                return H11_NEED_MORE_DATA;
+            }
+        }
+    }
+    return H11_OK;
+}
+
+/* Moves bytes both ways until every descriptor that can make progress has
+ * been drained to EAGAIN, so it suits edge-triggered readiness on both
+ * sockets. Returns H11_OK once both directions are done, H11_NEED_MORE_DATA
+ * while either is waiting, H11_ERR_INTERNAL (errno kept) on a failed
+ * system call, after which the tunnel should be torn down. splice() has
+ * no MSG_NOSIGNAL, so callers must ignore SIGPIPE. */
+h11_error_t h11_tunnel_relay(h11_tunnel_t *t) {
+    if (t == NULL || t->up.pipe.fd[0] < 0 || t->down.pipe.fd[0] < 0)
+        return H11_ERR_INTERNAL;
+    h11_error_t up = relay_run(&t->up);
+    if (up == H11_ERR_INTERNAL)
+        return up;
+    h11_error_t down = relay_run(&t->down);
+    if (down == H11_ERR_INTERNAL)
+        return down;
+    return up == H11_OK && down == H11_OK ? H11_OK : H11_NEED_MORE_DATA;
+}
+
+#else
+
+h11_error_t h11_pipe_open(h11_pipe_t *pp, u32 size) {
+    (void)size;
+    if (pp != NULL) {
+        pp->fd[0] = pp->fd[1] = -1;
+        pp->cap = pp->buffered = 0;
+    }
+    errno = ENOSYS;
+    return H11_ERR_INTERNAL;
+}
+
+void h11_pipe_close(h11_pipe_t *pp) {
+    (void)pp;
+}
+
+h11_error_t h11_body_splice(h11_parser_t *p, h11_pipe_t *pp, int in, int out, u64 *moved) {
+    (void)p, (void)pp, (void)in, (void)out;
+    if (moved != NULL)
+        *moved = 0;
+    errno = ENOSYS;
+    return H11_ERR_INTERNAL;
+}
+
+h11_error_t h11_tunnel_open(h11_tunnel_t *t, int client, int upstream, const char *buffered,
+                            usize len, u32 pipe_size) {
+    (void)client, (void)upstream, (void)buffered, (void)len, (void)pipe_size;
+    if (t != NULL)
+        *t = (h11_tunnel_t){ .up = { .pipe = { .fd = { -1, -1 } } },
+                             .down = { .pipe = { .fd = { -1, -1 } } } };
+    errno = ENOSYS;
+    return H11_ERR_INTERNAL;
+}
+
+void h11_tunnel_close(h11_tunnel_t *t) {
+    (void)t;
+}
+
+h11_error_t h11_tunnel_relay(h11_tunnel_t *t) {
+    (void)t;
+    errno = ENOSYS;
+    return H11_ERR_INTERNAL;
+}
+
+#endif
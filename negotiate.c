@@ -0,0 +1,155 @@
+/*
+ * negotiate.c — Proactive content negotiation (RFC 9110 S12.5) of
+ *               Accept-Encoding and Accept against a precompiled offer table
+ */
+#include "h11_internal.h"
+#include <string.h>
+
+#define SLOT_MASK 63u
+
+/* Specificity of the element that set an offer's weight; a more specific
+ * element always wins, the first of equal specificity is kept. */
+enum { SPEC_NONE = 0, SPEC_ANY, SPEC_TYPE, SPEC_EXACT };
+
+typedef struct {
+    u16 q[H11_MAX_OFFERS];
+    u8  spec[H11_MAX_OFFERS];
+} neg_state_t;
+
+/* FNV-1a over case-folded bytes. */
+static u32 fold_hash(const char *p, usize len) {
+    u32 h = 2166136261u;
+    for (usize i = 0; i < len; i++)
+        h = (h ^ h11_ascii_fold((u8)p[i])) * 16777619u;
+    return h;
+}
+
+static bool fold_eq(const char *a, const char *b, usize len) {
+    for (usize i = 0; i < len; i++) {
+        if (h11_ascii_fold((u8)a[i]) != h11_ascii_fold((u8)b[i]))
+            return false;
+    }
+    return true;
+}
+
+static int offer_lookup(const h11_offers_t *o, const char *p, usize len) {
+    for (u32 s = fold_hash(p, len) & SLOT_MASK;; s = (s + 1) & SLOT_MASK) {
+        u8 v = o->slot[s];
+        if (v == 0)
+            return -1;
+        if (o->len[v - 1] == len && fold_eq(o->name[v - 1], p, len))
+            return v - 1;
+    }
+}
+
+h11_error_t h11_offers_compile(h11_offers_t *o, h11_negotiate_kind_t kind,
+                               const char *const *offers, u32 count) {
+    if (o == NULL || offers == NULL || count == 0 || count > H11_MAX_OFFERS)
+        return H11_ERR_INTERNAL;
+    memset(o, 0, sizeof(*o));
+    o->kind = (u8)kind;
+    o->identity = H11_MAX_OFFERS;
+    for (u32 i = 0; i < count; i++) {
+        const char *name = offers[i];
+        usize len = name != NULL ? strlen(name) : 0;
+        if (len == 0 || len > 255 || h11_find_char(name, len, '*') < len)
+            return H11_ERR_INTERNAL;
+        usize slash = h11_find_char(name, len, '/');
+        if (kind == H11_NEGOTIATE_MEDIA ? (slash == 0 || slash + 1 >= len) : slash < len)
+            return H11_ERR_INTERNAL;
+        if (offer_lookup(o, name, len) >= 0)
+            return H11_ERR_INTERNAL;
+        o->name[i] = name;
+        o->len[i] = (u8)len;
+        o->type_len[i] = (u8)(slash < len ? slash : len);
+        u32 s = fold_hash(name, len) & SLOT_MASK;
+        while (o->slot[s] != 0)
+            s = (s + 1) & SLOT_MASK;
+        o->slot[s] = (u8)(i + 1);
+        o->count = (u8)(i + 1);
+        if (kind == H11_NEGOTIATE_ENCODING && len == 8 && fold_eq(name, "identity", 8))
+            o->identity = (u8)i;
+    }
+    return H11_OK;
+}
+
+H11_INLINE void assign(neg_state_t *st, u32 i, u16 q, u8 spec) {
+    if (spec > st->spec[i]) {
+        st->spec[i] = spec;
+        st->q[i] = q;
+    }
+}
+
+static void negotiate_feed(const h11_offers_t *o, neg_state_t *st, const char *base,
+                           h11_span_t value) {
+    h11_token_iter_t it;
+    h11_token_t tok;
+    h11_token_iter_init(&it, base, value);
+    while (h11_token_next(&it, &tok)) {
+        const char *t = base + tok.token.off;
+        const usize tlen = tok.token.len;
+        int idx = offer_lookup(o, t, tlen);
+        if (idx >= 0) {
+            assign(st, (u32)idx, tok.weight, SPEC_EXACT);
+            continue;
+        }
+        if (tlen == 0)
+            continue;
+        if (t[tlen - 1] != '*')
+            continue;
+        if (o->kind == H11_NEGOTIATE_ENCODING) {
+            if (tlen != 1)
+                continue;
+            for (u32 i = 0; i < o->count; i++)
+                assign(st, i, tok.weight, SPEC_ANY);
+        } else if (tlen == 3 && t[0] == '*' && t[1] == '/') {
+            for (u32 i = 0; i < o->count; i++)
+                assign(st, i, tok.weight, SPEC_ANY);
+        } else if (tlen >= 3 && t[tlen - 2] == '/') {
+            usize type_len = tlen - 2;
+            for (u32 i = 0; i < o->count; i++) {
+                if (o->type_len[i] == type_len && fold_eq(o->name[i], t, type_len))
+                    assign(st, i, tok.weight, SPEC_TYPE);
+            }
+        }
+    }
+}
+
+/* Highest client weight wins; ties go to the earlier (server-preferred)
+ * offer. An identity coding the client never mentioned stays acceptable but
+ * ranks below every coding it asked for (RFC 9110 S12.5.3). */
+static int negotiate_pick(const h11_offers_t *o, const neg_state_t *st) {
+    int best = -1;
+    u16 best_q = 0;
+    for (u32 i = 0; i < o->count; i++) {
+        u16 q = st->spec[i] != SPEC_NONE ? st->q[i] : (i == o->identity ? 1 : 0);
+        if (q > best_q) {
+            best_q = q;
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+int h11_negotiate(const h11_offers_t *o, const char *base, h11_span_t value) {
+    if (o == NULL || base == NULL || o->count == 0)
+        return -1;
+    neg_state_t st;
+    memset(&st, 0, sizeof(st));
+    negotiate_feed(o, &st, base, value);
+    return negotiate_pick(o, &st);
+}
+
+int h11_request_negotiate(const h11_offers_t *o, const h11_request_t *req, const char *base) {
+    if (o == NULL || req == NULL || base == NULL || o->count == 0)
+        return -1;
+    const char *field = o->kind == H11_NEGOTIATE_MEDIA ? "accept" : "accept-encoding";
+    int i = h11_find_header_next(req, base, field, -1);
+    if (i < 0)
+        return 0;
+    neg_state_t st;
+    memset(&st, 0, sizeof(st));
+    for (; i >= 0; i = h11_find_header_next(req, base, field, i))
+        negotiate_feed(o, &st, base, req->headers[i].value);
+    return negotiate_pick(o, &st);
+}
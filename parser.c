@@ -0,0 +1,1182 @@
+/*
+ * parser.c — Request parser: request line, headers, framing, chunked body
+ *
+ * Spans are offsets from the first byte of the request. Each h11_parse()
+ * call starts at data[0] (the first unconsumed byte) and only consumes whole
+ * lines, so the caller keeps the request contiguous and passes
+ * base + consumed on the next call.
+ */
+#include "h11_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    H11_HEADERS_INITIAL_CAP  = 16,
+    H11_TRAILERS_INITIAL_CAP = 8,
+    H11_CHUNK_LINE_SLACK     = 100,
+    H11_BLOCK_WINDOW         = 1024,
+};
+
+static h11_error_t set_error(h11_parser_t *p, h11_error_t err, usize offset) {
+    p->state = H11_STATE_ERROR;
+    p->last_error = err;
+    p->error_offset = p->total_consumed + offset;
+    return err;
+}
+
+/* ---- lifecycle ---- */
+
+h11_parser_t *h11_parser_new(const h11_config_t *config) {
+    h11_init();
+    h11_parser_t *p = calloc(1, sizeof(*p));
+    if (p == NULL)
+        return NULL;
+    p->config = config != NULL ? *config : h11_config_default();
+    p->request.headers = malloc(H11_HEADERS_INITIAL_CAP * sizeof(h11_header_t));
+    if (p->request.headers == NULL) {
+        free(p);
+        return NULL;
+    }
+    p->header_cap = H11_HEADERS_INITIAL_CAP;
+    h11_parser_reset(p);
+    return p;
+}
+
+void h11_parser_free(h11_parser_t *p) {
+    if (p == NULL)
+        return;
+    free(p->request.headers);
+    free(p->request.trailers);
+    free(p->block_masks);
+    free(p->shape);
+    free(p->shape_names);
+    free(p);
+}
+
+void h11_parser_reset(h11_parser_t *p) {
+    if (p == NULL)
+        return;
+    h11_header_t *headers = p->request.headers;
+    h11_header_t *trailers = p->request.trailers;
+    memset(&p->request, 0, sizeof(p->request));
+    p->request.headers = headers;
+    p->request.trailers = trailers;
+    for (int k = 0; k < H11_KHDR_COUNT; k++)
+        p->request.known_idx[k] = H11_INDEX_NONE;
+    p->state = H11_STATE_IDLE;
+    p->last_error = H11_OK;
+    p->error_offset = 0;
+    p->total_consumed = 0;
+    p->line_start = 0;
+    p->headers_size = 0;
+    p->body_remaining = 0;
+    p->total_body_read = 0;
+    p->in_chunk_ext = false;
+    p->chunk_ext_len = 0;
+    p->seen_host = false;
+    p->seen_content_length = false;
+    p->seen_transfer_encoding = false;
+    p->is_chunked = false;
+    p->leading_crlf_consumed = false;
+    p->shape_hits = 0;
+}
+
+h11_state_t h11_get_state(const h11_parser_t *p) {
+    return p != NULL ? p->state : H11_STATE_ERROR;
+}
+
+const h11_request_t *h11_get_request(const h11_parser_t *p) {
+    return p != NULL ? &p->request : NULL;
+}
+
+usize h11_error_offset(const h11_parser_t *p) {
+    return p != NULL ? p->error_offset : 0;
+}
+
+static const char expect_100[] = "HTTP/1.1 100 Continue\r\n\r\n";
+static const char expect_417[] =
+    "HTTP/1.1 417 Expectation Failed\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+
+/* Only meaningful while the body is still unread: a Content-Length over
+ * max_body_size has already failed the header section with
+ * H11_ERR_BODY_TOO_LARGE, so its 413 comes from h11_error_response(). */
+u16 h11_expect_response(const h11_parser_t *p, const char **resp, usize *len) {
+    if (resp == NULL || len == NULL)
+        return 0;
+    *resp = NULL;
+    *len = 0;
+    if (p == NULL ||
+        (p->state != H11_STATE_BODY_IDENTITY && p->state != H11_STATE_BODY_CHUNKED_SIZE) ||
+        p->total_body_read != 0)
+        return 0;
+    if (p->request.flags & H11_REQF_EXPECT_UNSUPPORTED) {
+        *resp = expect_417;
+        *len = sizeof(expect_417) - 1;
+        return 417;
+    }
+    if (!(p->request.flags & H11_REQF_EXPECT_CONTINUE))
+        return 0;
+    *resp = expect_100;
+    *len = sizeof(expect_100) - 1;
+    return 100;
+}
+
+/* ---- line framing ---- */
+
+/* Length of the first complete line (terminator excluded), or len if there
+ * is none yet. *term receives the terminator length. Strict mode only
+ * accepts CRLF; otherwise a bare LF also ends the line. */
+static usize find_line(const h11_parser_t *p, const char *data, usize len, usize *term) {
+    const bool padded = (p->config.flags & H11_CFG_PADDED_INPUT) != 0;
+    if (p->config.flags & H11_CFG_STRICT_CRLF) {
+        *term = 2;
+        return padded ? h11_find_crlf_padded(data, len) : h11_find_crlf(data, len);
+    }
+    usize lf = padded ? h11_find_char_padded(data, len, '\n') : h11_find_char(data, len, '\n');
+    if (lf == len)
+        return len;
+    if (lf > 0 && h11_is_cr(data[lf - 1])) {
+        *term = 2;
+        return lf - 1;
+    }
+    *term = 1;
+    return lf;
+}
+
+/* ---- request target (RFC 9112 S3.2) ---- */
+
+static bool valid_path_query(const char *t, usize len) {
+    for (usize i = 0; i < len; i++) {
+        char c = t[i];
+        if (c == '%') {
+            if (len - i < 3 || !h11_is_hexdig(t[i + 1]) || !h11_is_hexdig(t[i + 2]))
+                return false;
+            i += 2;
+        } else if (!h11_is_uri(c) && c != '?') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool valid_port(const char *s, usize len) {
+    if (len == 0 || len > 5)
+        return false;
+    u32 v = 0;
+    for (usize i = 0; i < len; i++) {
+        if (!h11_is_digit(s[i]))
+            return false;
+        v = v * 10 + (u32)(s[i] - '0');
+    }
+    return v <= 65535;
+}
+
+/* uri-host [ ":" port ]; the port is mandatory for authority-form. */
+static bool valid_host_port(const char *s, usize len, bool need_port) {
+    usize host_end;
+    if (len > 0 && s[0] == '[') {
+        usize close = h11_find_char(s, len, ']');
+        if (close == len || close == 1)
+            return false;
+        for (usize i = 1; i < close; i++) {
+            if (!h11_is_hexdig(s[i]) && s[i] != ':' && s[i] != '.')
+                return false;
+        }
+        host_end = close + 1;
+        if (host_end < len && s[host_end] != ':')
+            return false;
+    } else {
+        host_end = h11_find_char(s, len, ':');
+        for (usize i = 0; i < host_end; i++) {
+            char c = s[i];
+            if (!h11_is_uri(c) || c == '/' || c == '@')
+                return false;
+        }
+    }
+    if (host_end == len)
+        return !need_port;
+    if (host_end == 0)
+        return false;
+    return valid_port(s + host_end + 1, len - host_end - 1);
+}
+
+static bool valid_scheme(const char *s, usize len) {
+    if (len == 0 || !((s[0] | 0x20) >= 'a' && (s[0] | 0x20) <= 'z'))
+        return false;
+    for (usize i = 1; i < len; i++) {
+        char c = s[i];
+        bool alpha = (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+        if (!alpha && !h11_is_digit(c) && c != '+' && c != '-' && c != '.')
+            return false;
+    }
+    return true;
+}
+
+static h11_error_t h11_determine_target_form(const char *t, usize len, u8 *form) {
+    if (len == 1 && t[0] == '*') {
+        *form = H11_TARGET_ASTERISK;
+        return H11_OK;
+    }
+    if (t[0] == '/') {
+        *form = H11_TARGET_ORIGIN;
+        return valid_path_query(t, len) ? H11_OK : H11_ERR_INVALID_TARGET;
+    }
+    usize colon = h11_find_char(t, len, ':');
+    if (colon < len && len - colon >= 3 && t[colon + 1] == '/' && t[colon + 2] == '/') {
+        *form = H11_TARGET_ABSOLUTE;
+        if (!valid_scheme(t, colon))
+            return H11_ERR_INVALID_TARGET;
+        const char *auth = t + colon + 3;
+        usize rest = len - colon - 3;
+        usize alen = h11_find_char2(auth, rest, '/', '?');
+        if (alen == 0)
+            return H11_ERR_INVALID_TARGET;
+        for (usize i = 0; i < alen; i++) {
+            if (!h11_is_uri(auth[i]) && auth[i] != '[' && auth[i] != ']')
+                return H11_ERR_INVALID_TARGET;
+        }
+        return valid_path_query(auth + alen, rest - alen) ? H11_OK : H11_ERR_INVALID_TARGET;
+    }
+    *form = H11_TARGET_AUTHORITY;
+    return valid_host_port(t, len, true) ? H11_OK : H11_ERR_INVALID_TARGET;
+}
+
+/* ---- request line (RFC 9112 S3) ---- */
+
+static h11_error_t h11_parse_request_line(h11_parser_t *p, const char *data, usize len,
+                                          usize *consumed) {
+    const bool tolerant = (p->config.flags & H11_CFG_TOLERATE_SPACES) != 0;
+    usize term = 2;
+    usize n = find_line(p, data, len, &term);
+    if (n == len) {
+        if (len >= p->config.max_request_line_len)
+            return set_error(p, H11_ERR_REQUEST_LINE_TOO_LONG, len);
+        return H11_NEED_MORE_DATA;
+    }
+    if (n > p->config.max_request_line_len)
+        return set_error(p, H11_ERR_REQUEST_LINE_TOO_LONG, n);
+
+    usize i = 0;
+    while (i < n && h11_is_tchar(data[i]))
+        i++;
+    if (i == 0 || i == n || !h11_is_sp(data[i]))
+        return set_error(p, H11_ERR_INVALID_METHOD, i);
+    usize method_len = i++;
+    if (tolerant) {
+        while (i < n && h11_is_ows(data[i]))
+            i++;
+    } else if (i < n && h11_is_sp(data[i])) {
+        return set_error(p, H11_ERR_INVALID_METHOD, i);
+    }
+
+    usize ts = i;
+    usize te = ts + (tolerant ? h11_find_char2(data + ts, n - ts, ' ', '\t')
+                              : h11_find_char(data + ts, n - ts, ' '));
+    if (te == ts)
+        return set_error(p, H11_ERR_INVALID_TARGET, ts);
+    for (usize k = ts; k < te; k++) {
+        u8 c = (u8)data[k];
+        if (c <= 0x20 || c == 0x7F)
+            return set_error(p, c == '\n' ? H11_ERR_INVALID_CRLF : H11_ERR_INVALID_TARGET, k);
+    }
+    u8 form = H11_TARGET_ORIGIN;
+    if (h11_determine_target_form(data + ts, te - ts, &form) != H11_OK)
+        return set_error(p, H11_ERR_INVALID_TARGET, ts);
+
+    i = te;
+    if (i == n)
+        return set_error(p, H11_ERR_INVALID_VERSION, i);
+    i++;
+    if (tolerant) {
+        while (i < n && h11_is_ows(data[i]))
+            i++;
+    }
+    if (n - i < 8 || memcmp(data + i, "HTTP/", 5) != 0 || !h11_is_digit(data[i + 5]) ||
+        data[i + 6] != '.' || !h11_is_digit(data[i + 7]))
+        return set_error(p, H11_ERR_INVALID_VERSION, i);
+    u16 major = (u16)(data[i + 5] - '0');
+    u16 minor = (u16)(data[i + 7] - '0');
+    if (major != 1)
+        return set_error(p, H11_ERR_INVALID_VERSION, i + 5);
+    usize vend = i + 8;
+    if (tolerant) {
+        while (vend < n && h11_is_ows(data[vend]))
+            vend++;
+    }
+    if (vend != n)
+        return set_error(p, data[vend] == '\n' ? H11_ERR_INVALID_CRLF : H11_ERR_INVALID_VERSION,
+                         vend);
+
+    h11_request_t *r = &p->request;
+    r->method = (h11_span_t){ .off = (u32)p->total_consumed, .len = (u32)method_len };
+    r->target = (h11_span_t){ .off = (u32)(p->total_consumed + ts), .len = (u32)(te - ts) };
+    r->target_form = form;
+    r->version = (u16)((major << 8) | minor);
+    if (minor >= 1)
+        r->flags |= H11_REQF_KEEP_ALIVE;
+    *consumed = n + term;
+    return H11_OK;
+}
+
+/* ---- header fields (RFC 9112 S5) ---- */
+
+static u16 classify_header(const char *line, usize len) {
+    h11_span_t name = { .off = 0, .len = (u32)len };
+    switch (len) {
+    case 4:  return h11_span_eq_case(line, name, "host", 4) ? H11_KHDR_HOST : H11_INDEX_NONE;
+    case 6:  return h11_span_eq_case(line, name, "expect", 6) ? H11_KHDR_EXPECT : H11_INDEX_NONE;
+    case 7:  return h11_span_eq_case(line, name, "upgrade", 7) ? H11_KHDR_UPGRADE : H11_INDEX_NONE;
+    case 10: return h11_span_eq_case(line, name, "connection", 10) ? H11_KHDR_CONNECTION
+                                                                     : H11_INDEX_NONE;
+    case 14: return h11_span_eq_case(line, name, "content-length", 14) ? H11_KHDR_CONTENT_LENGTH
+                                                                         : H11_INDEX_NONE;
+    case 17: return h11_span_eq_case(line, name, "transfer-encoding", 17)
+                        ? H11_KHDR_TRANSFER_ENCODING : H11_INDEX_NONE;
+    default: return H11_INDEX_NONE;
+    }
+}
+
+static bool grow_fields(h11_header_t **arr, u32 *cap, u32 initial) {
+    u32 ncap = *cap ? *cap * 2 : initial;
+    h11_header_t *n = realloc(*arr, (usize)ncap * sizeof(**arr));
+    if (n == NULL)
+        return false;
+    *arr = n;
+    *cap = ncap;
+    return true;
+}
+
+/* ---- header shape cache (H11_CFG_SHAPE_CACHE) ---- */
+
+/* The cached name at idx, if the line starts with it followed by ':'. The
+ * compare is exact, so a hit is a name that already passed the tchar check
+ * and classified to the cached name_id. */
+H11_INLINE const h11_shape_entry_t *shape_match(const h11_parser_t *p, u32 idx,
+                                                const char *line, usize n) {
+    if (idx >= p->shape_count)
+        return NULL;
+    const h11_shape_entry_t *e = &p->shape[idx];
+    if (e->len >= n || line[e->len] != ':' || memcmp(line, p->shape_names + e->off, e->len) != 0)
+        return NULL;
+    return e;
+}
+
+/* Remember this request's field names for the next request on the
+ * connection; nothing to do when every name came from the cache. A failed
+ * allocation only drops the cache. */
+static void shape_record(h11_parser_t *p, const char *base) {
+    const h11_request_t *r = &p->request;
+    if (p->shape_hits == r->header_count && r->header_count == p->shape_count)
+        return;
+    usize total = 0;
+    bool fits = true;
+    for (u32 i = 0; i < r->header_count; i++) {
+        fits = fits && r->headers[i].name.len <= 0xFFFF;
+        total += r->headers[i].name.len;
+    }
+    p->shape_count = 0;
+    if (!fits)
+        return;
+    if (r->header_count > p->shape_cap) {
+        h11_shape_entry_t *e = realloc(p->shape, r->header_count * sizeof(*e));
+        if (e == NULL)
+            return;
+        p->shape = e;
+        p->shape_cap = r->header_count;
+    }
+    if (total > p->shape_names_cap) {
+        char *names = realloc(p->shape_names, total);
+        if (names == NULL)
+            return;
+        p->shape_names = names;
+        p->shape_names_cap = (u32)total;
+    }
+    u32 off = 0;
+    for (u32 i = 0; i < r->header_count; i++) {
+        const h11_header_t *h = &r->headers[i];
+        memcpy(p->shape_names + off, base + h->name.off, h->name.len);
+        p->shape[i] = (h11_shape_entry_t){ .off = off, .len = (u16)h->name.len,
+                                           .name_id = h->name_id };
+        off += h->name.len;
+    }
+    p->shape_count = r->header_count;
+}
+
+static void set_field(h11_header_t *h, usize off, usize colon, usize vs, usize ve, u16 name_id) {
+    h->name = (h11_span_t){ .off = (u32)off, .len = (u32)colon };
+    h->value = (h11_span_t){ .off = (u32)(off + vs), .len = (u32)(ve - vs) };
+    h->name_id = name_id;
+    h->flags = name_id != H11_INDEX_NONE ? H11_HEADER_F_KNOWN_NAME : 0;
+}
+
+H11_INLINE usize find_colon(const h11_parser_t *p, const char *line, usize n) {
+    /* The line lies inside the caller's data, so padding extends past it. */
+    return (p->config.flags & H11_CFG_PADDED_INPUT) ? h11_find_char_padded(line, n, ':')
+                                                    : h11_find_char(line, n, ':');
+}
+
+H11_INLINE void trim_ows(const char *line, usize *vs, usize *ve) {
+    while (*vs < *ve && h11_is_ows(line[*vs]))
+        (*vs)++;
+    while (*ve > *vs && h11_is_ows(line[*ve - 1]))
+        (*ve)--;
+}
+
+/* colon is the first ':' of the line, or n if there is none. */
+static h11_error_t check_name(const char *line, usize n, usize colon, usize *err_at) {
+    if (colon == 0 || colon == n) {
+        *err_at = colon;
+        return H11_ERR_INVALID_HEADER_NAME;
+    }
+    for (usize i = 0; i < colon; i++) {
+        if (!h11_is_tchar(line[i])) {
+            *err_at = i;
+            return H11_ERR_INVALID_HEADER_NAME;
+        }
+    }
+    return H11_OK;
+}
+
+/* Trims [*vs, *ve) and checks what remains. */
+static h11_error_t check_value(const char *line, usize *vs, usize *ve, bool obs_text,
+                               usize *err_at) {
+    trim_ows(line, vs, ve);
+    for (usize i = *vs; i < *ve; i++) {
+        u8 c = (u8)line[i];
+        if (!h11_is_vchar((char)c) || (c >= 0x80 && !obs_text)) {
+            *err_at = i;
+            return c == '\n' ? H11_ERR_INVALID_CRLF : H11_ERR_INVALID_HEADER_VALUE;
+        }
+    }
+    return H11_OK;
+}
+
+/* Split one field line into name and OWS-trimmed value; off is the
+ * request-relative offset of the line and hit its shape-cache entry, if
+ * any. The returned error is the header flavour; trailers remap it to
+ * H11_ERR_INVALID_TRAILER. */
+static h11_error_t parse_header_line(const h11_parser_t *p, const char *line, usize n, usize off,
+                                     const h11_shape_entry_t *hit, h11_header_t *h,
+                                     usize *err_at) {
+    usize colon = hit != NULL ? hit->len : find_colon(p, line, n);
+    h11_error_t err;
+    if (hit == NULL && (err = check_name(line, n, colon, err_at)) != H11_OK)
+        return err;
+    usize vs = colon + 1;
+    usize ve = n;
+    const bool obs_text = (p->config.flags & H11_CFG_ALLOW_OBS_TEXT) != 0;
+    if ((err = check_value(line, &vs, &ve, obs_text, err_at)) != H11_OK)
+        return err;
+    set_field(h, off, colon, vs, ve, hit != NULL ? hit->name_id : classify_header(line, colon));
+    return H11_OK;
+}
+
+/* Lazy fields (H11_CFG_LAZY_HEADERS) are stored trimmed, with obs-text
+ * already screened when the parser disallows it, so the checks
+ * parse_header_line skipped depend on nothing but the bytes. Checking leaves
+ * the request untouched. */
+h11_error_t h11_header_validate(const h11_request_t *req, const char *base, u32 idx) {
+    if (req == NULL || base == NULL || req->headers == NULL || idx >= req->header_count)
+        return H11_ERR_INTERNAL;
+    const h11_header_t *h = &req->headers[idx];
+    if (!(h->flags & H11_HEADER_F_LAZY))
+        return H11_OK;
+    if (h->flags & H11_HEADER_F_INVALID)
+        return H11_ERR_INVALID_HEADER_VALUE;
+    const char *line = base + h->name.off;
+    usize vs = h->value.off - h->name.off;
+    usize ve = vs + h->value.len;
+    usize err_at = 0;
+    h11_error_t err = check_name(line, ve, h->name.len, &err_at);
+    if (err == H11_OK)
+        err = check_value(line, &vs, &ve, true, &err_at);
+    return err;
+}
+
+/* ---- header block masks (H11_CFG_BLOCK_VALIDATE) ----
+ *
+ * The block is classified lazily, H11_BLOCK_WINDOW bytes first and doubling
+ * from there, so a body buffered behind the headers is not classified. Only
+ * bytes that could still belong to the header section are ever looked at. */
+
+typedef struct {
+    const char *data;
+    u64        *nontchar;
+    u64        *badval;
+    u64        *eol;
+    usize       len;    /* classified prefix of data, a multiple of 64 below limit */
+    usize       limit;  /* bytes that may still be header section */
+    bool        strict;
+    bool        obs_text;
+} block_t;
+
+/* First set bit of bm in [from, to), or to. */
+static usize mask_first(const u64 *bm, usize from, usize to) {
+    if (from >= to)
+        return to;
+    usize w = from >> 6;
+    u64 m = bm[w] & (~0ull << (from & 63));
+    for (;;) {
+        if (m) {
+            usize i = (w << 6) + h11_ctz64(m);
+            return i < to ? i : to;
+        }
+        if (++w << 6 >= to)
+            return to;
+        m = bm[w];
+    }
+}
+
+static bool block_init(h11_parser_t *p, block_t *b, const char *data, usize limit) {
+    usize words = (limit + 63) / 64;
+    if (words > p->block_words) {
+        u64 *m = realloc(p->block_masks, words * 3 * sizeof(u64));
+        if (m == NULL)
+            return false;
+        p->block_masks = m;
+        p->block_words = words;
+    }
+    b->data = data;
+    b->nontchar = p->block_masks;
+    b->badval = p->block_masks + p->block_words;
+    b->eol = p->block_masks + 2 * p->block_words;
+    b->len = 0;
+    b->limit = limit;
+    b->strict = (p->config.flags & H11_CFG_STRICT_CRLF) != 0;
+    b->obs_text = (p->config.flags & H11_CFG_ALLOW_OBS_TEXT) != 0;
+    return true;
+}
+
+static void block_extend(block_t *b) {
+    usize start = b->len;
+    usize end = start < H11_BLOCK_WINDOW ? H11_BLOCK_WINDOW : start * 2;
+    if (end > b->limit)
+        end = b->limit;
+    usize w = start / 64;
+    h11_classify_block(b->data + start, end - start, b->strict, b->obs_text, b->nontchar + w,
+                       b->badval + w, b->eol + w);
+    /* A CRLF split across the previous window ends a line too. */
+    if (b->strict && start > 0 && h11_is_cr(b->data[start - 1]) && h11_is_lf(b->data[start]))
+        b->eol[w] |= 1;
+    b->len = end;
+}
+
+/* Offset of the LF ending the line at pos, or limit if there is none. */
+static usize block_eol(block_t *b, usize pos) {
+    for (;;) {
+        usize e = mask_first(b->eol, pos, b->len);
+        if (e < b->len || b->len == b->limit)
+            return e == b->len ? b->limit : e;
+        block_extend(b);
+    }
+}
+
+/* parse_header_line over the masks: the first non-tchar of the line must be
+ * the colon and the value range must hold no badval bit. pos is the line's
+ * offset in the block. */
+static h11_error_t parse_header_line_block(const block_t *b, const char *line, usize pos, usize n,
+                                           usize off, const h11_shape_entry_t *hit,
+                                           h11_header_t *h, usize *err_at) {
+    usize colon = hit != NULL ? hit->len : mask_first(b->nontchar, pos, pos + n) - pos;
+    if (colon == n || line[colon] != ':') {
+        usize c = colon == n ? n : colon + h11_find_char(line + colon, n - colon, ':');
+        *err_at = c == n ? n : colon;
+        return H11_ERR_INVALID_HEADER_NAME;
+    }
+    if (colon == 0) {
+        *err_at = 0;
+        return H11_ERR_INVALID_HEADER_NAME;
+    }
+    usize bad = mask_first(b->badval, pos + colon + 1, pos + n) - pos;
+    if (bad < n) {
+        *err_at = bad;
+        return h11_is_lf(line[bad]) ? H11_ERR_INVALID_CRLF : H11_ERR_INVALID_HEADER_VALUE;
+    }
+    usize vs = colon + 1;
+    usize ve = n;
+    trim_ows(line, &vs, &ve);
+    set_field(h, off, colon, vs, ve, hit != NULL ? hit->name_id : classify_header(line, colon));
+    return H11_OK;
+}
+
+static h11_error_t parse_content_length(const char *v, usize len, u64 *out) {
+    bool have = false;
+    u64 result = 0;
+    usize i = 0;
+    while (i < len) {
+        usize s = i, e = i + h11_find_char(v + i, len - i, ',');
+        i = e + 1;
+        while (s < e && h11_is_ows(v[s]))
+            s++;
+        while (e > s && h11_is_ows(v[e - 1]))
+            e--;
+        if (s == e)
+            return H11_ERR_INVALID_CONTENT_LENGTH;
+        u64 x = 0;
+        for (usize k = s; k < e; k++) {
+            if (!h11_is_digit(v[k]))
+                return H11_ERR_INVALID_CONTENT_LENGTH;
+            u64 d = (u64)(v[k] - '0');
+            if (x > (UINT64_MAX - d) / 10)
+                return H11_ERR_CONTENT_LENGTH_OVERFLOW;
+            x = x * 10 + d;
+        }
+        if (have && x != result)
+            return H11_ERR_MULTIPLE_CONTENT_LENGTH;
+        result = x;
+        have = true;
+    }
+    if (!have)
+        return H11_ERR_INVALID_CONTENT_LENGTH;
+    *out = result;
+    return H11_OK;
+}
+
+static bool is_known_coding(const char *base, h11_span_t t) {
+    return h11_span_eq_case(base, t, "gzip", 4) || h11_span_eq_case(base, t, "deflate", 7) ||
+           h11_span_eq_case(base, t, "compress", 8) || h11_span_eq_case(base, t, "identity", 8) ||
+           h11_span_eq_case(base, t, "x-gzip", 6);
+}
+
+/* Transfer-Encoding lists from repeated fields form one list; is_chunked
+ * tracks whether the last coding seen so far is chunked. */
+static h11_error_t process_transfer_encoding(h11_parser_t *p, const char *base, h11_span_t v) {
+    h11_token_iter_t it;
+    h11_token_t tok;
+    bool any = false;
+    h11_token_iter_init(&it, base, v);
+    while (h11_token_next(&it, &tok)) {
+        any = true;
+        if (tok.token.len == 0)
+            return H11_ERR_INVALID_TRANSFER_ENCODING;
+        for (u32 i = 0; i < tok.token.len; i++) {
+            if (!h11_is_tchar(base[tok.token.off + i]))
+                return H11_ERR_INVALID_TRANSFER_ENCODING;
+        }
+        if (p->is_chunked)
+            return H11_ERR_TE_NOT_CHUNKED_FINAL;
+        if (h11_span_eq_case(base, tok.token, "chunked", 7)) {
+            if (tok.flags & H11_TOKEN_F_HAS_PARAMS)
+                return H11_ERR_INVALID_TRANSFER_ENCODING;
+            p->is_chunked = true;
+        } else if (!is_known_coding(base, tok.token)) {
+            return H11_ERR_UNKNOWN_TRANSFER_CODING;
+        }
+    }
+    return any ? H11_OK : H11_ERR_INVALID_TRANSFER_ENCODING;
+}
+
+static void process_connection(h11_parser_t *p, const char *base, h11_span_t v) {
+    h11_token_iter_t it;
+    h11_token_t tok;
+    h11_token_iter_init(&it, base, v);
+    while (h11_token_next(&it, &tok)) {
+        if (h11_span_eq_case(base, tok.token, "close", 5))
+            p->request.flags &= (u16)~H11_REQF_KEEP_ALIVE;
+        else if (h11_span_eq_case(base, tok.token, "keep-alive", 10))
+            p->request.flags |= H11_REQF_KEEP_ALIVE;
+    }
+}
+
+/* 100-continue is the only expectation RFC 9110 S10.1.1 defines; anything
+ * else, parameters included, is one the server cannot meet. */
+static void process_expect(h11_parser_t *p, const char *base, h11_span_t v) {
+    h11_token_iter_t it;
+    h11_token_t tok;
+    h11_token_iter_init(&it, base, v);
+    while (h11_token_next(&it, &tok)) {
+        if (!(tok.flags & H11_TOKEN_F_HAS_PARAMS) &&
+            h11_span_eq_case(base, tok.token, "100-continue", 12))
+            p->request.flags |= H11_REQF_EXPECT_CONTINUE;
+        else
+            p->request.flags |= H11_REQF_EXPECT_UNSUPPORTED;
+    }
+}
+
+/* base resolves request-relative spans (base + span.off) into the input. */
+static h11_error_t process_semantic_header(h11_parser_t *p, const char *base, u32 idx) {
+    h11_request_t *r = &p->request;
+    const h11_header_t *h = &r->headers[idx];
+    if (h->name_id == H11_INDEX_NONE)
+        return H11_OK;
+    if (r->known_idx[h->name_id] == H11_INDEX_NONE)
+        r->known_idx[h->name_id] = (u16)idx;
+    switch (h->name_id) {
+    case H11_KHDR_HOST:
+        if (p->seen_host)
+            return H11_ERR_MULTIPLE_HOST;
+        p->seen_host = true;
+        r->flags |= H11_REQF_HAS_HOST;
+        break;
+    case H11_KHDR_CONTENT_LENGTH: {
+        u64 cl = 0;
+        h11_error_t err = parse_content_length(base + h->value.off, h->value.len, &cl);
+        if (err != H11_OK)
+            return err;
+        if (p->seen_content_length && cl != r->content_length)
+            return H11_ERR_MULTIPLE_CONTENT_LENGTH;
+        p->seen_content_length = true;
+        r->content_length = cl;
+        r->flags |= H11_REQF_HAS_CONTENT_LENGTH;
+        break;
+    }
+    case H11_KHDR_TRANSFER_ENCODING:
+        p->seen_transfer_encoding = true;
+        r->flags |= H11_REQF_HAS_TRANSFER_ENCODING;
+        return process_transfer_encoding(p, base, h->value);
+    case H11_KHDR_CONNECTION:
+        process_connection(p, base, h->value);
+        break;
+    case H11_KHDR_EXPECT:
+        if ((r->version & 0xFF) >= 1)
+            process_expect(p, base, h->value);
+        break;
+    case H11_KHDR_UPGRADE:
+        r->flags |= H11_REQF_HAS_UPGRADE;
+        break;
+    }
+    return H11_OK;
+}
+
+static bool method_is(const char *base, h11_span_t m, const char *lit, usize len) {
+    return m.len == len && memcmp(base + m.off, lit, len) == 0;
+}
+
+static h11_error_t finalize_headers(h11_parser_t *p, const char *base) {
+    h11_request_t *r = &p->request;
+    const h11_config_t *cfg = &p->config;
+
+    if (!p->seen_host) {
+        if ((r->version & 0xFF) >= 1)
+            return H11_ERR_MISSING_HOST;
+    } else {
+        h11_span_t host = r->headers[r->known_idx[H11_KHDR_HOST]].value;
+        if (host.len == 0) {
+            if (r->target_form == H11_TARGET_ABSOLUTE || r->target_form == H11_TARGET_AUTHORITY)
+                return H11_ERR_INVALID_HOST;
+        } else if (!valid_host_port(base + host.off, host.len, false)) {
+            return H11_ERR_INVALID_HOST;
+        }
+    }
+
+    if (p->seen_transfer_encoding) {
+        if (!p->is_chunked)
+            return H11_ERR_TE_NOT_CHUNKED_FINAL;
+        if (p->seen_content_length) {
+            if (cfg->flags & H11_CFG_REJECT_TE_CL_CONFLICT)
+                return H11_ERR_TE_CL_CONFLICT;
+            r->flags &= (u16)~H11_REQF_KEEP_ALIVE;
+        }
+        if ((r->version & 0xFF) == 0)
+            r->flags &= (u16)~H11_REQF_KEEP_ALIVE;
+        r->flags |= H11_REQF_IS_CHUNKED;
+        r->body_type = H11_BODY_CHUNKED;
+    } else if (p->seen_content_length) {
+        if (r->content_length > cfg->max_body_size)
+            return H11_ERR_BODY_TOO_LARGE;
+        r->body_type = H11_BODY_CONTENT_LENGTH;
+    } else {
+        r->body_type = H11_BODY_NONE;
+    }
+
+    bool is_connect = method_is(base, r->method, "CONNECT", 7);
+    if (is_connect != (r->target_form == H11_TARGET_AUTHORITY))
+        return H11_ERR_INVALID_TARGET;
+    if (r->target_form == H11_TARGET_ASTERISK && !method_is(base, r->method, "OPTIONS", 7))
+        return H11_ERR_INVALID_TARGET;
+    return H11_OK;
+}
+
+static void enter_body_state(h11_parser_t *p) {
+    const h11_request_t *r = &p->request;
+    if (r->body_type == H11_BODY_CHUNKED) {
+        p->state = H11_STATE_BODY_CHUNKED_SIZE;
+    } else if (r->body_type == H11_BODY_CONTENT_LENGTH && r->content_length > 0) {
+        p->body_remaining = r->content_length;
+        p->state = H11_STATE_BODY_IDENTITY;
+    } else {
+        p->state = H11_STATE_COMPLETE;
+    }
+}
+
+/* Shared by the header section and the trailer section. Only whole lines
+ * are consumed; *consumed is valid on every return. Block validation only
+ * covers the header section; trailers keep the per-field checks. */
+static h11_error_t h11_parse_fields(h11_parser_t *p, const char *data, usize len,
+                                    usize *consumed, bool trailers) {
+    const h11_config_t *cfg = &p->config;
+    h11_request_t *r = &p->request;
+    /* Spans are request-relative: base + span.off resolves into data. */
+    const char *base = data - p->total_consumed;
+    /* Block validation checks every field anyway, so it overrides lazy. */
+    const u32 mode = cfg->flags & (H11_CFG_LAZY_HEADERS | H11_CFG_BLOCK_VALIDATE);
+    const bool lazy = !trailers && mode == H11_CFG_LAZY_HEADERS;
+    block_t blk = { .limit = 0 };
+    if (!trailers && (cfg->flags & H11_CFG_BLOCK_VALIDATE)) {
+        usize room = cfg->max_headers_size > p->headers_size
+                         ? cfg->max_headers_size - p->headers_size : 0;
+        if (!block_init(p, &blk, data, len < room ? len : room))
+            return set_error(p, H11_ERR_INTERNAL, 0);
+    }
+    usize pos = 0;
+    for (;;) {
+        const char *line = data + pos;
+        usize remaining = len - pos;
+        usize term = 2;
+        usize n;
+        usize eol = blk.limit > 0 ? block_eol(&blk, pos) : blk.limit;
+        if (eol < blk.limit) {
+            bool cr = eol > pos && h11_is_cr(data[eol - 1]);
+            term = cr ? 2 : 1;
+            n = eol - pos - term + 1;
+        } else {
+            /* No line end in the classified range: the per-field path
+             * decides between waiting and the size errors. */
+            n = find_line(p, line, remaining, &term);
+        }
+        *consumed = pos;
+        if (n == remaining) {
+            if (remaining > cfg->max_header_line_len)
+                return set_error(p, H11_ERR_HEADER_LINE_TOO_LONG, pos);
+            if (p->headers_size + remaining > cfg->max_headers_size)
+                return set_error(p, H11_ERR_HEADERS_TOO_LARGE, pos);
+            return H11_NEED_MORE_DATA;
+        }
+        if (n > cfg->max_header_line_len)
+            return set_error(p, H11_ERR_HEADER_LINE_TOO_LONG, pos);
+        if (p->headers_size + n + term > cfg->max_headers_size)
+            return set_error(p, H11_ERR_HEADERS_TOO_LARGE, pos);
+
+        if (n == 0) {
+            p->headers_size += term;
+            *consumed = pos + term;
+            if (trailers) {
+                p->state = H11_STATE_COMPLETE;
+                return H11_OK;
+            }
+            h11_error_t err = finalize_headers(p, base);
+            if (err != H11_OK)
+                return set_error(p, err, pos);
+            if (cfg->flags & H11_CFG_SHAPE_CACHE)
+                shape_record(p, base);
+            enter_body_state(p);
+            return H11_OK;
+        }
+
+        if (h11_is_ows(line[0])) {
+            if (trailers)
+                return set_error(p, H11_ERR_INVALID_TRAILER, pos);
+            if (r->header_count == 0)
+                return set_error(p, H11_ERR_LEADING_WHITESPACE, pos);
+            if (cfg->flags & H11_CFG_REJECT_OBS_FOLD)
+                return set_error(p, H11_ERR_OBS_FOLD_REJECTED, pos);
+            p->headers_size += n + term;
+            pos += n + term;
+            continue;
+        }
+
+        u32 *count = trailers ? &r->trailer_count : &r->header_count;
+        if (*count >= cfg->max_header_count)
+            return set_error(p, H11_ERR_TOO_MANY_HEADERS, pos);
+        h11_header_t **arr = trailers ? &r->trailers : &r->headers;
+        u32 *cap = trailers ? &p->trailer_cap : &p->header_cap;
+        if (*count == *cap &&
+            !grow_fields(arr, cap, trailers ? H11_TRAILERS_INITIAL_CAP : H11_HEADERS_INITIAL_CAP))
+            return set_error(p, H11_ERR_INTERNAL, pos);
+
+        h11_header_t *h = &(*arr)[*count];
+        const h11_shape_entry_t *hit = trailers ? NULL : shape_match(p, *count, line, n);
+        p->shape_hits += hit != NULL;
+        usize err_at = 0;
+        usize off = p->total_consumed + pos;
+        if (lazy && (hit == NULL || hit->name_id == H11_INDEX_NONE)) {
+            /* Deferred checks never cover what could change how another
+             * parser frames the message: whitespace before the colon, or a
+             * CR or LF inside the line. */
+            usize colon = hit != NULL ? hit->len : find_colon(p, line, n);
+            if (colon == 0 || colon == n || h11_is_ows(line[colon - 1]))
+                return set_error(p, H11_ERR_INVALID_HEADER_NAME, pos + colon);
+            usize ctl = colon + 1 + h11_find_char2(line + colon + 1, n - colon - 1, '\r', '\n');
+            if (ctl < n)
+                return set_error(p, h11_is_lf(line[ctl]) ? H11_ERR_INVALID_CRLF
+                                                         : H11_ERR_INVALID_HEADER_VALUE, pos + ctl);
+            if (hit != NULL || classify_header(line, colon) == H11_INDEX_NONE) {
+                usize vs = colon + 1, ve = n;
+                trim_ows(line, &vs, &ve);
+                set_field(h, off, colon, vs, ve, H11_INDEX_NONE);
+                h->flags = H11_HEADER_F_LAZY;
+                if (!(cfg->flags & H11_CFG_ALLOW_OBS_TEXT) &&
+                    h11_find_nonascii(line + vs, ve - vs) < ve - vs)
+                    h->flags |= H11_HEADER_F_INVALID;
+                (*count)++;
+                p->headers_size += n + term;
+                pos += n + term;
+                continue;
+            }
+        }
+        h11_error_t err = eol < blk.limit
+                              ? parse_header_line_block(&blk, line, pos, n, off, hit, h, &err_at)
+                              : parse_header_line(p, line, n, off, hit, h, &err_at);
+        if (err != H11_OK)
+            return set_error(p, trailers ? H11_ERR_INVALID_TRAILER : err, pos + err_at);
+        u32 idx = (*count)++;
+        if (trailers) {
+            h->name_id = H11_INDEX_NONE;
+            h->flags = 0;
+        } else if ((err = process_semantic_header(p, base, idx)) != H11_OK) {
+            return set_error(p, err, pos);
+        }
+        p->headers_size += n + term;
+        pos += n + term;
+    }
+}
+
+/* ---- chunked body (RFC 9112 S7.1) ---- */
+
+H11_INLINE usize skip_bws(const char *s, usize i, usize n) {
+    while (i < n && h11_is_ows(s[i]))
+        i++;
+    return i;
+}
+
+/* chunk-ext = *( BWS ";" BWS ext-name [ BWS "=" BWS ext-val ] ); the
+ * content is validated and discarded. */
+static h11_error_t parse_chunk_ext(const char *s, usize i, usize n) {
+    while ((i = skip_bws(s, i, n)) < n) {
+        if (s[i] != ';')
+            return H11_ERR_INVALID_CHUNK_EXT;
+        i = skip_bws(s, i + 1, n);
+        usize name = i;
+        while (i < n && h11_is_tchar(s[i]))
+            i++;
+        if (i == name)
+            return H11_ERR_INVALID_CHUNK_EXT;
+        i = skip_bws(s, i, n);
+        if (i == n || s[i] != '=')
+            continue;
+        i = skip_bws(s, i + 1, n);
+        if (i < n && s[i] == '"') {
+            for (i++; i < n && s[i] != '"'; i++) {
+                u8 c = (u8)s[i];
+                if (c == '\\') {
+                    if (++i == n)
+                        return H11_ERR_INVALID_CHUNK_EXT;
+                } else if (!h11_is_vchar((char)c)) {
+                    return H11_ERR_INVALID_CHUNK_EXT;
+                }
+            }
+            if (i == n)
+                return H11_ERR_INVALID_CHUNK_EXT;
+            i++;
+        } else {
+            usize val = i;
+            while (i < n && h11_is_tchar(s[i]))
+                i++;
+            if (i == val)
+                return H11_ERR_INVALID_CHUNK_EXT;
+        }
+    }
+    return H11_OK;
+}
+
+static h11_error_t h11_parse_chunk_size(h11_parser_t *p, const char *data, usize len,
+                                        usize *consumed) {
+    const h11_config_t *cfg = &p->config;
+    usize term = 2;
+    usize n = find_line(p, data, len, &term);
+    if (n == len) {
+        if (len > H11_CHUNK_LINE_SLACK + (usize)cfg->max_chunk_ext_len) {
+            bool has_ext = h11_find_char(data, len, ';') < len;
+            return set_error(p, has_ext ? H11_ERR_CHUNK_EXT_TOO_LONG : H11_ERR_INVALID_CHUNK_SIZE,
+                             len);
+        }
+        return H11_NEED_MORE_DATA;
+    }
+    u64 size = 0;
+    usize i = 0;
+    while (i < n && h11_is_hexdig(data[i])) {
+        u64 d = (u64)h11_hexval(data[i]);
+        if (size > (UINT64_MAX - d) / 16)
+            return set_error(p, H11_ERR_CHUNK_SIZE_OVERFLOW, i);
+        size = size * 16 + d;
+        i++;
+    }
+    if (i == 0)
+        return set_error(p, H11_ERR_INVALID_CHUNK_SIZE, 0);
+    if (size > cfg->max_body_size - p->total_body_read)
+        return set_error(p, H11_ERR_BODY_TOO_LARGE, 0);
+    usize ext = skip_bws(data, i, n);
+    if (ext < n) {
+        if (data[ext] != ';')
+            return set_error(p, H11_ERR_INVALID_CHUNK_SIZE, ext);
+        p->chunk_ext_len = n - ext;
+        if (p->chunk_ext_len > cfg->max_chunk_ext_len)
+            return set_error(p, H11_ERR_CHUNK_EXT_TOO_LONG, ext);
+        h11_error_t err = parse_chunk_ext(data, i, n);
+        if (err != H11_OK)
+            return set_error(p, err, ext);
+    }
+    *consumed = n + term;
+    if (size == 0) {
+        p->state = H11_STATE_TRAILERS;
+    } else {
+        p->body_remaining = size;
+        p->state = H11_STATE_BODY_CHUNKED_DATA;
+    }
+    return H11_OK;
+}
+
+static h11_error_t h11_parse_chunk_crlf(h11_parser_t *p, const char *data, usize len,
+                                        usize *consumed) {
+    const bool strict = (p->config.flags & H11_CFG_STRICT_CRLF) != 0;
+    if (len >= 1 && !strict && h11_is_lf(data[0])) {
+        *consumed = 1;
+    } else if (len < 2) {
+        if (len == 1 && !h11_is_cr(data[0]))
+            return set_error(p, H11_ERR_INVALID_CHUNK_DATA, 0);
+        return H11_NEED_MORE_DATA;
+    } else if (h11_is_cr(data[0]) && h11_is_lf(data[1])) {
+        *consumed = 2;
+    } else {
+        return set_error(p, H11_ERR_INVALID_CHUNK_DATA, 0);
+    }
+    p->state = H11_STATE_BODY_CHUNKED_SIZE;
+    return H11_OK;
+}
+
+/* ---- driver ---- */
+
+static h11_error_t h11_skip_leading_crlf(h11_parser_t *p, const char *data, usize len,
+                                         usize *consumed) {
+    const bool strict = (p->config.flags & H11_CFG_STRICT_CRLF) != 0;
+    usize i = 0;
+    if (p->config.flags & H11_CFG_ALLOW_LEADING_CRLF) {
+        for (;;) {
+            if (i + 2 <= len && h11_is_cr(data[i]) && h11_is_lf(data[i + 1])) {
+                i += 2;
+            } else if (i < len && !strict && h11_is_lf(data[i])) {
+                i++;
+            } else {
+                break;
+            }
+        }
+        if (i == len || (i + 1 == len && h11_is_cr(data[i]))) {
+            *consumed = i;
+            p->leading_crlf_consumed = p->leading_crlf_consumed || i > 0;
+            return H11_NEED_MORE_DATA;
+        }
+    }
+    *consumed = i;
+    p->leading_crlf_consumed = p->leading_crlf_consumed || i > 0;
+    p->state = H11_STATE_REQUEST_LINE;
+    return H11_OK;
+}
+
+h11_error_t h11_parse(h11_parser_t *p, const char *data, usize len, usize *consumed) {
+    if (consumed != NULL)
+        *consumed = 0;
+    if (p == NULL || consumed == NULL || (data == NULL && len > 0))
+        return H11_ERR_INTERNAL;
+    if (p->state == H11_STATE_ERROR)
+        return p->last_error;
+    usize pos = 0;
+    for (;;) {
+        usize used = 0;
+        h11_error_t err;
+        switch (p->state) {
+        case H11_STATE_IDLE:
+            if (pos == len)
+                return H11_NEED_MORE_DATA;
+            err = h11_skip_leading_crlf(p, data + pos, len - pos, &used);
+            break;
+        case H11_STATE_REQUEST_LINE:
+            err = h11_parse_request_line(p, data + pos, len - pos, &used);
+            if (err == H11_OK)
+                p->state = H11_STATE_HEADERS;
+            break;
+        case H11_STATE_HEADERS:
+            err = h11_parse_fields(p, data + pos, len - pos, &used, false);
+            break;
+        case H11_STATE_BODY_CHUNKED_SIZE:
+            err = h11_parse_chunk_size(p, data + pos, len - pos, &used);
+            break;
+        case H11_STATE_BODY_CHUNKED_CRLF:
+            err = h11_parse_chunk_crlf(p, data + pos, len - pos, &used);
+            break;
+        case H11_STATE_TRAILERS:
+            err = h11_parse_fields(p, data + pos, len - pos, &used, true);
+            break;
+        case H11_STATE_BODY_IDENTITY:
+        case H11_STATE_BODY_CHUNKED_DATA:
+        case H11_STATE_COMPLETE:
+            return H11_OK;
+        default:
+            return set_error(p, H11_ERR_INTERNAL, 0);
+        }
+        pos += used;
+        p->total_consumed += used;
+        *consumed = pos;
+        if (err != H11_OK)
+            return err;
+    }
+}
+
+/* Accounts for n bytes of the current identity body or chunk, n no more
+ * than body_remaining. */
+static h11_error_t body_take(h11_parser_t *p, u64 n) {
+    if (p->total_body_read + n > p->config.max_body_size)
+        return set_error(p, H11_ERR_BODY_TOO_LARGE, 0);
+    p->body_remaining -= n;
+    p->total_body_read += n;
+    p->total_consumed += (usize)n;
+    if (p->body_remaining == 0) {
+        p->state = p->state == H11_STATE_BODY_IDENTITY ? H11_STATE_COMPLETE
+                                                        : H11_STATE_BODY_CHUNKED_CRLF;
+    }
+    return H11_OK;
+}
+
+h11_error_t h11_read_body(h11_parser_t *p, const char *data, usize len, usize *consumed,
+                          const char **body_out, usize *body_len) {
+    if (consumed != NULL)
+        *consumed = 0;
+    if (body_len != NULL)
+        *body_len = 0;
+    if (p == NULL || consumed == NULL || body_out == NULL || body_len == NULL ||
+        (data == NULL && len > 0))
+        return H11_ERR_INTERNAL;
+    if (p->state == H11_STATE_ERROR)
+        return p->last_error;
+    if (p->state != H11_STATE_BODY_IDENTITY && p->state != H11_STATE_BODY_CHUNKED_DATA)
+        return H11_ERR_INTERNAL;
+    if (len == 0)
+        return H11_NEED_MORE_DATA;
+    usize to_read = len;
+    if ((u64)to_read > p->body_remaining)
+        to_read = (usize)p->body_remaining;
+    h11_error_t err = body_take(p, to_read);
+    if (err != H11_OK)
+        return err;
+    *body_out = data;
+    *body_len = to_read;
+    *consumed = to_read;
+    return H11_OK;
+}
+
+u64 h11_body_pending(const h11_parser_t *p) {
+    if (p == NULL ||
+        (p->state != H11_STATE_BODY_IDENTITY && p->state != H11_STATE_BODY_CHUNKED_DATA))
+        return 0;
+    return p->body_remaining;
+}
+
+h11_error_t h11_body_advance(h11_parser_t *p, u64 n) {
+    if (p == NULL)
+        return H11_ERR_INTERNAL;
+    if (p->state == H11_STATE_ERROR)
+        return p->last_error;
+    if ((p->state != H11_STATE_BODY_IDENTITY && p->state != H11_STATE_BODY_CHUNKED_DATA) ||
+        n > p->body_remaining)
+        return H11_ERR_INTERNAL;
+    return n == 0 ? H11_OK : body_take(p, n);
+}
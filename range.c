@@ -0,0 +1,113 @@
+/*
+ * range.c — Range header parsing (RFC 9110 S14.1.2) into a sorted,
+ *           coalesced set of byte ranges
+ */
+#include "h11_internal.h"
+
+static bool parse_u64(const char *p, usize len, u64 *out) {
+    if (len == 0)
+        return false;
+    u64 v = 0;
+    for (usize i = 0; i < len; i++) {
+        if (!h11_is_digit(p[i]))
+            return false;
+        u64 d = (u64)(p[i] - '0');
+        if (v > (UINT64_MAX - d) / 10)
+            return false;
+        v = v * 10 + d;
+    }
+    *out = v;
+    return true;
+}
+
+/* Insert [first, last] into the sorted set, merging with every range it
+ * overlaps or touches. The set never holds two ranges that could be served
+ * by one contiguous read. Callers clamp last below UINT64_MAX first. */
+static bool range_insert(h11_range_t *r, u32 *n, u32 max, u64 first, u64 last) {
+    u32 i = 0;
+    while (i < *n && r[i].last + 1 < first)
+        i++;
+    u32 j = i;
+    while (j < *n && r[j].first <= last + 1) {
+        if (r[j].first < first)
+            first = r[j].first;
+        if (r[j].last > last)
+            last = r[j].last;
+        j++;
+    }
+    if (i == j) {
+        if (*n == max)
+            return false;
+        for (u32 k = *n; k > i; k--)
+            r[k] = r[k - 1];
+        (*n)++;
+    } else if (j - i > 1) {
+        for (u32 k = j; k < *n; k++)
+            r[k - (j - i - 1)] = r[k];
+        *n -= j - i - 1;
+    }
+    r[i].first = first;
+    r[i].last = last;
+    return true;
+}
+
+h11_error_t h11_range_parse(const char *base, h11_span_t value, u64 size,
+                            h11_range_t *ranges, u32 max_ranges, u32 *count) {
+    if (base == NULL || ranges == NULL || count == NULL || max_ranges == 0)
+        return H11_ERR_INTERNAL;
+    *count = 0;
+    const char *p = base + value.off;
+    usize len = value.len;
+    h11_span_t unit = { .off = value.off, .len = 5 };
+    if (len < 6 || !h11_span_eq_case(base, unit, "bytes", 5) || p[5] != '=')
+        return H11_ERR_INVALID_RANGE;
+
+    u32 n = 0;
+    bool any_spec = false;
+    usize i = 6;
+    while (i <= len) {
+        usize end = i + h11_find_char(p + i, len - i, ',');
+        usize s = i, e = end;
+        i = end + 1;
+        while (s < e && h11_is_ows(p[s]))
+            s++;
+        while (e > s && h11_is_ows(p[e - 1]))
+            e--;
+        if (s == e)
+            continue;
+        usize dash = s + h11_find_char(p + s, e - s, '-');
+        if (dash == e)
+            return H11_ERR_INVALID_RANGE;
+        u64 first, last;
+        any_spec = true;
+        if (dash == s) {
+            u64 suffix;
+            if (!parse_u64(p + dash + 1, e - dash - 1, &suffix))
+                return H11_ERR_INVALID_RANGE;
+            if (suffix == 0 || size == 0)
+                continue;
+            first = suffix >= size ? 0 : size - suffix;
+            last = size - 1;
+        } else {
+            if (!parse_u64(p + s, dash - s, &first))
+                return H11_ERR_INVALID_RANGE;
+            if (dash + 1 == e) {
+                last = UINT64_MAX;
+            } else if (!parse_u64(p + dash + 1, e - dash - 1, &last) || last < first) {
+                return H11_ERR_INVALID_RANGE;
+            }
+            if (first >= size)
+                continue;
+            if (last >= size)
+                last = size - 1;
+        }
+        if (!range_insert(ranges, &n, max_ranges, first, last))
+            return H11_ERR_TOO_MANY_RANGES;
+    }
+    if (!any_spec)
+        return H11_ERR_INVALID_RANGE;
+    if (n == 0)
+        return H11_ERR_RANGE_NOT_SATISFIABLE;
+    *count = n;
+    return H11_OK;
+}
@@ -0,0 +1,1178 @@
+/*
+ * scan.c — CPU detection, SIMD byte scanners and the WebSocket mask kernel
+ *
+ * Every SIMD variant is compiled with a per-function target attribute so the
+ * library builds with plain -O3; h11_init() picks the level at runtime and
+ * the h11_find_* entry points dispatch on h11_simd_level.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include "h11_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define H11_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define H11_TARGET(t) __attribute__((target(t)))
+#else
+#define H11_X86 0
+#endif
+
+h11_simd_level_t h11_simd_level = H11_SIMD_SCALAR;
+static bool h11_initialized = false;
+static bool h11_detected = false;
+static h11_simd_level_t h11_detected_level = H11_SIMD_SCALAR;
+
+static bool h11_calibrated = false;
+static h11_simd_calibration_t h11_calibration;
+
+static const char *const h11_simd_names[] = {
+    "scalar", "sse42", "avx2", "avx512vl", "avx512",
+};
+
+#if H11_X86
+static u64 h11_xgetbv(void) {
+    u32 lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64)hi << 32) | lo;
+}
+
+static h11_simd_level_t h11_detect_simd(void) {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return H11_SIMD_SCALAR;
+    bool sse42 = (ecx & (1u << 20)) != 0;
+    bool osxsave = (ecx & (1u << 27)) != 0;
+    h11_simd_level_t level = sse42 ? H11_SIMD_SSE42 : H11_SIMD_SCALAR;
+    if (!osxsave || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return level;
+    u64 xcr0 = h11_xgetbv();
+    if ((ebx & (1u << 5)) && (xcr0 & 0x06) == 0x06)
+        level = H11_SIMD_AVX2;
+    /* Both AVX-512 levels need F+BW+VL so that forcing the 256-bit level
+     * is always possible where the 512-bit one was detected. */
+    if ((ebx & (1u << 16)) && (ebx & (1u << 30)) && (ebx & (1u << 31)) &&
+        (xcr0 & 0xE6) == 0xE6)
+        level = H11_SIMD_AVX512;
+    return level;
+}
+#else
+/* Every vector kernel is x86-only, so other targets (aarch64 included, until
+ * NEON kernels exist) report the SWAR scalar level they actually run. */
+static h11_simd_level_t h11_detect_simd(void) {
+    return H11_SIMD_SCALAR;
+}
+#endif
+
+h11_simd_level_t h11_simd_supported(void) {
+    if (!h11_detected) {
+        h11_detected_level = h11_detect_simd();
+        h11_detected = true;
+    }
+    return h11_detected_level;
+}
+
+h11_simd_level_t h11_simd_active(void) {
+    return h11_simd_level;
+}
+
+const char *h11_simd_name(h11_simd_level_t level) {
+    if ((unsigned)level >= H11_ARRAY_LEN(h11_simd_names))
+        return "unknown";
+    return h11_simd_names[level];
+}
+
+bool h11_simd_from_name(const char *name, h11_simd_level_t *level) {
+    if (name == NULL || level == NULL)
+        return false;
+    for (unsigned i = 0; i < H11_ARRAY_LEN(h11_simd_names); i++) {
+        if (strcmp(name, h11_simd_names[i]) == 0) {
+            *level = (h11_simd_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Levels above what the CPU supports are clamped rather than honoured, so a
+ * fleet-wide cap can never select instructions the host lacks. The forced
+ * level survives later h11_init() calls. */
+h11_simd_level_t h11_simd_force(h11_simd_level_t level) {
+    h11_simd_level_t max = h11_simd_supported();
+    h11_simd_level = (unsigned)level > (unsigned)max ? max : level;
+    h11_initialized = true;
+    return h11_simd_level;
+}
+
+/* H11_SIMD=scalar|sse42|avx2|avx512vl|avx512 caps the detected level; H11_SIMD=auto
+ * measures every supported level and keeps the fastest. Unknown values are
+ * ignored. */
+void h11_init(void) {
+    if (h11_initialized)
+        return;
+    h11_simd_level_t level = h11_simd_supported();
+    h11_simd_level_t cap;
+    const char *env = getenv("H11_SIMD");
+    if (env != NULL && strcmp(env, "auto") == 0) {
+        h11_simd_calibrate(NULL);
+        return;
+    }
+    if (env != NULL && h11_simd_from_name(env, &cap) && cap < level)
+        level = cap;
+    h11_simd_level = level;
+    h11_initialized = true;
+}
+
+/* ---- scalar: 64-bit SWAR ----
+ *
+ * Eight bytes per step on any target. Words are assembled little-endian
+ * (byte k in bits 8k..8k+7) so the first match is always the lowest set
+ * bit; compilers fold the assembly into one load. swar_eq is the exact form
+ * of the haszero trick: no borrow crosses bytes, so every flagged byte is a
+ * real match and candidates can be walked bit by bit. */
+
+#define SWAR_ONES 0x0101010101010101ull
+#define SWAR_LOW7 0x7F7F7F7F7F7F7F7Full
+#define SWAR_HIGH 0x8080808080808080ull
+
+H11_INLINE u64 swar_load(const char *p, usize n) {
+    u64 v = 0;
+    for (usize k = 0; k < n; k++)
+        v |= (u64)(u8)p[k] << (8 * k);
+    return v;
+}
+
+/* High bit of each byte of v that equals the byte in pat. */
+H11_INLINE u64 swar_eq(u64 v, u64 pat) {
+    u64 x = v ^ pat;
+    return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x | SWAR_LOW7);
+}
+
+H11_INLINE usize swar_index(u64 m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (usize)__builtin_ctzll(m) >> 3;
+#else
+    usize i = 0;
+    while (!(m & 0x80u)) {
+        m >>= 8;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* Valid-lane mask for a partial word of n (< 8) bytes. */
+H11_INLINE u64 swar_valid(usize n) {
+    return SWAR_HIGH & ((1ull << (8 * n)) - 1);
+}
+
+static usize find_char_scalar(const char *data, usize len, char c) {
+    const u64 pat = SWAR_ONES * (u8)c;
+    usize i = 0;
+    for (; i + 8 <= len; i += 8) {
+        u64 m = swar_eq(swar_load(data + i, 8), pat);
+        if (m)
+            return i + swar_index(m);
+    }
+    if (i < len) {
+        u64 m = swar_eq(swar_load(data + i, len - i), pat) & swar_valid(len - i);
+        if (m)
+            return i + swar_index(m);
+    }
+    return len;
+}
+
+static usize find_char2_scalar(const char *data, usize len, char a, char b) {
+    const u64 pa = SWAR_ONES * (u8)a;
+    const u64 pb = SWAR_ONES * (u8)b;
+    usize i = 0;
+    for (; i + 8 <= len; i += 8) {
+        u64 v = swar_load(data + i, 8);
+        u64 m = swar_eq(v, pa) | swar_eq(v, pb);
+        if (m)
+            return i + swar_index(m);
+    }
+    if (i < len) {
+        u64 v = swar_load(data + i, len - i);
+        u64 m = (swar_eq(v, pa) | swar_eq(v, pb)) & swar_valid(len - i);
+        if (m)
+            return i + swar_index(m);
+    }
+    return len;
+}
+
+/* CR lanes whose LF is in the same word pair up by one shift; a CR in the
+ * top lane is checked against the next byte. */
+static usize find_crlf_scalar(const char *data, usize len) {
+    const u64 pcr = SWAR_ONES * '\r';
+    const u64 plf = SWAR_ONES * '\n';
+    for (usize i = 0; i + 1 < len; i += 8) {
+        usize n = len - i < 8 ? len - i : 8;
+        u64 v = swar_load(data + i, n);
+        u64 cr = swar_eq(v, pcr);
+        u64 lf = swar_eq(v, plf);
+        if (n < 8) {
+            cr &= swar_valid(n);
+            lf &= swar_valid(n);
+        }
+        u64 m = cr & ((lf >> 8) | 0x8000000000000000ull);
+        if (m) {
+            usize pos = i + swar_index(m);
+            if (pos + 1 < len && h11_is_lf(data[pos + 1]))
+                return pos;
+        }
+    }
+    return len;
+}
+
+static usize find_nonascii_scalar(const char *data, usize len) {
+    usize i = 0;
+    for (; i + 8 <= len; i += 8) {
+        u64 m = swar_load(data + i, 8) & SWAR_HIGH;
+        if (m)
+            return i + swar_index(m);
+    }
+    if (i < len) {
+        u64 m = swar_load(data + i, len - i) & SWAR_HIGH;
+        if (m)
+            return i + swar_index(m);
+    }
+    return len;
+}
+
+/* The key pattern is laid out in memory byte by byte, so XOR on native
+ * words is right on either byte order. */
+static void mask_xor_scalar(char *data, usize len, u32 key) {
+    u8 kb[8];
+    for (usize k = 0; k < 8; k++)
+        kb[k] = (u8)(key >> (8 * (k & 3)));
+    u64 kw;
+    memcpy(&kw, kb, 8);
+    usize i = 0;
+    for (; i + 8 <= len; i += 8) {
+        u64 v;
+        memcpy(&v, data + i, 8);
+        v ^= kw;
+        memcpy(data + i, &v, 8);
+    }
+    for (; i < len; i++)
+        data[i] = (char)(data[i] ^ kb[i & 3]);
+}
+
+/* Raw per-byte masks of one 64-byte word of a header block. */
+typedef struct {
+    u64 nontchar;
+    u64 badval;
+    u64 lf;
+    u64 cr;
+} block_word_t;
+
+static void classify_word_scalar(const char *p, bool obs_text, block_word_t *w) {
+    *w = (block_word_t){ 0 };
+    for (unsigned i = 0; i < 64; i++) {
+        u8 c = (u8)p[i];
+        u64 bit = 1ull << i;
+        if (!h11_tchar_table[c])
+            w->nontchar |= bit;
+        if (!h11_vchar_table[c] || (c >= 0x80 && !obs_text))
+            w->badval |= bit;
+        if (c == '\n')
+            w->lf |= bit;
+        else if (c == '\r')
+            w->cr |= bit;
+    }
+}
+
+/* A CR hit at the last byte of a block is verified against the next block;
+ * a CR at the very end of the input is never a match. */
+H11_INLINE bool crlf_at(const char *data, usize len, usize i) {
+    return i + 1 < len && h11_is_lf(data[i + 1]);
+}
+
+#if H11_X86
+
+/* ---- tails ----
+ *
+ * No variant finishes with a byte loop. AVX-512 levels use fault-suppressing
+ * masked loads. SSE4.2 and AVX2 use one full-width load for the last partial
+ * block, which may read past either end of [data, data + len) but never
+ * leaves a 4 KiB page that holds at least one input byte:
+ *   - if a load at the tail start stays within its page, it is used as is;
+ *   - otherwise the load is moved back to end at data + len. The tail start
+ *     then sits in the last W bytes of its page, so the moved load begins in
+ *     that same page.
+ * Lanes outside the input are masked off, so over-read bytes never match.
+ * These loads are deliberate over-reads, so the functions opt out of
+ * AddressSanitizer. */
+
+#define H11_PAGE_SIZE 4096u
+
+#if defined(__SANITIZE_ADDRESS__)
+#define H11_NO_ASAN __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define H11_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef H11_NO_ASAN
+#define H11_NO_ASAN
+#endif
+
+H11_INLINE bool crosses_page(const char *p, usize width) {
+    return ((uintptr_t)p & (H11_PAGE_SIZE - 1)) > H11_PAGE_SIZE - width;
+}
+
+/* Start of the width-byte window that covers the rem (< width) bytes at p;
+ * lane k of the window holds p[k - *shift]. */
+H11_INLINE const char *tail_window(const char *p, usize rem, usize width, unsigned *shift) {
+    if (!crosses_page(p, width)) {
+        *shift = 0;
+        return p;
+    }
+    *shift = (unsigned)(width - rem);
+    return p - *shift;
+}
+
+H11_INLINE unsigned tail_bits(unsigned m, unsigned shift, usize rem) {
+    return (m >> shift) & ((1u << rem) - 1);
+}
+
+/* ---- SSE4.2 ---- */
+
+#define H11_SSE42 H11_NO_ASAN H11_TARGET("sse4.2")
+
+H11_SSE42
+static usize find_char_sse42(const char *data, usize len, char c) {
+    const __m128i vc = _mm_set1_epi8(c);
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vc));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 16, &sh);
+        __m128i d = _mm_loadu_si128((const __m128i *)w);
+        unsigned m = tail_bits((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vc)), sh, len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_SSE42
+static usize find_char2_sse42(const char *data, usize len, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(d, va), _mm_cmpeq_epi8(d, vb));
+        unsigned m = (unsigned)_mm_movemask_epi8(eq);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 16, &sh);
+        __m128i d = _mm_loadu_si128((const __m128i *)w);
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(d, va), _mm_cmpeq_epi8(d, vb));
+        unsigned m = tail_bits((unsigned)_mm_movemask_epi8(eq), sh, len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_SSE42
+static usize find_crlf_sse42(const char *data, usize len) {
+    const __m128i vcr = _mm_set1_epi8('\r');
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vcr));
+        while (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 16, &sh);
+        __m128i d = _mm_loadu_si128((const __m128i *)w);
+        unsigned m = tail_bits((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vcr)), sh, len - i);
+        while (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    return len;
+}
+
+/* ---- AVX2 ---- */
+
+#define H11_AVX2 H11_NO_ASAN H11_TARGET("avx2")
+
+H11_AVX2
+static usize find_char_avx2(const char *data, usize len, char c) {
+    const __m256i vc = _mm256_set1_epi8(c);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vc));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 32, &sh);
+        __m256i d = _mm256_loadu_si256((const __m256i *)w);
+        unsigned m = tail_bits((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vc)), sh,
+                               len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX2
+static usize find_char2_avx2(const char *data, usize len, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(d, va), _mm256_cmpeq_epi8(d, vb));
+        unsigned m = (unsigned)_mm256_movemask_epi8(eq);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 32, &sh);
+        __m256i d = _mm256_loadu_si256((const __m256i *)w);
+        __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(d, va), _mm256_cmpeq_epi8(d, vb));
+        unsigned m = tail_bits((unsigned)_mm256_movemask_epi8(eq), sh, len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX2
+static usize find_crlf_avx2(const char *data, usize len) {
+    const __m256i vcr = _mm256_set1_epi8('\r');
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vcr));
+        while (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 32, &sh);
+        __m256i d = _mm256_loadu_si256((const __m256i *)w);
+        unsigned m = tail_bits((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vcr)), sh,
+                               len - i);
+        while (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    return len;
+}
+
+/* ---- AVX-512VL: AVX-512BW on 256-bit registers ----
+ *
+ * EVEX compares write k-masks directly (no movemask), and the tail is a
+ * fault-suppressing masked load instead of a fall-through to narrower code.
+ * Staying on ymm avoids the 512-bit frequency licence, which otherwise slows
+ * whatever else (TLS, compression) shares the core. */
+
+#define H11_AVX512VL H11_TARGET("avx512f,avx512bw,avx512vl")
+
+H11_INLINE H11_AVX512VL __m256i load256_tail(const char *p, usize n) {
+    return _mm256_maskz_loadu_epi8((__mmask32)((1ull << n) - 1), p);
+}
+
+H11_AVX512VL
+static usize find_char_avx512vl(const char *data, usize len, char c) {
+    const __m256i vc = _mm256_set1_epi8(c);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __mmask32 m = _mm256_cmpeq_epi8_mask(_mm256_loadu_si256((const __m256i *)(data + i)), vc);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        __mmask32 valid = (__mmask32)((1ull << (len - i)) - 1);
+        __mmask32 m = _mm256_mask_cmpeq_epi8_mask(valid, load256_tail(data + i, len - i), vc);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX512VL
+static usize find_char2_avx512vl(const char *data, usize len, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        __mmask32 m = _mm256_cmpeq_epi8_mask(d, va) | _mm256_cmpeq_epi8_mask(d, vb);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        __mmask32 valid = (__mmask32)((1ull << (len - i)) - 1);
+        __m256i d = load256_tail(data + i, len - i);
+        __mmask32 m = _mm256_mask_cmpeq_epi8_mask(valid, d, va) |
+                      _mm256_mask_cmpeq_epi8_mask(valid, d, vb);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+/* CR lanes whose LF is in the same block are matched by mask arithmetic; a
+ * CR in the last lane is checked against the next byte. */
+H11_AVX512VL
+static usize find_crlf_avx512vl(const char *data, usize len) {
+    const __m256i vcr = _mm256_set1_epi8('\r');
+    const __m256i vlf = _mm256_set1_epi8('\n');
+    for (usize i = 0; i < len; i += 32) {
+        usize n = len - i < 32 ? len - i : 32;
+        __m256i d = n == 32 ? _mm256_loadu_si256((const __m256i *)(data + i))
+                            : load256_tail(data + i, n);
+        u32 cr = _mm256_cmpeq_epi8_mask(d, vcr);
+        u32 lf = _mm256_cmpeq_epi8_mask(d, vlf);
+        u32 m = cr & ((lf >> 1) | 0x80000000u);
+        while (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    return len;
+}
+
+/* ---- AVX-512BW ---- */
+
+#define H11_AVX512 H11_TARGET("avx512f,avx512bw")
+
+H11_INLINE H11_AVX512 __m512i load512_tail(const char *p, usize n) {
+    return _mm512_maskz_loadu_epi8((__mmask64)((1ull << n) - 1), p);
+}
+
+H11_AVX512
+static usize find_char_avx512(const char *data, usize len, char c) {
+    const __m512i vc = _mm512_set1_epi8(c);
+    usize i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 m = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(data + i)), vc);
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    if (i < len) {
+        __mmask64 valid = (__mmask64)((1ull << (len - i)) - 1);
+        __mmask64 m = _mm512_mask_cmpeq_epi8_mask(valid, load512_tail(data + i, len - i), vc);
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    return len;
+}
+
+H11_AVX512
+static usize find_char2_avx512(const char *data, usize len, char a, char b) {
+    const __m512i va = _mm512_set1_epi8(a);
+    const __m512i vb = _mm512_set1_epi8(b);
+    usize i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i d = _mm512_loadu_si512((const void *)(data + i));
+        __mmask64 m = _mm512_cmpeq_epi8_mask(d, va) | _mm512_cmpeq_epi8_mask(d, vb);
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    if (i < len) {
+        __mmask64 valid = (__mmask64)((1ull << (len - i)) - 1);
+        __m512i d = load512_tail(data + i, len - i);
+        __mmask64 m = _mm512_mask_cmpeq_epi8_mask(valid, d, va) |
+                      _mm512_mask_cmpeq_epi8_mask(valid, d, vb);
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    return len;
+}
+
+H11_AVX512
+static usize find_crlf_avx512(const char *data, usize len) {
+    const __m512i vcr = _mm512_set1_epi8('\r');
+    const __m512i vlf = _mm512_set1_epi8('\n');
+    for (usize i = 0; i < len; i += 64) {
+        usize n = len - i < 64 ? len - i : 64;
+        __m512i d = n == 64 ? _mm512_loadu_si512((const void *)(data + i))
+                            : load512_tail(data + i, n);
+        u64 cr = _mm512_cmpeq_epi8_mask(d, vcr);
+        u64 lf = _mm512_cmpeq_epi8_mask(d, vlf);
+        u64 m = cr & ((lf >> 1) | 0x8000000000000000ull);
+        while (m) {
+            usize pos = i + (usize)__builtin_ctzll(m);
+            if (crlf_at(data, len, pos))
+                return pos;
+            m &= m - 1;
+        }
+    }
+    return len;
+}
+
+/* ---- padded input ----
+ *
+ * Under H11_CFG_PADDED_INPUT the caller guarantees H11_INPUT_PADDING
+ * readable bytes past len, so every block is one unconditional full-width
+ * load and a hit at or past len just means "not found". AVX-512VL hosts use
+ * the AVX2 loops: they are also 256-bit and need no tail masks here. */
+
+H11_SSE42
+static usize find_char_padded_sse42(const char *data, usize len, char c) {
+    const __m128i vc = _mm_set1_epi8(c);
+    for (usize i = 0; i < len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vc));
+        if (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            return pos < len ? pos : len;
+        }
+    }
+    return len;
+}
+
+H11_AVX2
+static usize find_char_padded_avx2(const char *data, usize len, char c) {
+    const __m256i vc = _mm256_set1_epi8(c);
+    for (usize i = 0; i < len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vc));
+        if (m) {
+            usize pos = i + (usize)__builtin_ctz(m);
+            return pos < len ? pos : len;
+        }
+    }
+    return len;
+}
+
+H11_NO_ASAN H11_AVX512
+static usize find_char_padded_avx512(const char *data, usize len, char c) {
+    const __m512i vc = _mm512_set1_epi8(c);
+    for (usize i = 0; i < len; i += 64) {
+        __mmask64 m = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(data + i)), vc);
+        if (m) {
+            usize pos = i + (usize)__builtin_ctzll(m);
+            return pos < len ? pos : len;
+        }
+    }
+    return len;
+}
+
+/* Candidates arrive in increasing order, so the first CR whose LF would sit
+ * at or past len ends the search. */
+H11_INLINE usize padded_crlf_hit(const char *data, usize len, usize pos, bool *done) {
+    if (pos + 1 >= len) {
+        *done = true;
+        return len;
+    }
+    *done = h11_is_lf(data[pos + 1]);
+    return pos;
+}
+
+H11_SSE42
+static usize find_crlf_padded_sse42(const char *data, usize len) {
+    const __m128i vcr = _mm_set1_epi8('\r');
+    for (usize i = 0; i < len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, vcr));
+        for (; m; m &= m - 1) {
+            bool done;
+            usize pos = padded_crlf_hit(data, len, i + (usize)__builtin_ctz(m), &done);
+            if (done)
+                return pos;
+        }
+    }
+    return len;
+}
+
+H11_AVX2
+static usize find_crlf_padded_avx2(const char *data, usize len) {
+    const __m256i vcr = _mm256_set1_epi8('\r');
+    for (usize i = 0; i < len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, vcr));
+        for (; m; m &= m - 1) {
+            bool done;
+            usize pos = padded_crlf_hit(data, len, i + (usize)__builtin_ctz(m), &done);
+            if (done)
+                return pos;
+        }
+    }
+    return len;
+}
+
+H11_NO_ASAN H11_AVX512
+static usize find_crlf_padded_avx512(const char *data, usize len) {
+    const __m512i vcr = _mm512_set1_epi8('\r');
+    const __m512i vlf = _mm512_set1_epi8('\n');
+    for (usize i = 0; i < len; i += 64) {
+        __m512i d = _mm512_loadu_si512((const void *)(data + i));
+        u64 cr = _mm512_cmpeq_epi8_mask(d, vcr);
+        u64 lf = _mm512_cmpeq_epi8_mask(d, vlf);
+        for (u64 m = cr & ((lf >> 1) | 0x8000000000000000ull); m; m &= m - 1) {
+            bool done;
+            usize pos = padded_crlf_hit(data, len, i + (usize)__builtin_ctzll(m), &done);
+            if (done)
+                return pos;
+        }
+    }
+    return len;
+}
+
+/* ---- header-block classification ----
+ *
+ * tchar membership is a nibble lookup: lo_tbl[c & 15] holds one bit per
+ * high nibble 0..7 whose byte with that low nibble is a tchar, hi_tbl maps
+ * the high nibble to that bit (0 for bytes >= 0x80, never a tchar). */
+
+#define H11_TCHAR_LO 0xE8, 0xFC, 0xF8, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, \
+                     0xF8, 0xF8, 0xF4, 0x54, 0xD0, 0x54, 0xF4, 0x70
+#define H11_TCHAR_HI 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, \
+                     0, 0, 0, 0, 0, 0, 0, 0
+
+/* Repeated per 128-bit lane, as pshufb looks up within each lane. */
+static const u8 tchar_lo_tbl[32] __attribute__((aligned(32))) = { H11_TCHAR_LO, H11_TCHAR_LO };
+static const u8 tchar_hi_tbl[32] __attribute__((aligned(32))) = { H11_TCHAR_HI, H11_TCHAR_HI };
+
+H11_SSE42
+static void classify_word_sse42(const char *p, bool obs_text, block_word_t *w) {
+    const __m128i lo_tbl = _mm_load_si128((const __m128i *)tchar_lo_tbl);
+    const __m128i hi_tbl = _mm_load_si128((const __m128i *)tchar_hi_tbl);
+    const __m128i nib = _mm_set1_epi8(0x0F);
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    const __m128i zero = _mm_setzero_si128();
+    *w = (block_word_t){ 0 };
+    for (unsigned k = 0; k < 64; k += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(p + k));
+        __m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(d, nib));
+        __m128i hi = _mm_shuffle_epi8(hi_tbl, _mm_and_si128(_mm_srli_epi16(d, 4), nib));
+        __m128i nt = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero);
+        __m128i bad = _mm_andnot_si128(_mm_cmpeq_epi8(d, _mm_set1_epi8('\t')),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(d, ctl), ctl));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(d, _mm_set1_epi8(0x7F)));
+        unsigned high = obs_text ? 0 : (unsigned)_mm_movemask_epi8(d);
+        w->nontchar |= (u64)(unsigned)_mm_movemask_epi8(nt) << k;
+        w->badval |= (u64)((unsigned)_mm_movemask_epi8(bad) | high) << k;
+        w->lf |= (u64)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_set1_epi8('\n'))) << k;
+        w->cr |= (u64)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_set1_epi8('\r'))) << k;
+    }
+}
+
+H11_AVX2
+static void classify_word_avx2(const char *p, bool obs_text, block_word_t *w) {
+    const __m256i lo_tbl = _mm256_load_si256((const __m256i *)tchar_lo_tbl);
+    const __m256i hi_tbl = _mm256_load_si256((const __m256i *)tchar_hi_tbl);
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    const __m256i zero = _mm256_setzero_si256();
+    *w = (block_word_t){ 0 };
+    for (unsigned k = 0; k < 64; k += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(p + k));
+        __m256i lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(d, nib));
+        __m256i hi = _mm256_shuffle_epi8(hi_tbl, _mm256_and_si256(_mm256_srli_epi16(d, 4), nib));
+        __m256i nt = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero);
+        __m256i bad = _mm256_andnot_si256(_mm256_cmpeq_epi8(d, _mm256_set1_epi8('\t')),
+                                          _mm256_cmpeq_epi8(_mm256_max_epu8(d, ctl), ctl));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(d, _mm256_set1_epi8(0x7F)));
+        u32 high = obs_text ? 0 : (u32)_mm256_movemask_epi8(d);
+        w->nontchar |= (u64)(u32)_mm256_movemask_epi8(nt) << k;
+        w->badval |= (u64)((u32)_mm256_movemask_epi8(bad) | high) << k;
+        w->lf |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, _mm256_set1_epi8('\n'))) << k;
+        w->cr |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, _mm256_set1_epi8('\r'))) << k;
+    }
+}
+
+/* ---- non-ASCII scan and WebSocket masking ----
+ *
+ * find_nonascii follows the find_char tail rules. The mask kernels XOR a
+ * broadcast 32-bit key; every block is a multiple of 4 bytes, so the key
+ * phase never shifts. SSE4.2/AVX2 finish in scalar code (stores cannot
+ * over-run), AVX-512 with one masked load and store. */
+
+H11_SSE42
+static usize find_nonascii_sse42(const char *data, usize len) {
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(data + i)));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 16, &sh);
+        unsigned m = tail_bits((unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)w)),
+                               sh, len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX2
+static usize find_nonascii_avx2(const char *data, usize len) {
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        unsigned m =
+            (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        unsigned sh;
+        const char *w = tail_window(data + i, len - i, 32, &sh);
+        unsigned m = tail_bits(
+            (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)w)), sh, len - i);
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX512VL
+static usize find_nonascii_avx512vl(const char *data, usize len) {
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __mmask32 m = _mm256_movepi8_mask(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    if (i < len) {
+        __mmask32 m = _mm256_movepi8_mask(load256_tail(data + i, len - i));
+        if (m)
+            return i + (usize)__builtin_ctz(m);
+    }
+    return len;
+}
+
+H11_AVX512
+static usize find_nonascii_avx512(const char *data, usize len) {
+    usize i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 m = _mm512_movepi8_mask(_mm512_loadu_si512((const void *)(data + i)));
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    if (i < len) {
+        __mmask64 m = _mm512_movepi8_mask(load512_tail(data + i, len - i));
+        if (m)
+            return i + (usize)__builtin_ctzll(m);
+    }
+    return len;
+}
+
+H11_TARGET("sse4.2")
+static void mask_xor_sse42(char *data, usize len, u32 key) {
+    const __m128i k = _mm_set1_epi32((int)key);
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i *p = (__m128i *)(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), k));
+    }
+    mask_xor_scalar(data + i, len - i, key);
+}
+
+H11_TARGET("avx2")
+static void mask_xor_avx2(char *data, usize len, u32 key) {
+    const __m256i k = _mm256_set1_epi32((int)key);
+    usize i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i *p = (__m256i *)(data + i);
+        __m256i a = _mm256_loadu_si256(p), b = _mm256_loadu_si256(p + 1);
+        _mm256_storeu_si256(p, _mm256_xor_si256(a, k));
+        _mm256_storeu_si256(p + 1, _mm256_xor_si256(b, k));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i *p = (__m256i *)(data + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), k));
+    }
+    mask_xor_scalar(data + i, len - i, key);
+}
+
+H11_AVX512VL
+static void mask_xor_avx512vl(char *data, usize len, u32 key) {
+    const __m256i k = _mm256_set1_epi32((int)key);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i *p = (__m256i *)(data + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), k));
+    }
+    if (i < len) {
+        __mmask32 m = (__mmask32)((1ull << (len - i)) - 1);
+        __m256i d = _mm256_maskz_loadu_epi8(m, data + i);
+        _mm256_mask_storeu_epi8(data + i, m, _mm256_xor_si256(d, k));
+    }
+}
+
+H11_AVX512
+static void mask_xor_avx512(char *data, usize len, u32 key) {
+    const __m512i k = _mm512_set1_epi32((int)key);
+    usize i = 0;
+    for (; i + 64 <= len; i += 64) {
+        void *p = data + i;
+        _mm512_storeu_si512(p, _mm512_xor_si512(_mm512_loadu_si512(p), k));
+    }
+    if (i < len) {
+        __mmask64 m = (__mmask64)((1ull << (len - i)) - 1);
+        __m512i d = _mm512_maskz_loadu_epi8(m, data + i);
+        _mm512_mask_storeu_epi8(data + i, m, _mm512_xor_si512(d, k));
+    }
+}
+
+#endif /* H11_X86 */
+
+/* ---- dispatch ---- */
+
+usize h11_find_char(const char *data, usize len, char target) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_char_avx512(data, len, target);
+    case H11_SIMD_AVX512VL: return find_char_avx512vl(data, len, target);
+    case H11_SIMD_AVX2:     return find_char_avx2(data, len, target);
+    case H11_SIMD_SSE42:    return find_char_sse42(data, len, target);
+#endif
+    default:                return find_char_scalar(data, len, target);
+    }
+}
+
+usize h11_find_char2(const char *data, usize len, char a, char b) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_char2_avx512(data, len, a, b);
+    case H11_SIMD_AVX512VL: return find_char2_avx512vl(data, len, a, b);
+    case H11_SIMD_AVX2:     return find_char2_avx2(data, len, a, b);
+    case H11_SIMD_SSE42:    return find_char2_sse42(data, len, a, b);
+#endif
+    default:                return find_char2_scalar(data, len, a, b);
+    }
+}
+
+usize h11_find_char_padded(const char *data, usize len, char target) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_char_padded_avx512(data, len, target);
+    case H11_SIMD_AVX512VL:
+    case H11_SIMD_AVX2:     return find_char_padded_avx2(data, len, target);
+    case H11_SIMD_SSE42:    return find_char_padded_sse42(data, len, target);
+#endif
+    default:                return find_char_scalar(data, len, target);
+    }
+}
+
+usize h11_find_crlf_padded(const char *data, usize len) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_crlf_padded_avx512(data, len);
+    case H11_SIMD_AVX512VL:
+    case H11_SIMD_AVX2:     return find_crlf_padded_avx2(data, len);
+    case H11_SIMD_SSE42:    return find_crlf_padded_sse42(data, len);
+#endif
+    default:                return find_crlf_scalar(data, len);
+    }
+}
+
+usize h11_find_crlf(const char *data, usize len) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_crlf_avx512(data, len);
+    case H11_SIMD_AVX512VL: return find_crlf_avx512vl(data, len);
+    case H11_SIMD_AVX2:     return find_crlf_avx2(data, len);
+    case H11_SIMD_SSE42:    return find_crlf_sse42(data, len);
+#endif
+    default:                return find_crlf_scalar(data, len);
+    }
+}
+
+usize h11_find_nonascii(const char *data, usize len) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   return find_nonascii_avx512(data, len);
+    case H11_SIMD_AVX512VL: return find_nonascii_avx512vl(data, len);
+    case H11_SIMD_AVX2:     return find_nonascii_avx2(data, len);
+    case H11_SIMD_SSE42:    return find_nonascii_sse42(data, len);
+#endif
+    default:                return find_nonascii_scalar(data, len);
+    }
+}
+
+void h11_mask_xor(char *data, usize len, u32 key) {
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:   mask_xor_avx512(data, len, key); break;
+    case H11_SIMD_AVX512VL: mask_xor_avx512vl(data, len, key); break;
+    case H11_SIMD_AVX2:     mask_xor_avx2(data, len, key); break;
+    case H11_SIMD_SSE42:    mask_xor_sse42(data, len, key); break;
+#endif
+    default:                mask_xor_scalar(data, len, key); break;
+    }
+}
+
+/* Word by word; the partial last word is classified from a zeroed copy and
+ * its lanes past len are cleared. A CR in the top lane of one word pairs
+ * with an LF in the bottom lane of the next. */
+void h11_classify_block(const char *data, usize len, bool strict_crlf, bool obs_text,
+                        u64 *nontchar, u64 *badval, u64 *eol) {
+    void (*word)(const char *, bool, block_word_t *) = classify_word_scalar;
+    switch (h11_simd_level) {
+#if H11_X86
+    case H11_SIMD_AVX512:
+    case H11_SIMD_AVX512VL:
+    case H11_SIMD_AVX2:     word = classify_word_avx2; break;
+    case H11_SIMD_SSE42:    word = classify_word_sse42; break;
+#endif
+    default:                break;
+    }
+    u64 carry = 0;
+    for (usize i = 0, k = 0; i < len; i += 64, k++) {
+        block_word_t w;
+        if (len - i >= 64) {
+            word(data + i, obs_text, &w);
+        } else {
+            char tail[64] = { 0 };
+            memcpy(tail, data + i, len - i);
+            word(tail, obs_text, &w);
+            u64 valid = (1ull << (len - i)) - 1;
+            w.nontchar &= valid;
+            w.badval &= valid;
+            w.lf &= valid;
+            w.cr &= valid;
+        }
+        nontchar[k] = w.nontchar;
+        badval[k] = w.badval;
+        eol[k] = strict_crlf ? w.lf & ((w.cr << 1) | carry) : w.lf;
+        carry = w.cr >> 63;
+    }
+}
+
+/* ---- calibration ---- */
+
+#define CALIB_ROUNDS 7
+#define CALIB_PASSES 4
+
+static char calib_block[2048];
+static usize calib_len;
+
+/* A header block of mixed line lengths, like the ones the parser walks. */
+static void calib_fill(void) {
+    static const char *const lines[] = {
+        "Host: www.example.com\r\n",
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 Firefox/120.0\r\n",
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n",
+        "Accept-Encoding: gzip, deflate, br\r\n",
+        "Cookie: session=3f2a9c81d7e04b6a; theme=dark; lang=en-US; cart=17\r\n",
+        "X-Request-Id: 5b0d8a4e-7c1f-4d52-9a36-0e8f2b1c4d77\r\n",
+    };
+    usize n = 0;
+    for (unsigned i = 0;; i++) {
+        const char *l = lines[i % H11_ARRAY_LEN(lines)];
+        usize len = strlen(l);
+        if (n + len + 2 > sizeof(calib_block))
+            break;
+        memcpy(calib_block + n, l, len);
+        n += len;
+    }
+    memcpy(calib_block + n, "\r\n", 2);
+    calib_len = n + 2;
+}
+
+static usize calib_pass(const char *b, usize len) {
+    usize sum = 0, pos = 0;
+    while (pos < len) {
+        usize eol = pos + h11_find_crlf(b + pos, len - pos);
+        sum += h11_find_char(b + pos, eol - pos, ':');
+        pos = eol + 2;
+    }
+    return sum;
+}
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000u + (u64)ts.tv_nsec;
+}
+
+/* Best-of-CALIB_ROUNDS time for CALIB_PASSES walks of the block. */
+static u64 calib_measure(void) {
+    volatile usize sink = calib_pass(calib_block, calib_len);
+    u64 best = UINT64_MAX;
+    for (int r = 0; r < CALIB_ROUNDS; r++) {
+        u64 t0 = now_ns();
+        for (int k = 0; k < CALIB_PASSES; k++)
+            sink += calib_pass(calib_block, calib_len);
+        u64 dt = now_ns() - t0;
+        if (dt < best)
+            best = dt;
+    }
+    (void)sink;
+    return best > 0 ? best : 1;
+}
+
+/* Wider is not always faster (AVX-512 frequency licences, slow unaligned
+ * splits on older cores), so every supported level is timed. A lower level
+ * must win by more than 5% to displace a higher one; smaller gaps are
+ * treated as noise. */
+h11_simd_level_t h11_simd_calibrate(h11_simd_calibration_t *out) {
+    h11_simd_calibration_t c;
+    memset(&c, 0, sizeof(c));
+    c.supported = h11_simd_supported();
+    if (calib_len == 0)
+        calib_fill();
+    u64 ns[H11_SIMD_AVX512 + 1];
+    u64 start = now_ns();
+    for (int lv = (int)c.supported; lv >= H11_SIMD_SCALAR; lv--) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        ns[lv] = calib_measure();
+        c.mb_per_s[lv] = (u32)((u64)calib_len * CALIB_PASSES * 1000u / ns[lv]);
+    }
+    c.elapsed_ns = now_ns() - start;
+    c.chosen = c.supported;
+    for (int lv = (int)c.supported - 1; lv >= H11_SIMD_SCALAR; lv--) {
+        if (ns[lv] * 100 < ns[c.chosen] * 95)
+            c.chosen = (h11_simd_level_t)lv;
+    }
+    h11_simd_level = c.chosen;
+    h11_initialized = true;
+    h11_calibration = c;
+    h11_calibrated = true;
+    if (out != NULL)
+        *out = c;
+    return c.chosen;
+}
+
+bool h11_simd_calibration(h11_simd_calibration_t *out) {
+    if (!h11_calibrated || out == NULL)
+        return false;
+    *out = h11_calibration;
+    return true;
+}
@@ -0,0 +1,117 @@
+/*
+ * test_cookie.c — Tests for Cookie header lookup and iteration
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define SPAN_IS(base, s, lit) \
+    ((s).len == strlen(lit) && memcmp((base) + (s).off, (lit), (s).len) == 0)
+
+static h11_header_t value_header(const char *base, const char *value) {
+    const char *v = strstr(base, value);
+    return (h11_header_t){ .value = { .off = (u32)(v - base), .len = (u32)strlen(value) } };
+}
+
+static void test_cookie_find_sample(void) {
+    TEST(cookie_find_sample_request);
+    const char base[] = "session_id=abc123def456; user_pref=dark_mode; tracking_id=xyz789";
+    h11_header_t h = value_header(base, base);
+    h11_span_t v;
+    ASSERT(h11_cookie_find(base, &h, "session_id", &v) && SPAN_IS(base, v, "abc123def456"));
+    ASSERT(h11_cookie_find(base, &h, "user_pref", &v) && SPAN_IS(base, v, "dark_mode"));
+    ASSERT(h11_cookie_find(base, &h, "tracking_id", &v) && SPAN_IS(base, v, "xyz789"));
+    ASSERT(!h11_cookie_find(base, &h, "session", &v));
+    ASSERT(!h11_cookie_find(base, &h, "Session_id", &v));
+    ASSERT(!h11_cookie_find(base, &h, "", &v));
+    PASS();
+}
+
+static void test_cookie_find_prefilter_traps(void) {
+    TEST(cookie_find_prefix_and_value_traps);
+    const char base[] = "sid2=x; a=sid=evil; sid=\"quoted\"; tail=t=t";
+    h11_header_t h = value_header(base, base);
+    h11_span_t v;
+    ASSERT(h11_cookie_find(base, &h, "sid", &v) && SPAN_IS(base, v, "quoted"));
+    ASSERT(h11_cookie_find(base, &h, "tail", &v) && SPAN_IS(base, v, "t=t"));
+    ASSERT(h11_cookie_find(base, &h, "a", &v) && SPAN_IS(base, v, "sid=evil"));
+    PASS();
+}
+
+static void test_cookie_next_all(void) {
+    TEST(cookie_next_iterates_all);
+    const char base[] = "Cookie: a=1;b=2 ;  ; flag; c=\"\"";
+    h11_header_t h = value_header(base, "a=1;b=2 ;  ; flag; c=\"\"");
+    h11_span_t n, v;
+    u32 pos = 0;
+    ASSERT(h11_cookie_next(base, &h, &pos, &n, &v) && SPAN_IS(base, n, "a") && SPAN_IS(base, v, "1"));
+    ASSERT(h11_cookie_next(base, &h, &pos, &n, &v) && SPAN_IS(base, n, "b") && SPAN_IS(base, v, "2"));
+    ASSERT(h11_cookie_next(base, &h, &pos, &n, &v) && SPAN_IS(base, n, "flag") && v.len == 0);
+    ASSERT(h11_cookie_next(base, &h, &pos, &n, &v) && SPAN_IS(base, n, "c") && v.len == 0);
+    ASSERT(!h11_cookie_next(base, &h, &pos, &n, &v));
+    PASS();
+}
+
+static void test_request_cookie_repeated_fields(void) {
+    TEST(request_cookie_across_repeated_fields);
+    const char base[] =
+        "Cookie\0a=1; b=2\0"
+        "Accept\0text/html\0"
+        "cookie\0session=s3cr3t\0";
+    h11_header_t hdrs[3] = {
+        { .name = { 0, 6 },  .value = { 7, 8 },   .name_id = H11_INDEX_NONE },
+        { .name = { 16, 6 }, .value = { 23, 9 },  .name_id = H11_INDEX_NONE },
+        { .name = { 33, 6 }, .value = { 40, 14 }, .name_id = H11_INDEX_NONE },
+    };
+    h11_request_t req = { .headers = hdrs, .header_count = 3 };
+    h11_span_t v;
+    ASSERT(h11_request_cookie(&req, base, "b", &v) && SPAN_IS(base, v, "2"));
+    ASSERT(h11_request_cookie(&req, base, "session", &v) && SPAN_IS(base, v, "s3cr3t"));
+    ASSERT(!h11_request_cookie(&req, base, "text/html", &v));
+    PASS();
+}
+
+static void test_cookie_large_header(void) {
+    TEST(cookie_find_in_large_header);
+    static char base[8192];
+    usize o = 0;
+    for (int i = 0; i < 300; i++)
+        o += (usize)snprintf(base + o, sizeof(base) - o, "c%03d=v%03d; ", i, i);
+    o += (usize)snprintf(base + o, sizeof(base) - o, "session=last");
+    h11_header_t h = { .value = { 0, (u32)o } };
+    h11_span_t v;
+    ASSERT(h11_cookie_find(base, &h, "session", &v) && SPAN_IS(base, v, "last"));
+    ASSERT(h11_cookie_find(base, &h, "c150", &v) && SPAN_IS(base, v, "v150"));
+    PASS();
+}
+
+int main(void) {
+    h11_init();
+
+    printf("=== cookie_find ===\n");
+    test_cookie_find_sample();
+    test_cookie_find_prefilter_traps();
+    test_cookie_large_header();
+
+    printf("=== cookie_next ===\n");
+    test_cookie_next_all();
+
+    printf("=== request_cookie ===\n");
+    test_request_cookie_repeated_fields();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
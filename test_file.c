@@ -0,0 +1,400 @@
+/*
+ * test_file.c — Tests for the static file cache, replies and sendfile path
+ */
+#define _GNU_SOURCE
+#include "h11_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define BIG_LEN (300 * 1024 + 5)
+
+static char root[] = "/tmp/h11_test_file_XXXXXX";
+static char big[BIG_LEN];
+static h11_parser_t *parser;
+
+static bool put_file(const char *name, const char *data, usize len) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+static bool has(const char *head, usize len, const char *needle) {
+    return memmem(head, len, needle, strlen(needle)) != NULL;
+}
+
+static const h11_request_t *request(const char *raw) {
+    usize used = 0;
+    h11_parser_reset(parser);
+    if (h11_parse(parser, raw, strlen(raw), &used) != H11_OK)
+        return NULL;
+    return h11_get_request(parser);
+}
+
+static void test_cache(void) {
+    TEST(file_cache_open_and_reuse);
+    h11_file_cache_t *c = h11_file_cache_new(root, 4);
+    ASSERT(c != NULL);
+    const h11_file_t *f = h11_file_open(c, "/small.txt", 10);
+    ASSERT(f != NULL && f->size == 5 && f->data != NULL && memcmp(f->data, "hello", 5) == 0);
+    ASSERT(h11_file_open(c, "/small.txt", 10) == f);
+    ASSERT(has(f->head, f->head_len, "HTTP/1.1 200 OK\r\n"));
+    ASSERT(has(f->head, f->head_len, "Content-Type: text/plain; charset=utf-8\r\n"));
+    ASSERT(has(f->head, f->head_len, "Content-Length: 5\r\n\r\n"));
+    ASSERT(f->head[f->etag.off] == '"' && f->head[f->etag.off + f->etag.len - 1] == '"');
+    ASSERT(memcmp(f->head + f->last_modified.off + f->last_modified.len - 4, " GMT", 4) == 0);
+
+    const h11_file_t *b = h11_file_open(c, "/big.bin", 8);
+    ASSERT(b != NULL && b->size == BIG_LEN && b->data == NULL);
+    ASSERT(has(b->head, b->head_len, "application/octet-stream"));
+    const h11_file_t *idx = h11_file_open(c, "/d/", 3);
+    ASSERT(idx != NULL && has(idx->head, idx->head_len, "text/html"));
+
+    errno = 0;
+    ASSERT(h11_file_open(c, "/d", 2) == NULL && errno == EISDIR);
+    ASSERT(h11_file_open(c, "/missing", 8) == NULL && errno == ENOENT);
+    const char *bad[] = { "small.txt", "/../etc/passwd", "/d/../small.txt", "/./small.txt",
+                          "/d/..", "/a\\b", "//etc/passwd", "/a//b", "//", "/d//" };
+    for (usize i = 0; i < H11_ARRAY_LEN(bad); i++) {
+        errno = 0;
+        ASSERT(h11_file_open(c, bad[i], strlen(bad[i])) == NULL && errno == EINVAL);
+    }
+    ASSERT(h11_file_open(c, "/small.txt\0x", 12) == NULL);
+    /* Symlinks may not lead out of the root, whatever their target. */
+    const char *up = strrchr(root, '/');
+    char esc[64];
+    int n = snprintf(esc, sizeof(esc), "/up%s/small.txt", up);
+    ASSERT(h11_file_open(c, "/out/etc/passwd", 15) == NULL);
+    ASSERT(h11_file_open(c, "/pw", 3) == NULL);
+    ASSERT(h11_file_open(c, esc, (usize)n) == NULL);
+
+    h11_file_release(f);
+    h11_file_release(f);
+    h11_file_release(b);
+    h11_file_release(idx);
+    h11_file_cache_free(c);
+    ASSERT(h11_file_cache_new("/nonexistent-h11-root", 4) == NULL);
+    PASS();
+}
+
+static bool drop_file(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    return unlink(path) == 0;
+}
+
+/* Once its file is unlinked, a path only opens while it is still cached. */
+static void test_decode(void) {
+    TEST(file_cache_percent_decodes_paths);
+    h11_file_cache_t *c = h11_file_cache_new(root, 4);
+    ASSERT(c != NULL && put_file("a b.txt", "spaced", 6) && put_file("a+b.txt", "plus", 4) &&
+           put_file("a%20b", "literal", 7));
+    const h11_file_t *sp = h11_file_open(c, "/a%20b.txt", 10);
+    ASSERT(sp != NULL && sp->size == 6 && memcmp(sp->data, "spaced", 6) == 0);
+    ASSERT(h11_file_open(c, "/a b.txt", 8) == sp);
+    /* '+' is an ordinary path character, not a space. */
+    const h11_file_t *plus = h11_file_open(c, "/a+b.txt", 8);
+    ASSERT(plus != NULL && plus->size == 4);
+    const h11_file_t *lit = h11_file_open(c, "/a%2520b", 8);
+    ASSERT(lit != NULL && lit->size == 7);
+    errno = 0;
+    ASSERT(h11_file_open(c, "/a%20b", 6) == NULL && errno == ENOENT);
+    const char *bad[] = { "/a%2Fb.txt", "/d%2findex.html", "/%00", "/%2e%2e/etc/passwd",
+                          "/d/%2E", "/%zz", "/%2", "/a%" };
+    for (usize i = 0; i < H11_ARRAY_LEN(bad); i++) {
+        errno = 0;
+        ASSERT(h11_file_open(c, bad[i], strlen(bad[i])) == NULL && errno == EINVAL);
+    }
+    h11_file_release(sp);
+    h11_file_release(sp);
+    h11_file_release(plus);
+    h11_file_release(lit);
+    h11_file_cache_free(c);
+    PASS();
+}
+
+static void test_evict(void) {
+    TEST(file_cache_evicts_oldest_keeps_held);
+    h11_file_cache_t *c = h11_file_cache_new(root, 2);
+    ASSERT(c != NULL && put_file("a.css", "a{}", 3) && put_file("b.js", "1", 1));
+    ASSERT(put_file("c.txt", "c", 1));
+    const h11_file_t *a = h11_file_open(c, "/a.css", 6);
+    const h11_file_t *b = h11_file_open(c, "/b.js", 5);
+    ASSERT(a != NULL && b != NULL && has(b->head, b->head_len, "text/javascript"));
+    h11_file_release(b);
+    ASSERT(drop_file("a.css") && drop_file("b.js"));
+    ASSERT(h11_file_open(c, "/b.js", 5) == b);
+    h11_file_release(b);
+    const h11_file_t *t = h11_file_open(c, "/c.txt", 6);
+    ASSERT(t != NULL);
+    errno = 0;
+    ASSERT(h11_file_open(c, "/a.css", 6) == NULL && errno == ENOENT);
+    ASSERT(h11_file_open(c, "/b.js", 5) == b);
+    h11_file_release(b);
+
+    /* Evicted while held: head, data and fd stay usable until released. */
+    struct stat st;
+    ASSERT(a->size == 3 && memcmp(a->data, "a{}", 3) == 0 && has(a->head, a->head_len, "css"));
+    ASSERT(fstat(a->fd, &st) == 0 && st.st_size == 3);
+    h11_file_release(a);
+    h11_file_cache_clear(c);
+    ASSERT(t->size == 1 && t->data[0] == 'c' && fstat(t->fd, &st) == 0);
+    h11_file_release(t);
+    h11_file_cache_free(c);
+
+    /* Eviction keeps every surviving entry reachable in the hash table. */
+    enum { FILES = 24, KEEP = 8 };
+    char name[16];
+    c = h11_file_cache_new(root, KEEP);
+    ASSERT(c != NULL);
+    for (int i = 0; i < FILES; i++) {
+        int n = snprintf(name, sizeof(name), "/n%d", i);
+        ASSERT(put_file(name + 1, name, (usize)n));
+        const h11_file_t *f = h11_file_open(c, name, (usize)n);
+        ASSERT(f != NULL && f->size == (u64)n);
+        h11_file_release(f);
+    }
+    for (int i = 0; i < FILES; i++) {
+        snprintf(name, sizeof(name), "/n%d", i);
+        ASSERT(drop_file(name + 1));
+    }
+    for (int i = 0; i < FILES; i++) {
+        int n = snprintf(name, sizeof(name), "/n%d", i);
+        const h11_file_t *f = h11_file_open(c, name, (usize)n);
+        ASSERT((f != NULL) == (i >= FILES - KEEP));
+        if (f != NULL)
+            ASSERT(memcmp(f->data, name, (usize)n) == 0);
+        h11_file_release(f);
+    }
+    h11_file_cache_free(c);
+    PASS();
+}
+
+static bool same_etag(const h11_file_t *a, const h11_file_t *b) {
+    return a->etag.len == b->etag.len &&
+           memcmp(a->head + a->etag.off, b->head + b->etag.off, a->etag.len) == 0;
+}
+
+static void test_recheck(void) {
+    TEST(file_cache_rechecks_changed_files);
+    char tmp[sizeof(root) + 16], dst[sizeof(root) + 16];
+    snprintf(tmp, sizeof(tmp), "%s/r2.tmp", root);
+    snprintf(dst, sizeof(dst), "%s/r2.txt", root);
+    h11_file_cache_t *c = h11_file_cache_new(root, 4);
+    ASSERT(c != NULL && put_file("r1.txt", "old", 3) && put_file("r2.txt", "two", 3) &&
+           put_file("r3.txt", "3", 1));
+    const h11_file_t *r1 = h11_file_open(c, "/r1.txt", 7);
+    const h11_file_t *r2 = h11_file_open(c, "/r2.txt", 7);
+    const h11_file_t *r3 = h11_file_open(c, "/r3.txt", 7);
+    ASSERT(r1 != NULL && r2 != NULL && r3 != NULL);
+    h11_file_release(r3);
+
+    /* Rewritten in place, replaced by rename, removed. */
+    ASSERT(put_file("r1.txt", "newer!", 6) && put_file("r2.tmp", "owt", 3) && rename(tmp, dst) == 0);
+    ASSERT(drop_file("r3.txt"));
+    /* Hits inside the recheck interval are served without a stat. */
+    ASSERT(h11_file_open(c, "/r1.txt", 7) == r1);
+    h11_file_release(r1);
+    nanosleep(&(struct timespec){ .tv_sec = 1, .tv_nsec = 100000000 }, NULL);
+
+    const h11_file_t *n1 = h11_file_open(c, "/r1.txt", 7);
+    ASSERT(n1 != NULL && n1 != r1 && n1->size == 6 && memcmp(n1->data, "newer!", 6) == 0);
+    ASSERT(has(n1->head, n1->head_len, "Content-Length: 6\r\n") && !same_etag(n1, r1));
+    const h11_file_t *n2 = h11_file_open(c, "/r2.txt", 7);
+    ASSERT(n2 != NULL && n2 != r2 && n2->size == 3 && memcmp(n2->data, "owt", 3) == 0);
+    errno = 0;
+    ASSERT(h11_file_open(c, "/r3.txt", 7) == NULL && errno == ENOENT);
+    ASSERT(h11_file_open(c, "/r1.txt", 7) == n1);
+    h11_file_release(n1);
+
+    /* The replaced entries stay intact for whoever still holds them. */
+    ASSERT(r1->size == 3 && memcmp(r1->data, "old", 3) == 0 && memcmp(r2->data, "two", 3) == 0);
+    h11_file_release(r1);
+    h11_file_release(r2);
+    h11_file_release(n1);
+    h11_file_release(n2);
+    h11_file_cache_free(c);
+    PASS();
+}
+
+static void test_reply(void) {
+    TEST(file_reply_status_and_head);
+    h11_file_cache_t *c = h11_file_cache_new(root, 16);
+    const h11_file_t *f = h11_file_open(c, "/big.bin", 8);
+    ASSERT(f != NULL);
+    h11_file_reply_t r;
+    const char *raw = "GET /big.bin HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 200 && r.head == f->head && r.len == BIG_LEN && r.data == NULL);
+
+    raw = "GET /big.bin HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 200 && r.head == r.buf && has(r.head, r.head_len, "Connection: close"));
+    ASSERT(has(r.head, r.head_len, "Content-Length: 307205\r\nConnection: close\r\n\r\n"));
+
+    raw = "HEAD /big.bin HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 200 && r.len == 0 && has(r.head, r.head_len, "keep-alive\r\n\r\n"));
+
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=100-199\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 206 && r.off == 100 && r.len == 100);
+    ASSERT(has(r.head, r.head_len, "HTTP/1.1 206 Partial Content\r\n"));
+    ASSERT(has(r.head, r.head_len, "Content-Range: bytes 100-199/307205\r\n"));
+    ASSERT(has(r.head, r.head_len, "Content-Length: 100\r\n\r\n"));
+
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=-10\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 206 && r.off == BIG_LEN - 10 && r.len == 10);
+
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=400000-\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 416 && r.len == 0 && has(r.head, r.head_len, "bytes */307205\r\n"));
+
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=0-1,5-6\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 200 && r.len == BIG_LEN);
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: lines=1-2\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK && r.status == 200);
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=0-1\r\nIf-Range: \"other\"\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK && r.status == 200);
+
+    char req[512];
+    snprintf(req, sizeof(req),
+             "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=0-1\r\nIf-Range: %.*s\r\n\r\n",
+             (int)f->etag.len, f->head + f->etag.off);
+    ASSERT(h11_file_reply(f, request(req), req, &r) == H11_OK && r.status == 206);
+    snprintf(req, sizeof(req), "GET / HTTP/1.1\r\nHost: a\r\nIf-None-Match: \"x\", W/%.*s\r\n\r\n",
+             (int)f->etag.len, f->head + f->etag.off);
+    ASSERT(h11_file_reply(f, request(req), req, &r) == H11_OK);
+    ASSERT(r.status == 304 && r.len == 0 && !has(r.head, r.head_len, "Content-Length"));
+    ASSERT(has(r.head, r.head_len, "ETag: ") && !has(r.head, r.head_len, "Content-Type"));
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nIf-None-Match: \"x\"\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK && r.status == 200);
+    snprintf(req, sizeof(req), "GET / HTTP/1.1\r\nHost: a\r\nIf-Modified-Since: %.*s\r\n\r\n",
+             (int)f->last_modified.len, f->head + f->last_modified.off);
+    ASSERT(h11_file_reply(f, request(req), req, &r) == H11_OK && r.status == 304);
+
+    const h11_file_t *s = h11_file_open(c, "/small.txt", 10);
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=1-3\r\n\r\n";
+    ASSERT(h11_file_reply(s, request(raw), raw, &r) == H11_OK);
+    ASSERT(r.status == 206 && r.data == s->data + 1 && r.len == 3);
+    h11_file_release(f);
+    h11_file_release(s);
+    h11_file_cache_free(c);
+    PASS();
+}
+
+/* Sends r over a socket pair while draining the other end; returns the
+ * bytes received after the head. */
+static usize exchange(h11_file_reply_t *r, char *out, usize cap) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return (usize)-1;
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    usize head_len = r->head_len, got = 0;
+    h11_error_t err;
+    u64 sent;
+    do {
+        err = h11_file_send(sv[0], r, &sent);
+        ssize_t n;
+        while ((n = read(sv[1], out + got, cap - got)) > 0)
+            got += (usize)n;
+    } while (err == H11_NEED_MORE_DATA);
+    close(sv[0]);
+    close(sv[1]);
+    if (err != H11_OK || got < head_len)
+        return (usize)-1;
+    memmove(out, out + head_len, got - head_len);
+    return got - head_len;
+}
+
+static void test_send(void) {
+    TEST(file_send_sendfile_and_inline);
+    static char out[BIG_LEN + 1024];
+    h11_file_cache_t *c = h11_file_cache_new(root, 16);
+    const h11_file_t *f = h11_file_open(c, "/big.bin", 8);
+    h11_file_reply_t r;
+    const char *raw = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(exchange(&r, out, sizeof(out)) == BIG_LEN && memcmp(out, big, BIG_LEN) == 0);
+    ASSERT(r.len == 0 && r.head_len == 0);
+
+    raw = "GET / HTTP/1.1\r\nHost: a\r\nRange: bytes=70000-\r\n\r\n";
+    ASSERT(h11_file_reply(f, request(raw), raw, &r) == H11_OK);
+    ASSERT(exchange(&r, out, sizeof(out)) == BIG_LEN - 70000);
+    ASSERT(memcmp(out, big + 70000, BIG_LEN - 70000) == 0);
+
+    const h11_file_t *s = h11_file_open(c, "/small.txt", 10);
+    raw = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT(h11_file_reply(s, request(raw), raw, &r) == H11_OK);
+    ASSERT(exchange(&r, out, sizeof(out)) == 5 && memcmp(out, "hello", 5) == 0);
+    raw = "HEAD / HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT(h11_file_reply(s, request(raw), raw, &r) == H11_OK);
+    ASSERT(exchange(&r, out, sizeof(out)) == 0);
+    h11_file_release(f);
+    h11_file_release(s);
+    h11_file_cache_free(c);
+    PASS();
+}
+
+int main(void) {
+    for (usize i = 0; i < BIG_LEN; i++)
+        big[i] = (char)(i * 131 >> 3);
+    char sub[sizeof(root) + 8], out[sizeof(root) + 8], pw[sizeof(root) + 8], up[sizeof(root) + 8];
+    snprintf(sub, sizeof(sub), "%s/d", mkdtemp(root));
+    snprintf(out, sizeof(out), "%s/out", root);
+    snprintf(pw, sizeof(pw), "%s/pw", root);
+    snprintf(up, sizeof(up), "%s/up", root);
+    parser = h11_parser_new(NULL);
+    if (parser == NULL || mkdir(sub, 0700) != 0 || !put_file("small.txt", "hello", 5) ||
+        !put_file("big.bin", big, BIG_LEN) || !put_file("d/index.html", "<p>", 3) || symlink("/", out) != 0 ||
+        symlink("/etc/passwd", pw) != 0 || symlink("..", up) != 0) {
+        printf("setup failed\n");
+        return 1;
+    }
+
+    printf("=== file cache ===\n");
+    test_cache();
+    test_decode();
+    test_evict();
+    test_recheck();
+
+    printf("=== file reply ===\n");
+    test_reply();
+
+    printf("=== file send ===\n");
+    test_send();
+
+    char cmd[sizeof(root) + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+    if (system(cmd) != 0)
+        printf("could not remove %s\n", root);
+    h11_parser_free(parser);
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * test_form.c — Tests for the form-urlencoded decoder and query iteration
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define PAIR_IS(p, k, v) \
+    ((p).key_len == strlen(k) && memcmp((p).key, (k), (p).key_len) == 0 && \
+     (p).value_len == strlen(v) && memcmp((p).value, (v), (p).value_len) == 0)
+
+/* Feed body in fragments of at most step bytes, flattening pairs as "k=v;". */
+static h11_error_t collect(const char *body, usize step, char *out, usize out_cap) {
+    char scratch[64];
+    h11_form_t f;
+    h11_form_pair_t pair;
+    h11_error_t err;
+    usize o = 0;
+    h11_form_init(&f, scratch, sizeof(scratch));
+    usize len = strlen(body);
+    for (usize pos = 0; pos < len; pos += step) {
+        usize n = len - pos < step ? len - pos : step;
+        const char *frag = body + pos;
+        while (n > 0) {
+            usize used = 0;
+            err = h11_form_next(&f, frag, n, &used, &pair);
+            frag += used;
+            n -= used;
+            if (err == H11_NEED_MORE_DATA)
+                break;
+            if (err != H11_OK)
+                return err;
+            o += (usize)snprintf(out + o, out_cap - o, "%.*s=%.*s;",
+                                 (int)pair.key_len, pair.key,
+                                 (int)pair.value_len, pair.value);
+        }
+    }
+    err = h11_form_finish(&f, &pair);
+    if (err == H11_OK)
+        o += (usize)snprintf(out + o, out_cap - o, "%.*s=%.*s;",
+                             (int)pair.key_len, pair.key,
+                             (int)pair.value_len, pair.value);
+    else if (err != H11_NEED_MORE_DATA)
+        return err;
+    out[o] = '\0';
+    return H11_OK;
+}
+
+static void test_form_single_fragment_zero_copy(void) {
+    TEST(form_single_fragment_zero_copy);
+    const char body[] = "username=admin&password=1234";
+    char scratch[32];
+    h11_form_t f;
+    h11_form_pair_t pair;
+    usize used = 0;
+    h11_form_init(&f, scratch, sizeof(scratch));
+    ASSERT(h11_form_next(&f, body, strlen(body), &used, &pair) == H11_OK);
+    ASSERT(used == 15);
+    ASSERT(PAIR_IS(pair, "username", "admin"));
+    ASSERT(pair.key == body);
+    ASSERT(h11_form_next(&f, body + used, strlen(body) - used, &used, &pair) == H11_NEED_MORE_DATA);
+    ASSERT(h11_form_finish(&f, &pair) == H11_OK);
+    ASSERT(PAIR_IS(pair, "password", "1234"));
+    ASSERT(h11_form_finish(&f, &pair) == H11_NEED_MORE_DATA);
+    PASS();
+}
+
+static void test_form_every_split(void) {
+    TEST(form_pairs_split_across_fragments);
+    const char *body = "q=http+protocol&page=1&&x=%3Cscript%3E&flag&=v";
+    const char *want = "q=http protocol;page=1;x=<script>;flag=;=v;";
+    char out[256];
+    for (usize step = 1; step <= strlen(body); step++) {
+        ASSERT(collect(body, step, out, sizeof(out)) == H11_OK);
+        ASSERT(strcmp(out, want) == 0);
+    }
+    PASS();
+}
+
+static void test_form_decode_in_place(void) {
+    TEST(form_decode_in_place);
+    char buf[] = "%E4%B8%AD+a%2fb";
+    usize n = 0;
+    ASSERT(h11_form_decode(buf, buf, strlen(buf), &n) == H11_OK);
+    ASSERT(n == 7);
+    ASSERT(memcmp(buf, "\xE4\xB8\xAD a/b", 7) == 0);
+    PASS();
+}
+
+static void test_form_decode_invalid(void) {
+    TEST(form_decode_invalid_escape);
+    char out[16];
+    usize n = 0;
+    ASSERT(h11_form_decode(out, "%G1", 3, &n) == H11_ERR_INVALID_FORM_ENCODING);
+    ASSERT(h11_form_decode(out, "ab%2", 4, &n) == H11_ERR_INVALID_FORM_ENCODING);
+    ASSERT(collect("a=%zz", 2, out, sizeof(out)) == H11_ERR_INVALID_FORM_ENCODING);
+    PASS();
+}
+
+static void test_form_scratch_overflow(void) {
+    TEST(form_split_field_exceeds_scratch);
+    char scratch[4];
+    h11_form_t f;
+    h11_form_pair_t pair;
+    usize used = 0;
+    h11_form_init(&f, scratch, sizeof(scratch));
+    ASSERT(h11_form_next(&f, "abc", 3, &used, &pair) == H11_NEED_MORE_DATA);
+    ASSERT(h11_form_next(&f, "defg&", 5, &used, &pair) == H11_ERR_FORM_FIELD_TOO_LONG);
+    h11_form_init(&f, scratch, sizeof(scratch));
+    ASSERT(h11_form_next(&f, "long=plain&", 11, &used, &pair) == H11_OK);
+    ASSERT(PAIR_IS(pair, "long", "plain"));
+    PASS();
+}
+
+static void test_query_next(void) {
+    TEST(query_next_iterates_raw_spans);
+    const char base[] = "/search?q=%E4%B8%AD%E6%96%87&filter=%3Cscript%3E&&path";
+    h11_span_t target = { .off = 0, .len = (u32)strlen(base) };
+    h11_span_t k, v;
+    u32 pos = 0;
+    ASSERT(h11_query_next(base, target, &pos, &k, &v));
+    ASSERT(k.len == 1 && memcmp(base + k.off, "q", 1) == 0);
+    ASSERT(v.len == 18 && memcmp(base + v.off, "%E4%B8%AD%E6%96%87", 18) == 0);
+    ASSERT(h11_query_next(base, target, &pos, &k, &v));
+    ASSERT(k.len == 6 && memcmp(base + k.off, "filter", 6) == 0);
+    ASSERT(h11_query_next(base, target, &pos, &k, &v));
+    ASSERT(k.len == 4 && v.len == 0);
+    ASSERT(!h11_query_next(base, target, &pos, &k, &v));
+    PASS();
+}
+
+static void test_query_next_no_query(void) {
+    TEST(query_next_without_query);
+    const char base[] = "/index.html";
+    h11_span_t target = { .off = 0, .len = (u32)strlen(base) };
+    h11_span_t k, v;
+    u32 pos = 0;
+    ASSERT(!h11_query_next(base, target, &pos, &k, &v));
+    ASSERT(!h11_query_next(NULL, target, &pos, &k, &v));
+    PASS();
+}
+
+int main(void) {
+    h11_init();
+
+    printf("=== form decoder ===\n");
+    test_form_single_fragment_zero_copy();
+    test_form_every_split();
+    test_form_decode_in_place();
+    test_form_decode_invalid();
+    test_form_scratch_overflow();
+
+    printf("=== query iteration ===\n");
+    test_query_next();
+    test_query_next_no_query();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
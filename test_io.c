@@ -0,0 +1,305 @@
+/*
+ * test_io.c — Tests for the splice body sink and tunnel relay
+ */
+#define _GNU_SOURCE
+#include "h11_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define BODY_LEN (48 * 1024 + 17)
+
+static char body[BODY_LEN];
+
+static bool write_all(int fd, const char *p, usize n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (usize)w;
+    }
+    return true;
+}
+
+/* Connected non-blocking socket pair; sv[0] is the server side. */
+static bool open_pair(int sv[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return false;
+    return fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0;
+}
+
+/* Reads the request head plus a few body bytes from the socket, parses it
+ * and drains the buffered body bytes into out, as a server would before
+ * switching to the sink. */
+static bool read_head(h11_parser_t *p, int fd, int out) {
+    char buf[512];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    usize used = 0, off = 0;
+    if (n <= 0 || h11_parse(p, buf, (usize)n, &used) != H11_OK)
+        return false;
+    off = used;
+    while (off < (usize)n && h11_body_pending(p) > 0) {
+        const char *b;
+        usize bl;
+        if (h11_read_body(p, buf + off, (usize)n - off, &used, &b, &bl) != H11_OK ||
+            !write_all(out, b, bl))
+            return false;
+        off += used;
+    }
+    return true;
+}
+
+static void test_splice_to_file(void) {
+    TEST(splice_identity_body_to_file);
+    char path[] = "/tmp/h11_test_io_XXXXXX";
+    int file = mkstemp(path);
+    ASSERT(file >= 0);
+    unlink(path);
+    int sv[2];
+    ASSERT(open_pair(sv));
+    char head[128];
+    int hl = snprintf(head, sizeof(head),
+                      "PUT /obj HTTP/1.1\r\nHost: a\r\nContent-Length: %d\r\n\r\n", BODY_LEN);
+    ASSERT(write_all(sv[1], head, (usize)hl) && write_all(sv[1], body, 100));
+
+    h11_parser_t *p = h11_parser_new(NULL);
+    h11_pipe_t pp;
+    ASSERT(h11_pipe_open(&pp, 0) == H11_OK && pp.cap > 0);
+    ASSERT(read_head(p, sv[0], file));
+    ASSERT(h11_body_pending(p) == BODY_LEN - 100);
+    u64 moved = 0;
+    ASSERT(h11_body_splice(p, &pp, sv[0], file, &moved) == H11_NEED_MORE_DATA);
+    ASSERT(moved == 0 && pp.buffered == 0);
+
+    /* Feed the rest in pieces; the sink keeps up between writes. */
+    u64 total = 0;
+    h11_error_t err = H11_NEED_MORE_DATA;
+    for (usize off = 100; off < BODY_LEN; off += 7000) {
+        usize n = BODY_LEN - off < 7000 ? BODY_LEN - off : 7000;
+        ASSERT(write_all(sv[1], body + off, n));
+        err = h11_body_splice(p, &pp, sv[0], file, &moved);
+        total += moved;
+    }
+    ASSERT(err == H11_OK);
+    ASSERT(total == BODY_LEN - 100 && pp.buffered == 0);
+    ASSERT(h11_get_state(p) == H11_STATE_COMPLETE);
+    ASSERT(h11_body_splice(p, &pp, sv[0], file, &moved) == H11_ERR_INTERNAL);
+
+    static char back[BODY_LEN];
+    ASSERT(pread(file, back, BODY_LEN, 0) == BODY_LEN);
+    ASSERT(memcmp(back, body, BODY_LEN) == 0);
+
+    /* The next request on the connection is still ours to parse. */
+    const char next[] = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT(write_all(sv[1], next, strlen(next)));
+    char buf[64];
+    usize used = 0;
+    h11_parser_reset(p);
+    ASSERT(read(sv[0], buf, sizeof(buf)) == (ssize_t)strlen(next));
+    ASSERT(h11_parse(p, buf, strlen(next), &used) == H11_OK && used == strlen(next));
+
+    h11_pipe_close(&pp);
+    ASSERT(pp.fd[0] == -1 && pp.fd[1] == -1);
+    h11_parser_free(p);
+    close(sv[0]);
+    close(sv[1]);
+    close(file);
+    PASS();
+}
+
+static void test_splice_stops_at_body_end(void) {
+    TEST(splice_chunk_then_socket_sink);
+    int sv[2], dst[2];
+    ASSERT(open_pair(sv) && open_pair(dst));
+    const char req[] = "POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "a\r\n";
+    const char rest[] = "0123456789\r\n0\r\n\r\n";
+    ASSERT(write_all(sv[1], req, strlen(req)));
+    h11_parser_t *p = h11_parser_new(NULL);
+    h11_pipe_t pp;
+    ASSERT(h11_pipe_open(&pp, 1u << 20) == H11_OK);
+    ASSERT(read_head(p, sv[0], dst[0]));
+    ASSERT(h11_get_state(p) == H11_STATE_BODY_CHUNKED_DATA && h11_body_pending(p) == 10);
+    ASSERT(write_all(sv[1], rest, strlen(rest)));
+    u64 moved = 0;
+    ASSERT(h11_body_splice(p, &pp, sv[0], dst[0], &moved) == H11_OK && moved == 10);
+    ASSERT(h11_get_state(p) == H11_STATE_BODY_CHUNKED_CRLF);
+    char buf[64];
+    ASSERT(read(dst[1], buf, sizeof(buf)) == 10 && memcmp(buf, "0123456789", 10) == 0);
+    /* Framing after the chunk was left on the socket for h11_parse. */
+    ssize_t n = read(sv[0], buf, sizeof(buf));
+    usize used = 0;
+    ASSERT(n == (ssize_t)strlen(rest) - 10);
+    ASSERT(h11_parse(p, buf, (usize)n, &used) == H11_OK);
+    ASSERT(h11_get_state(p) == H11_STATE_COMPLETE);
+    h11_pipe_close(&pp);
+    h11_parser_free(p);
+    close(sv[0]);
+    close(sv[1]);
+    close(dst[0]);
+    close(dst[1]);
+    PASS();
+}
+
+static void test_splice_eof(void) {
+    TEST(splice_eof_before_body_end);
+    int sv[2];
+    ASSERT(open_pair(sv));
+    int null = open("/dev/null", O_WRONLY);
+    ASSERT(null >= 0);
+    const char req[] = "PUT / HTTP/1.1\r\nHost: a\r\nContent-Length: 1000\r\n\r\n";
+    ASSERT(write_all(sv[1], req, strlen(req)));
+    h11_parser_t *p = h11_parser_new(NULL);
+    h11_pipe_t pp;
+    ASSERT(h11_pipe_open(&pp, 0) == H11_OK);
+    ASSERT(read_head(p, sv[0], null));
+    ASSERT(write_all(sv[1], body, 300));
+    close(sv[1]);
+    u64 moved = 0;
+    ASSERT(h11_body_splice(p, &pp, sv[0], null, &moved) == H11_ERR_CONNECTION_CLOSED);
+    ASSERT(h11_body_pending(p) == 700);
+    h11_pipe_close(&pp);
+    h11_parser_free(p);
+    close(sv[0]);
+    close(null);
+    PASS();
+}
+
+/* Reads whatever is available on a non-blocking fd into dst at *got. */
+static bool drain(int fd, char *dst, usize cap, usize *got, bool *eof) {
+    for (;;) {
+        ssize_t n = read(fd, dst + *got, cap - *got);
+        if (n > 0) {
+            *got += (usize)n;
+        } else if (n == 0) {
+            *eof = true;
+            return true;
+        } else {
+            return errno == EAGAIN;
+        }
+    }
+}
+
+static void test_tunnel_relay(void) {
+    TEST(tunnel_forwards_leftover_then_relays);
+    int cl[2], up[2];
+    ASSERT(open_pair(cl) && open_pair(up));
+    ASSERT(fcntl(cl[1], F_SETFL, O_NONBLOCK) == 0 && fcntl(up[1], F_SETFL, O_NONBLOCK) == 0);
+    /* The client sent its first tunnel bytes right behind the request. */
+    char in[256];
+    const char req[] = "CONNECT www.example.com:443 HTTP/1.1\r\nHost: www.example.com:443\r\n\r\n";
+    int il = snprintf(in, sizeof(in), "%s\x16\x03\x01hello", req);
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize used = 0;
+    ASSERT(h11_parse(p, in, (usize)il, &used) == H11_OK && used == strlen(req));
+    ASSERT(h11_get_request(p)->target_form == H11_TARGET_AUTHORITY);
+
+    h11_tunnel_t t;
+    ASSERT(h11_tunnel_open(&t, cl[0], up[0], in + used, (usize)il - used, 0) == H11_OK);
+    static char at_up[BODY_LEN + 16], at_cl[BODY_LEN];
+    usize up_got = 0, cl_got = 0, up_off = 0, cl_off = 0;
+    bool up_eof = false, cl_eof = false;
+    h11_error_t err = h11_tunnel_relay(&t);
+    ASSERT(err == H11_NEED_MORE_DATA && t.up.moved == 8 && t.up.prefix_len == 0);
+
+    /* Both peers stream BODY_LEN bytes at once, then half-close. */
+    for (int spins = 0; err != H11_OK && spins < 100000; spins++) {
+        if (up_off < BODY_LEN) {
+            ssize_t n = write(cl[1], body + up_off, BODY_LEN - up_off);
+            up_off += n > 0 ? (usize)n : 0;
+            if (up_off == BODY_LEN)
+                shutdown(cl[1], SHUT_WR);
+        }
+        if (cl_off < BODY_LEN) {
+            ssize_t n = write(up[1], body + cl_off, BODY_LEN - cl_off);
+            cl_off += n > 0 ? (usize)n : 0;
+            if (cl_off == BODY_LEN)
+                shutdown(up[1], SHUT_WR);
+        }
+        err = h11_tunnel_relay(&t);
+        ASSERT(err != H11_ERR_INTERNAL);
+        ASSERT(drain(up[1], at_up, sizeof(at_up), &up_got, &up_eof));
+        ASSERT(drain(cl[1], at_cl, sizeof(at_cl), &cl_got, &cl_eof));
+    }
+    ASSERT(err == H11_OK && t.up.done && t.down.done);
+    ASSERT(drain(up[1], at_up, sizeof(at_up), &up_got, &up_eof) && up_eof);
+    ASSERT(drain(cl[1], at_cl, sizeof(at_cl), &cl_got, &cl_eof) && cl_eof);
+    ASSERT(up_got == BODY_LEN + 8 && memcmp(at_up, "\x16\x03\x01hello", 8) == 0);
+    ASSERT(memcmp(at_up + 8, body, BODY_LEN) == 0);
+    ASSERT(cl_got == BODY_LEN && memcmp(at_cl, body, BODY_LEN) == 0);
+    ASSERT(t.up.moved == BODY_LEN + 8 && t.down.moved == BODY_LEN);
+    ASSERT(h11_tunnel_relay(&t) == H11_OK);
+
+    h11_tunnel_close(&t);
+    ASSERT(t.up.pipe.fd[0] == -1 && t.down.pipe.fd[1] == -1);
+    ASSERT(h11_tunnel_relay(&t) == H11_ERR_INTERNAL);
+    h11_parser_free(p);
+    close(cl[0]);
+    close(cl[1]);
+    close(up[0]);
+    close(up[1]);
+    PASS();
+}
+
+static void test_tunnel_half_close(void) {
+    TEST(tunnel_half_close_and_reset);
+    int cl[2], up[2];
+    ASSERT(open_pair(cl) && open_pair(up));
+    h11_tunnel_t t;
+    ASSERT(h11_tunnel_open(&t, cl[0], up[0], NULL, 0, 0) == H11_OK);
+    /* The client is done sending; the upstream can still answer. */
+    ASSERT(write_all(cl[1], "ping", 4) && shutdown(cl[1], SHUT_WR) == 0);
+    ASSERT(h11_tunnel_relay(&t) == H11_NEED_MORE_DATA && t.up.done && !t.down.done);
+    char buf[16];
+    ASSERT(read(up[1], buf, sizeof(buf)) == 4 && memcmp(buf, "ping", 4) == 0);
+    ASSERT(read(up[1], buf, sizeof(buf)) == 0);
+    ASSERT(write_all(up[1], "pong", 4));
+    ASSERT(h11_tunnel_relay(&t) == H11_NEED_MORE_DATA && t.down.moved == 4);
+    ASSERT(read(cl[1], buf, sizeof(buf)) == 4 && memcmp(buf, "pong", 4) == 0);
+    /* A client that vanishes fails the next write towards it. */
+    close(cl[1]);
+    ASSERT(write_all(up[1], "late", 4));
+    ASSERT(h11_tunnel_relay(&t) == H11_ERR_INTERNAL && errno == EPIPE);
+    h11_tunnel_close(&t);
+    close(cl[0]);
+    close(up[0]);
+    close(up[1]);
+    PASS();
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);
+    for (usize i = 0; i < BODY_LEN; i++)
+        body[i] = (char)('a' + i * 7 % 26);
+
+    printf("=== body splice ===\n");
+    test_splice_to_file();
+    test_splice_stops_at_body_end();
+    test_splice_eof();
+
+    printf("=== tunnel ===\n");
+    test_tunnel_relay();
+    test_tunnel_half_close();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
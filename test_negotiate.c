@@ -0,0 +1,142 @@
+/*
+ * test_negotiate.c — Tests for Accept-Encoding / Accept negotiation
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+static const char *const encodings[] = { "br", "gzip", "identity" };
+static const char *const media[] = { "application/json", "text/html", "text/plain" };
+
+static int neg(const h11_offers_t *o, const char *value) {
+    h11_span_t s = { .off = 0, .len = (u32)strlen(value) };
+    return h11_negotiate(o, value, s);
+}
+
+static void test_compile(void) {
+    TEST(compile_validates_offers);
+    h11_offers_t o;
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, encodings, 3) == H11_OK);
+    ASSERT(o.count == 3 && o.identity == 2);
+    const char *dup[] = { "gzip", "GZIP" };
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, dup, 2) == H11_ERR_INTERNAL);
+    const char *star[] = { "*" };
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, star, 1) == H11_ERR_INTERNAL);
+    const char *bad_media[] = { "text" };
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_MEDIA, bad_media, 1) == H11_ERR_INTERNAL);
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_MEDIA, media, 0) == H11_ERR_INTERNAL);
+    const char *many[H11_MAX_OFFERS + 1];
+    for (u32 i = 0; i <= H11_MAX_OFFERS; i++)
+        many[i] = "x";
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, many, H11_MAX_OFFERS + 1) ==
+           H11_ERR_INTERNAL);
+    PASS();
+}
+
+static void test_encoding(void) {
+    TEST(accept_encoding_selection);
+    h11_offers_t o;
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, encodings, 3) == H11_OK);
+    ASSERT(neg(&o, "gzip, deflate, br") == 0);
+    ASSERT(neg(&o, "gzip, deflate") == 1);
+    ASSERT(neg(&o, "GZIP;q=0.5, br;q=0.8") == 0);
+    ASSERT(neg(&o, "br;q=0.1, gzip") == 1);
+    ASSERT(neg(&o, "deflate") == 2);
+    ASSERT(neg(&o, "") == 2);
+    ASSERT(neg(&o, "*") == 0);
+    ASSERT(neg(&o, "br;q=0, *;q=0.5") == 1);
+    ASSERT(neg(&o, "*;q=0") == -1);
+    ASSERT(neg(&o, "identity;q=0") == -1);
+    ASSERT(neg(&o, "identity, *;q=0") == 2);
+    ASSERT(neg(&o, "gzip;q=bogus") == 2);
+    ASSERT(neg(&o, " , ,gzip ;q=1 ,") == 1);
+    PASS();
+}
+
+/* Empty list members yield empty tokens; the value sits at the start of its
+ * own allocation so a read before a token is caught under ASan. */
+static void test_empty_member(void) {
+    TEST(empty_list_member_is_skipped);
+    h11_offers_t o;
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, encodings, 3) == H11_OK);
+    const char *values[] = { ";q=0.5", ";q=0.5, gzip", ", ,", "br;q=0, ;q=1" };
+    const int want[] = { 2, 1, 2, 2 };
+    for (usize i = 0; i < H11_ARRAY_LEN(values); i++) {
+        usize len = strlen(values[i]);
+        char *v = malloc(len);
+        ASSERT(v != NULL);
+        memcpy(v, values[i], len);
+        int got = h11_negotiate(&o, v, (h11_span_t){ .off = 0, .len = (u32)len });
+        free(v);
+        ASSERT(got == want[i]);
+    }
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_MEDIA, media, 3) == H11_OK);
+    char *v = malloc(6);
+    ASSERT(v != NULL);
+    memcpy(v, ";q=0.5", 6);
+    int got = h11_negotiate(&o, v, (h11_span_t){ .off = 0, .len = 6 });
+    free(v);
+    ASSERT(got == -1);
+    PASS();
+}
+
+static void test_media(void) {
+    TEST(accept_media_selection);
+    h11_offers_t o;
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_MEDIA, media, 3) == H11_OK);
+    ASSERT(neg(&o, "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8") == 1);
+    ASSERT(neg(&o, "*/*") == 0);
+    ASSERT(neg(&o, "text/*") == 1);
+    ASSERT(neg(&o, "text/*;q=0.5, text/plain") == 2);
+    ASSERT(neg(&o, "text/plain;q=0.2, text/*;q=0.9") == 1);
+    ASSERT(neg(&o, "*/*;q=0.1, application/json;q=0") == 1);
+    ASSERT(neg(&o, "image/png") == -1);
+    ASSERT(neg(&o, "") == -1);
+    ASSERT(neg(&o, "Text/HTML;level=1") == 1);
+    PASS();
+}
+
+static void test_request(void) {
+    TEST(request_negotiate_combines_fields);
+    const char buf[] =
+        "GET / HTTP/1.1\r\nHost: a\r\nAccept-Encoding: gzip;q=0.5\r\n"
+        "accept-encoding: br;q=0.9\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize c = 0;
+    ASSERT(h11_parse(p, buf, strlen(buf), &c) == H11_OK);
+    h11_offers_t o;
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_ENCODING, encodings, 3) == H11_OK);
+    ASSERT(h11_request_negotiate(&o, h11_get_request(p), buf) == 0);
+    ASSERT(h11_offers_compile(&o, H11_NEGOTIATE_MEDIA, media, 3) == H11_OK);
+    ASSERT(h11_request_negotiate(&o, h11_get_request(p), buf) == 0);
+    h11_parser_free(p);
+    PASS();
+}
+
+int main(void) {
+    printf("=== offers ===\n");
+    test_compile();
+
+    printf("=== negotiate ===\n");
+    test_encoding();
+    test_empty_member();
+    test_media();
+    test_request();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,814 @@
+/*
+ * test_parser.c — Tests for the request parser state machine
+ */
+#define _DEFAULT_SOURCE
+#include "h11_internal.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define SPAN_IS(base, s, lit) \
+    ((s).len == strlen(lit) && memcmp((base) + (s).off, (lit), (s).len) == 0)
+
+/* Drive h11_parse/h11_read_body over a complete buffer until the request is
+ * complete or parsing stops; *body_total counts delivered body bytes. */
+static h11_error_t run(h11_parser_t *p, const char *buf, usize len, usize *used,
+                       usize *body_total) {
+    usize off = 0, body = 0;
+    h11_error_t err;
+    for (;;) {
+        usize c = 0;
+        err = h11_parse(p, buf + off, len - off, &c);
+        off += c;
+        if (err != H11_OK || h11_get_state(p) == H11_STATE_COMPLETE)
+            break;
+        const char *out;
+        usize out_len;
+        err = h11_read_body(p, buf + off, len - off, &c, &out, &out_len);
+        off += c;
+        body += out_len;
+        if (err != H11_OK)
+            break;
+    }
+    if (used)
+        *used = off;
+    if (body_total)
+        *body_total = body;
+    return err;
+}
+
+static h11_error_t parse_cfg(const char *req, const h11_config_t *cfg) {
+    h11_parser_t *p = h11_parser_new(cfg);
+    h11_error_t err = run(p, req, strlen(req), NULL, NULL);
+    h11_parser_free(p);
+    return err;
+}
+
+static h11_error_t parse_str(const char *req) {
+    return parse_cfg(req, NULL);
+}
+
+static void test_simple_get(void) {
+    TEST(simple_get);
+    const char req[] = "GET /index.html?q=1 HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize used = 0;
+    ASSERT(run(p, req, strlen(req), &used, NULL) == H11_OK);
+    ASSERT(used == strlen(req));
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(SPAN_IS(req, r->method, "GET"));
+    ASSERT(SPAN_IS(req, r->target, "/index.html?q=1"));
+    ASSERT(r->version == 0x0101);
+    ASSERT(r->target_form == H11_TARGET_ORIGIN);
+    ASSERT(r->body_type == H11_BODY_NONE);
+    ASSERT(r->header_count == 2);
+    ASSERT(SPAN_IS(req, r->headers[0].name, "Host"));
+    ASSERT(SPAN_IS(req, r->headers[0].value, "example.com"));
+    ASSERT(r->headers[0].name_id == H11_KHDR_HOST);
+    ASSERT(r->headers[1].name_id == H11_INDEX_NONE);
+    ASSERT(r->known_idx[H11_KHDR_HOST] == 0);
+    ASSERT(r->known_idx[H11_KHDR_CONNECTION] == H11_INDEX_NONE);
+    ASSERT(r->flags & H11_REQF_KEEP_ALIVE);
+    ASSERT(r->flags & H11_REQF_HAS_HOST);
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_incremental_bytes(void) {
+    TEST(incremental_one_byte_at_a_time);
+    const char req[] =
+        "POST /submit HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n"
+        "X-Pad:   padded   \r\n\r\nhello";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize off = 0, body = 0;
+    for (usize avail = 1; avail <= strlen(req); avail++) {
+        usize c = 0;
+        if (h11_get_state(p) == H11_STATE_BODY_IDENTITY) {
+            const char *out;
+            usize n;
+            ASSERT(h11_read_body(p, req + off, avail - off, &c, &out, &n) == H11_OK);
+            body += n;
+        } else {
+            h11_error_t err = h11_parse(p, req + off, avail - off, &c);
+            ASSERT(err == H11_OK || err == H11_NEED_MORE_DATA);
+        }
+        off += c;
+    }
+    ASSERT(h11_get_state(p) == H11_STATE_COMPLETE);
+    ASSERT(body == 5 && off == strlen(req));
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(SPAN_IS(req, r->headers[2].value, "padded"));
+    ASSERT(r->content_length == 5);
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_request_line_errors(void) {
+    TEST(request_line_edge_cases);
+    ASSERT(parse_str(" /path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_METHOD);
+    ASSERT(parse_str("GET@POST /path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_METHOD);
+    ASSERT(parse_str("GET/path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_METHOD);
+    ASSERT(parse_str("GET /path HTTP/2.0\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_VERSION);
+    ASSERT(parse_str("GET /path http/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_VERSION);
+    ASSERT(parse_str("GET /path\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_VERSION);
+    ASSERT(parse_str("GET /path HTTP/1.1 \r\nHost: a\r\n\r\n") == H11_ERR_INVALID_VERSION);
+    ASSERT(parse_str("GET  /path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_METHOD);
+    ASSERT(parse_str("GET /path HTTP/1.1") == H11_NEED_MORE_DATA);
+    PASS();
+}
+
+static void test_request_line_tolerant(void) {
+    TEST(request_line_tolerate_spaces);
+    h11_config_t cfg = h11_config_default();
+    cfg.flags |= H11_CFG_TOLERATE_SPACES;
+    ASSERT(parse_cfg("GET  /path\tHTTP/1.1 \r\nHost: a\r\n\r\n", &cfg) == H11_OK);
+    PASS();
+}
+
+static void test_request_line_too_long(void) {
+    TEST(request_line_too_long);
+    h11_config_t cfg = h11_config_default();
+    cfg.max_request_line_len = 32;
+    ASSERT(parse_cfg("GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa HTTP/1.1\r\n", &cfg) ==
+           H11_ERR_REQUEST_LINE_TOO_LONG);
+    ASSERT(parse_cfg("GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", &cfg) ==
+           H11_ERR_REQUEST_LINE_TOO_LONG);
+    PASS();
+}
+
+static void test_targets(void) {
+    TEST(request_target_forms);
+    ASSERT(parse_str("GET  HTTP/1.1\r\nHost: a\r\n\r\n") != H11_OK);
+    ASSERT(parse_str("GET /path#frag HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET /path%GG HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET /path%2 HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET ?query HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET http:/path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET http://h.example/p?x=/y? HTTP/1.1\r\nHost: h.example\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("CONNECT example.com HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("CONNECT host:99999 HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("CONNECT [::1]:8080 HTTP/1.1\r\nHost: [::1]:8080\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("CONNECT /path HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("GET host:80 HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    ASSERT(parse_str("OPTIONS * HTTP/1.1\r\nHost: a\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET * HTTP/1.1\r\nHost: a\r\n\r\n") == H11_ERR_INVALID_TARGET);
+    PASS();
+}
+
+static void test_header_errors(void) {
+    TEST(header_field_edge_cases);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nInvalidHeader\r\n\r\n") == H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nHeader Name: v\r\n\r\n") == H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\n: value\r\n\r\n") == H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nX-Empty:\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nX-H: val\x01here\r\n\r\n") == H11_ERR_INVALID_HEADER_VALUE);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nX-H: val\r\n continued\r\n\r\n") == H11_ERR_OBS_FOLD_REJECTED);
+    ASSERT(parse_str("GET / HTTP/1.1\r\n Host: a\r\n\r\n") == H11_ERR_LEADING_WHITESPACE);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nX-H: a\nY: b\r\n\r\n") == H11_ERR_INVALID_CRLF);
+    PASS();
+}
+
+static void test_header_limits(void) {
+    TEST(header_count_and_size_limits);
+    char req[8192];
+    usize o = (usize)snprintf(req, sizeof(req), "GET / HTTP/1.1\r\nHost: a\r\n");
+    for (int i = 0; i < 100; i++)
+        o += (usize)snprintf(req + o, sizeof(req) - o, "X-%d: v\r\n", i);
+    snprintf(req + o, sizeof(req) - o, "\r\n");
+    ASSERT(parse_str(req) == H11_ERR_TOO_MANY_HEADERS);
+    h11_config_t cfg = h11_config_default();
+    cfg.max_headers_size = 64;
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nX-A: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\n\r\n",
+                     &cfg) == H11_ERR_HEADERS_TOO_LARGE);
+    cfg = h11_config_default();
+    cfg.max_header_line_len = 16;
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nX-A: aaaaaaaaaaaaaaaaaaaa", &cfg) ==
+           H11_ERR_HEADER_LINE_TOO_LONG);
+    PASS();
+}
+
+static void test_header_array_growth(void) {
+    TEST(header_array_grows_past_initial_capacity);
+    char req[4096];
+    usize o = (usize)snprintf(req, sizeof(req), "GET / HTTP/1.1\r\nHost: a\r\n");
+    for (int i = 0; i < 60; i++)
+        o += (usize)snprintf(req + o, sizeof(req) - o, "X-%d: v%d\r\n", i, i);
+    snprintf(req + o, sizeof(req) - o, "\r\n");
+    h11_parser_t *p = h11_parser_new(NULL);
+    ASSERT(run(p, req, strlen(req), NULL, NULL) == H11_OK);
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(r->header_count == 61);
+    ASSERT(SPAN_IS(req, r->headers[60].value, "v59"));
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_host_rules(void) {
+    TEST(host_semantics);
+    ASSERT(parse_str("GET / HTTP/1.1\r\n\r\n") == H11_ERR_MISSING_HOST);
+    ASSERT(parse_str("GET / HTTP/1.0\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n") == H11_ERR_MULTIPLE_HOST);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: example .com\r\n\r\n") == H11_ERR_INVALID_HOST);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: example.com:8080\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: example.com:99999\r\n\r\n") == H11_ERR_INVALID_HOST);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost: [::1]\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET / HTTP/1.1\r\nHost:\r\n\r\n") == H11_OK);
+    ASSERT(parse_str("GET http://a/ HTTP/1.1\r\nHost:\r\n\r\n") == H11_ERR_INVALID_HOST);
+    PASS();
+}
+
+static void test_content_length_rules(void) {
+    TEST(content_length_semantics);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: +100\r\n\r\n") == H11_ERR_INVALID_CONTENT_LENGTH);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 99999999999999999999\r\n\r\n") ==
+           H11_ERR_CONTENT_LENGTH_OVERFLOW);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 100\r\nContent-Length: 200\r\n\r\n") ==
+           H11_ERR_MULTIPLE_CONTENT_LENGTH);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 3, 3\r\n\r\nabc") == H11_OK);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 3, 4\r\n\r\nabc") ==
+           H11_ERR_MULTIPLE_CONTENT_LENGTH);
+    h11_config_t cfg = h11_config_default();
+    cfg.max_body_size = 2;
+    ASSERT(parse_cfg("POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 3\r\n\r\nabc", &cfg) ==
+           H11_ERR_BODY_TOO_LARGE);
+    PASS();
+}
+
+static void test_transfer_encoding_rules(void) {
+    TEST(transfer_encoding_semantics);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: gzip\r\n\r\n") == H11_ERR_TE_NOT_CHUNKED_FINAL);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked;q=1\r\n\r\n") ==
+           H11_ERR_INVALID_TRANSFER_ENCODING);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: unknown, chunked\r\n\r\n") ==
+           H11_ERR_UNKNOWN_TRANSFER_CODING);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked, gzip\r\n\r\n") ==
+           H11_ERR_TE_NOT_CHUNKED_FINAL);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n") ==
+           H11_OK);
+    ASSERT(parse_str("POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n") ==
+           H11_ERR_TE_CL_CONFLICT);
+    PASS();
+}
+
+static void test_te_cl_tolerant(void) {
+    TEST(te_cl_tolerant_forces_close);
+    h11_config_t cfg = h11_config_default();
+    cfg.flags &= ~(u32)H11_CFG_REJECT_TE_CL_CONFLICT;
+    const char req[] = "POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(&cfg);
+    ASSERT(run(p, req, strlen(req), NULL, NULL) == H11_OK);
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(r->body_type == H11_BODY_CHUNKED);
+    ASSERT(!(r->flags & H11_REQF_KEEP_ALIVE));
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_connection_tokens(void) {
+    TEST(connection_and_expect_tokens);
+    struct { const char *req; u16 set; u16 clear; } cases[] = {
+        { "GET / HTTP/1.0\r\n\r\n", 0, H11_REQF_KEEP_ALIVE },
+        { "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n", H11_REQF_KEEP_ALIVE, 0 },
+        { "GET / HTTP/1.1\r\nHost: a\r\nConnection: Upgrade, close\r\n\r\n", 0, H11_REQF_KEEP_ALIVE },
+        { "GET / HTTP/1.1\r\nHost: a\r\nConnection: keep-alive, upgrade\r\nUpgrade: websocket\r\n\r\n",
+          H11_REQF_KEEP_ALIVE | H11_REQF_HAS_UPGRADE, 0 },
+        { "PUT / HTTP/1.1\r\nHost: a\r\nExpect: 100-Continue\r\nContent-Length: 1\r\n\r\nx",
+          H11_REQF_EXPECT_CONTINUE, 0 },
+        { "PUT / HTTP/1.0\r\nExpect: 100-continue\r\nContent-Length: 1\r\n\r\nx",
+          0, H11_REQF_EXPECT_CONTINUE | H11_REQF_EXPECT_UNSUPPORTED },
+        { "PUT / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue;x=1\r\nContent-Length: 1\r\n\r\nx",
+          H11_REQF_EXPECT_UNSUPPORTED, H11_REQF_EXPECT_CONTINUE },
+        { "PUT / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue, fast\r\nContent-Length: 1\r\n\r\nx",
+          H11_REQF_EXPECT_CONTINUE | H11_REQF_EXPECT_UNSUPPORTED, 0 },
+    };
+    for (usize i = 0; i < H11_ARRAY_LEN(cases); i++) {
+        h11_parser_t *p = h11_parser_new(NULL);
+        ASSERT(run(p, cases[i].req, strlen(cases[i].req), NULL, NULL) == H11_OK);
+        const h11_request_t *r = h11_get_request(p);
+        ASSERT((r->flags & cases[i].set) == cases[i].set);
+        ASSERT((r->flags & cases[i].clear) == 0);
+        h11_parser_free(p);
+    }
+    PASS();
+}
+
+/* Parse just the header section of req; returns the body's offset. */
+static usize parse_head(h11_parser_t *p, const char *req) {
+    usize used = 0;
+    h11_error_t err = h11_parse(p, req, strlen(req), &used);
+    return err == H11_OK || err == H11_NEED_MORE_DATA ? used : 0;
+}
+
+static void test_expect_response(void) {
+    TEST(expect_response_policy);
+    const char *resp;
+    usize len;
+    h11_parser_t *p = h11_parser_new(NULL);
+    const char cont[] = "PUT / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue\r\n"
+                        "Content-Length: 3\r\n\r\nabc";
+    usize off = parse_head(p, cont);
+    ASSERT(off == strlen(cont) - 3 && h11_get_state(p) == H11_STATE_BODY_IDENTITY);
+    ASSERT(h11_expect_response(p, &resp, &len) == 100);
+    ASSERT(len == strlen("HTTP/1.1 100 Continue\r\n\r\n") && memcmp(resp, "HTTP/1.1 100 ", 13) == 0);
+    const char *body;
+    usize used, body_len;
+    ASSERT(h11_read_body(p, cont + off, 1, &used, &body, &body_len) == H11_OK);
+    ASSERT(h11_expect_response(p, &resp, &len) == 0 && resp == NULL && len == 0);
+
+    h11_parser_reset(p);
+    const char chunked[] = "POST / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue\r\n"
+                           "Transfer-Encoding: chunked\r\n\r\n";
+    ASSERT(parse_head(p, chunked) == strlen(chunked));
+    ASSERT(h11_get_state(p) == H11_STATE_BODY_CHUNKED_SIZE);
+    ASSERT(h11_expect_response(p, &resp, &len) == 100);
+
+    h11_parser_reset(p);
+    const char odd[] = "PUT / HTTP/1.1\r\nHost: a\r\nExpect: 200-ok\r\nContent-Length: 3\r\n\r\n";
+    ASSERT(parse_head(p, odd) == strlen(odd));
+    ASSERT(h11_expect_response(p, &resp, &len) == 417);
+    ASSERT(len == strlen(resp) && strstr(resp, "Connection: close\r\n") != NULL);
+
+    /* No body to wait for, or no expectation: nothing to send. */
+    h11_parser_reset(p);
+    const char nobody[] = "GET / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue\r\n\r\n";
+    ASSERT(parse_head(p, nobody) == strlen(nobody));
+    ASSERT(h11_expect_response(p, &resp, &len) == 0);
+    h11_parser_reset(p);
+    const char plain[] = "PUT / HTTP/1.1\r\nHost: a\r\nContent-Length: 3\r\n\r\n";
+    ASSERT(parse_head(p, plain) == strlen(plain));
+    ASSERT(h11_expect_response(p, &resp, &len) == 0);
+    ASSERT(h11_expect_response(p, NULL, &len) == 0);
+
+    /* An oversized announced body never reaches a body state. */
+    h11_config_t cfg = h11_config_default();
+    cfg.max_body_size = 2;
+    ASSERT(parse_cfg("PUT / HTTP/1.1\r\nHost: a\r\nExpect: 100-continue\r\n"
+                     "Content-Length: 3\r\n\r\n", &cfg) == H11_ERR_BODY_TOO_LARGE);
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_chunked_body(void) {
+    TEST(chunked_body_with_ext_and_trailers);
+    const char req[] =
+        "POST /s HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "7\r\n{\"data\"\r\n"
+        "00A;ext=value;q=\"x\\\"y\"\r\n0123456789\r\n"
+        "0\r\nX-Checksum: abc\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize used = 0, body = 0;
+    ASSERT(run(p, req, strlen(req), &used, &body) == H11_OK);
+    ASSERT(used == strlen(req));
+    ASSERT(body == 17);
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(r->body_type == H11_BODY_CHUNKED);
+    ASSERT(r->flags & H11_REQF_IS_CHUNKED);
+    ASSERT(r->trailer_count == 1);
+    ASSERT(SPAN_IS(req, r->trailers[0].name, "X-Checksum"));
+    ASSERT(SPAN_IS(req, r->trailers[0].value, "abc"));
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_chunked_errors(void) {
+    TEST(chunked_body_edge_cases);
+    const char *head = "POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n";
+    struct { const char *body; h11_error_t want; } cases[] = {
+        { "0\r\n\r\n", H11_OK },
+        { "FFFFFFFFFFFFFFFF1\r\n", H11_ERR_CHUNK_SIZE_OVERFLOW },
+        { "3\r\nabcX\r\n", H11_ERR_INVALID_CHUNK_DATA },
+        { "G\r\n", H11_ERR_INVALID_CHUNK_SIZE },
+        { "3 x\r\n", H11_ERR_INVALID_CHUNK_SIZE },
+        { "3;\r\nabc\r\n", H11_ERR_INVALID_CHUNK_EXT },
+        { "3;a=\"open\r\nabc\r\n", H11_ERR_INVALID_CHUNK_EXT },
+        { "0\r\nBad Trailer: x\r\n\r\n", H11_ERR_INVALID_TRAILER },
+    };
+    char req[512];
+    for (usize i = 0; i < H11_ARRAY_LEN(cases); i++) {
+        snprintf(req, sizeof(req), "%s%s", head, cases[i].body);
+        ASSERT(parse_str(req) == cases[i].want);
+    }
+    char ext[2048];
+    usize o = (usize)snprintf(ext, sizeof(ext), "%s1;e=", head);
+    memset(ext + o, 'x', 1100);
+    snprintf(ext + o + 1100, sizeof(ext) - o - 1100, "\r\na\r\n0\r\n\r\n");
+    ASSERT(parse_str(ext) == H11_ERR_CHUNK_EXT_TOO_LONG);
+    PASS();
+}
+
+static void test_body_advance(void) {
+    TEST(body_advance_out_of_band);
+    const char head[] = "PUT /o HTTP/1.1\r\nHost: a\r\nContent-Length: 10\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize used = 0;
+    ASSERT(h11_body_pending(p) == 0);
+    ASSERT(h11_body_advance(p, 1) == H11_ERR_INTERNAL);
+    ASSERT(h11_parse(p, head, strlen(head), &used) == H11_OK);
+    ASSERT(h11_body_pending(p) == 10);
+    ASSERT(h11_body_advance(p, 0) == H11_OK);
+    ASSERT(h11_body_advance(p, 11) == H11_ERR_INTERNAL);
+    ASSERT(h11_body_advance(p, 4) == H11_OK && h11_body_pending(p) == 6);
+    const char *body;
+    usize n;
+    ASSERT(h11_read_body(p, "abcdefgh", 8, &used, &body, &n) == H11_OK && n == 6);
+    ASSERT(h11_get_state(p) == H11_STATE_COMPLETE && h11_body_pending(p) == 0);
+
+    const char chunked[] = "PUT /o HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                           "5\r\nhello\r\n0\r\n\r\n";
+    usize head_len = strlen(chunked) - strlen("5\r\nhello\r\n0\r\n\r\n");
+    h11_parser_reset(p);
+    ASSERT(h11_parse(p, chunked, strlen(chunked), &used) == H11_OK && used == head_len + 3);
+    ASSERT(h11_body_pending(p) == 5);
+    ASSERT(h11_body_advance(p, 5) == H11_OK);
+    ASSERT(h11_get_state(p) == H11_STATE_BODY_CHUNKED_CRLF);
+    usize tail = 0;
+    ASSERT(h11_parse(p, chunked + used + 5, strlen(chunked) - used - 5, &tail) == H11_OK);
+    ASSERT(h11_get_state(p) == H11_STATE_COMPLETE);
+
+    h11_parser_reset(p);
+    ASSERT(h11_parse(p, "GET / HTTP/1.1\r\n\r\n", 18, &used) == H11_ERR_MISSING_HOST);
+    ASSERT(h11_body_advance(p, 0) == H11_ERR_MISSING_HOST);
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_pipelining(void) {
+    TEST(pipelined_requests_with_reset);
+    const char buf[] =
+        "\r\nGET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST /b HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n\r\nabc"
+        "GET /c HTTP/1.1\r\nHost: x\r\n\r\n";
+    const char *targets[] = { "/a", "/b", "/c" };
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize off = 0;
+    for (usize i = 0; i < 3; i++) {
+        usize used = 0;
+        ASSERT(run(p, buf + off, strlen(buf) - off, &used, NULL) == H11_OK);
+        ASSERT(SPAN_IS(buf + off, h11_get_request(p)->target, targets[i]));
+        off += used;
+        h11_parser_reset(p);
+    }
+    ASSERT(off == strlen(buf));
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_error_is_sticky(void) {
+    TEST(error_state_is_sticky_with_offset);
+    const char req[] = "GET / HTTP/1.1\r\nHost: a\r\nBad Name: x\r\n\r\n";
+    h11_parser_t *p = h11_parser_new(NULL);
+    usize c = 0;
+    ASSERT(h11_parse(p, req, strlen(req), &c) == H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(h11_get_state(p) == H11_STATE_ERROR);
+    ASSERT(h11_error_offset(p) == 28);
+    ASSERT(h11_parse(p, req, strlen(req), &c) == H11_ERR_INVALID_HEADER_NAME);
+    h11_parser_reset(p);
+    ASSERT(h11_get_state(p) == H11_STATE_IDLE);
+    h11_parser_free(p);
+    PASS();
+}
+
+static void test_bare_lf_tolerant(void) {
+    TEST(bare_lf_when_not_strict);
+    h11_config_t cfg = h11_config_default();
+    cfg.flags &= ~(u32)H11_CFG_STRICT_CRLF;
+    ASSERT(parse_cfg("\nGET / HTTP/1.1\nHost: a\r\nX: y\n\n", &cfg) == H11_OK);
+    ASSERT(parse_str("GET / HTTP/1.1\nHost: a\r\n\r\n") == H11_ERR_INVALID_CRLF);
+    PASS();
+}
+
+static void test_padded_input(void) {
+    TEST(padded_input_matches_unpadded);
+    const char req[] =
+        "POST /p HTTP/1.1\r\nHost: a\r\nX-A: v:w\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\n0\r\nX-T: t\r\n\r\n";
+    const usize len = strlen(req);
+    char buf[sizeof(req) + H11_INPUT_PADDING];
+    h11_config_t cfg = h11_config_default();
+    cfg.flags |= H11_CFG_PADDED_INPUT;
+    for (int strict = 0; strict < 2; strict++) {
+        if (!strict)
+            cfg.flags &= ~(u32)H11_CFG_STRICT_CRLF;
+        else
+            cfg.flags |= H11_CFG_STRICT_CRLF;
+        /* Deliver growing prefixes; the padding past each prefix holds the
+         * real continuation, then CRLF junk past the end of the request. */
+        memset(buf, '\n', sizeof(buf));
+        memcpy(buf, req, len);
+        h11_parser_t *p = h11_parser_new(&cfg);
+        usize off = 0, body = 0;
+        for (usize avail = 1; avail <= len; avail++) {
+            usize c = 0;
+            h11_state_t st = h11_get_state(p);
+            if (st == H11_STATE_BODY_CHUNKED_DATA) {
+                const char *out;
+                usize n;
+                ASSERT(h11_read_body(p, buf + off, avail - off, &c, &out, &n) == H11_OK);
+                body += n;
+            } else if (st != H11_STATE_COMPLETE) {
+                h11_error_t err = h11_parse(p, buf + off, avail - off, &c);
+                ASSERT(err == H11_OK || err == H11_NEED_MORE_DATA);
+            }
+            off += c;
+        }
+        ASSERT(h11_get_state(p) == H11_STATE_COMPLETE);
+        ASSERT(off == len && body == 5);
+        const h11_request_t *r = h11_get_request(p);
+        ASSERT(r->header_count == 3 && r->trailer_count == 1);
+        ASSERT(SPAN_IS(buf, r->headers[1].value, "v:w"));
+        h11_parser_free(p);
+    }
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nNoColon\r\n\r\n" "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", &cfg) == H11_ERR_INVALID_HEADER_NAME);
+    PASS();
+}
+
+/* Parse req under cfg with and without H11_CFG_BLOCK_VALIDATE, fed whole
+ * and one byte at a time; every outcome must match the per-field checks. */
+static bool block_matches(const char *req, usize len, h11_config_t cfg) {
+    h11_parser_t *ref = h11_parser_new(&cfg);
+    cfg.flags |= H11_CFG_BLOCK_VALIDATE;
+    h11_parser_t *blk = h11_parser_new(&cfg);
+    usize ref_used = 0, blk_used = 0;
+    h11_error_t want = run(ref, req, len, &ref_used, NULL);
+    bool ok = run(blk, req, len, &blk_used, NULL) == want && blk_used == ref_used &&
+              h11_error_offset(blk) == h11_error_offset(ref);
+    const h11_request_t *a = h11_get_request(ref), *b = h11_get_request(blk);
+    ok = ok && a->header_count == b->header_count;
+    for (u32 i = 0; ok && i < a->header_count; i++) {
+        ok = memcmp(&a->headers[i].name, &b->headers[i].name, sizeof(h11_span_t)) == 0 &&
+             memcmp(&a->headers[i].value, &b->headers[i].value, sizeof(h11_span_t)) == 0 &&
+             a->headers[i].name_id == b->headers[i].name_id;
+    }
+    h11_parser_reset(blk);
+    usize off = 0;
+    h11_error_t err = H11_NEED_MORE_DATA;
+    for (usize avail = 1; avail <= len && err == H11_NEED_MORE_DATA; avail++) {
+        usize c = 0;
+        err = h11_parse(blk, req + off, avail - off, &c);
+        off += c;
+    }
+    if (want != H11_NEED_MORE_DATA && want != H11_OK)
+        ok = ok && err == want && h11_error_offset(blk) == h11_error_offset(ref);
+    h11_parser_free(ref);
+    h11_parser_free(blk);
+    return ok;
+}
+
+static void test_block_validate(void) {
+    TEST(block_validate_matches_per_field_checks);
+    static const char *const reqs[] = {
+        "GET / HTTP/1.1\r\nHost: a\r\nX-A: v:w\r\nX-Empty:\r\nX-Ws: \t x \t\r\n\r\nbody",
+        "GET / HTTP/1.1\r\nHost: a\r\nInvalidHeader\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nHeader Name: v\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nHea\"der: v:x\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\n: value\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: val\x01here\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: val\x7f\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: caf\xc3\xa9\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: a\r\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: val\r\n continued\r\n\r\n",
+        "GET / HTTP/1.1\r\n Host: a\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-H: a\nY: b\r\n\r\n",
+        "GET / HTTP/1.1\nHost: a\nX-H: a\n\n",
+        "POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n",
+        "POST / HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "1\r\nx\r\n0\r\nX-T: t\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nX-Partial: v",
+    };
+    h11_simd_level_t lv_max = h11_simd_supported();
+    for (int lv = H11_SIMD_SCALAR; lv <= (int)lv_max; lv++) {
+        h11_simd_force((h11_simd_level_t)lv);
+        for (int flags = 0; flags < 4; flags++) {
+            h11_config_t cfg = h11_config_default();
+            if (flags & 1)
+                cfg.flags &= ~(u32)H11_CFG_STRICT_CRLF;
+            if (flags & 2)
+                cfg.flags &= ~(u32)(H11_CFG_ALLOW_OBS_TEXT | H11_CFG_REJECT_OBS_FOLD);
+            for (usize i = 0; i < H11_ARRAY_LEN(reqs); i++)
+                ASSERT(block_matches(reqs[i], strlen(reqs[i]), cfg));
+        }
+    }
+    /* Blocks past the first classification window, with the window edge
+     * falling on every byte of a CRLF, and blocks that outgrow the limit. */
+    char req[4096];
+    for (int pad = 0; pad < 70; pad++) {
+        usize o = (usize)snprintf(req, sizeof(req), "GET / HTTP/1.1\r\nHost: a\r\nX-P: %.*s\r\n",
+                                  pad, "0123456789012345678901234567890123456789"
+                                       "012345678901234567890123456789");
+        for (int i = 0; i < 40; i++)
+            o += (usize)snprintf(req + o, sizeof(req) - o, "X-Header-%02d: value-%02d\r\n", i, i);
+        snprintf(req + o, sizeof(req) - o, "\r\n");
+        h11_config_t cfg = h11_config_default();
+        ASSERT(block_matches(req, strlen(req), cfg));
+        cfg.max_headers_size = 900 + (u32)pad;
+        ASSERT(block_matches(req, strlen(req), cfg));
+    }
+    h11_simd_force(lv_max);
+    PASS();
+}
+
+static void test_shape_cache(void) {
+    TEST(shape_cache_reuses_previous_names);
+    const char first[] = "GET /a HTTP/1.1\r\nHost: a\r\nX-Ab: 1\r\nContent-Length: 0\r\n\r\n";
+    const char same[] = "GET /b HTTP/1.1\r\nHost: b\r\nX-Ab: 2\r\nContent-Length: 0\r\n\r\n";
+    const char longer[] = "GET /c HTTP/1.1\r\nHost: c\r\nX-Abc: 3\r\ncontent-length: 0\r\n\r\n";
+    const char bad_ws[] = "GET /d HTTP/1.1\r\nHost: d\r\nX-Abc : 4\r\n\r\n";
+    const char bad_cl[] = "GET /e HTTP/1.1\r\nHost: e\r\nX-Abc: 5\r\ncontent-length: x\r\n\r\n";
+    for (int block = 0; block < 2; block++) {
+        h11_config_t cfg = h11_config_default();
+        cfg.flags |= H11_CFG_SHAPE_CACHE | (block ? H11_CFG_BLOCK_VALIDATE : 0);
+        h11_parser_t *p = h11_parser_new(&cfg);
+        const h11_request_t *r = h11_get_request(p);
+        ASSERT(run(p, first, strlen(first), NULL, NULL) == H11_OK && p->shape_hits == 0);
+        ASSERT(p->shape_count == 3);
+        h11_parser_reset(p);
+        ASSERT(run(p, same, strlen(same), NULL, NULL) == H11_OK && p->shape_hits == 3);
+        ASSERT(SPAN_IS(same, r->headers[1].name, "X-Ab") && SPAN_IS(same, r->headers[1].value, "2"));
+        ASSERT(r->known_idx[H11_KHDR_HOST] == 0 && r->known_idx[H11_KHDR_CONTENT_LENGTH] == 2);
+        ASSERT(r->headers[2].flags & H11_HEADER_F_KNOWN_NAME);
+        /* A cached name that is a prefix, or differs in case, is a miss. */
+        h11_parser_reset(p);
+        ASSERT(run(p, longer, strlen(longer), NULL, NULL) == H11_OK && p->shape_hits == 1);
+        ASSERT(SPAN_IS(longer, r->headers[1].name, "X-Abc"));
+        ASSERT(r->known_idx[H11_KHDR_CONTENT_LENGTH] == 2);
+        h11_parser_reset(p);
+        ASSERT(run(p, bad_ws, strlen(bad_ws), NULL, NULL) == H11_ERR_INVALID_HEADER_NAME);
+        h11_parser_reset(p);
+        ASSERT(run(p, bad_cl, strlen(bad_cl), NULL, NULL) == H11_ERR_INVALID_CONTENT_LENGTH);
+        ASSERT(p->shape_hits == 3);
+        h11_parser_free(p);
+    }
+    PASS();
+}
+
+static void test_lazy_headers(void) {
+    TEST(lazy_headers_checked_on_access);
+    const char req[] = "POST /l HTTP/1.1\r\nHost: a\r\nX-A:  one \r\nAccept: text/html\r\n"
+                       "Content-Length: 2\r\nX-Bad: a\x01b\r\nX-A: two\r\nX-Obs: \xe9\r\n\r\nhi";
+    h11_config_t cfg = h11_config_default();
+    cfg.flags |= H11_CFG_LAZY_HEADERS;
+    h11_parser_t *p = h11_parser_new(&cfg);
+    ASSERT(run(p, req, strlen(req), NULL, NULL) == H11_OK);
+    const h11_request_t *r = h11_get_request(p);
+    ASSERT(r->header_count == 7 && r->content_length == 2);
+    ASSERT(r->known_idx[H11_KHDR_HOST] == 0 && !(r->headers[0].flags & H11_HEADER_F_LAZY));
+    ASSERT(r->headers[1].flags == H11_HEADER_F_LAZY);
+    ASSERT(SPAN_IS(req, r->headers[1].name, "X-A") && SPAN_IS(req, r->headers[1].value, "one"));
+    int i = h11_find_header(r, req, "x-a");
+    ASSERT(i == 1 && h11_find_header_next(r, req, "x-a", i) == 5);
+    ASSERT(SPAN_IS(req, r->headers[5].value, "two"));
+    ASSERT(h11_find_header(r, req, "x-bad") == -1);
+    ASSERT(h11_header_validate(r, req, 4) == H11_ERR_INVALID_HEADER_VALUE);
+    ASSERT(h11_header_validate(r, req, 1) == H11_OK && h11_header_validate(r, req, 0) == H11_OK);
+    ASSERT(h11_header_validate(r, req, 6) == H11_OK && h11_find_header(r, req, "x-obs") == 6);
+    ASSERT(h11_header_validate(r, req, 7) == H11_ERR_INTERNAL);
+    /* Checking never writes to the request. */
+    for (u32 k = 1; k < r->header_count; k++) {
+        if (k != 3)
+            ASSERT(r->headers[k].flags == H11_HEADER_F_LAZY);
+    }
+    h11_header_iter_t it;
+    h11_header_iter_init(&it, r, req);
+    u32 seen = 0, invalid = 0;
+    for (const h11_header_t *h; (h = h11_header_next(&it)) != NULL; seen++) {
+        ASSERT(!(h->flags & H11_HEADER_F_LAZY));
+        invalid += (h->flags & H11_HEADER_F_INVALID) != 0;
+    }
+    ASSERT(seen == 7 && invalid == 1);
+    ASSERT(SPAN_IS(req, r->headers[2].value, "text/html"));
+    h11_parser_free(p);
+
+    /* Disallowed obs-text is caught while parsing; the field stays lazy. */
+    h11_config_t strict = cfg;
+    strict.flags &= ~(u32)H11_CFG_ALLOW_OBS_TEXT;
+    p = h11_parser_new(&strict);
+    ASSERT(run(p, req, strlen(req), NULL, NULL) == H11_OK);
+    r = h11_get_request(p);
+    ASSERT(r->headers[6].flags == (H11_HEADER_F_LAZY | H11_HEADER_F_INVALID));
+    ASSERT(h11_header_validate(r, req, 6) == H11_ERR_INVALID_HEADER_VALUE);
+    ASSERT(h11_find_header(r, req, "x-obs") == -1 && h11_find_header(r, req, "x-a") == 1);
+    h11_parser_free(p);
+
+    /* Framing headers and line structure are still checked up front. */
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nContent-Length: x\r\n\r\n", &cfg) ==
+           H11_ERR_INVALID_CONTENT_LENGTH);
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nContent-Length : 1\r\n\r\n", &cfg) ==
+           H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nX-A: a\nContent-Length: 1\r\n\r\n", &cfg) ==
+           H11_ERR_INVALID_CRLF);
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nNoColon\r\n\r\n", &cfg) ==
+           H11_ERR_INVALID_HEADER_NAME);
+    ASSERT(parse_cfg("GET / HTTP/1.1\r\nHost: a\r\nBad Name: v\r\n\r\n", &cfg) == H11_OK);
+    PASS();
+}
+
+static void test_guard_page(void) {
+    TEST(request_flush_against_guard_page);
+    const char req[] = "GET /g HTTP/1.1\r\nHost: a\r\nX-Tail: v\r\n\r\n";
+    usize page = (usize)sysconf(_SC_PAGESIZE);
+    char *m = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(m != MAP_FAILED);
+    ASSERT(mprotect(m + page, page, PROT_NONE) == 0);
+    h11_simd_level_t lv_max = h11_simd_supported();
+    for (int lv = H11_SIMD_SCALAR; lv <= (int)lv_max; lv++) {
+        h11_simd_force((h11_simd_level_t)lv);
+        for (usize cut = 1; cut <= strlen(req); cut++) {
+            char *d = m + page - cut;
+            memcpy(d, req, cut);
+            h11_parser_t *p = h11_parser_new(NULL);
+            usize used = 0;
+            h11_error_t err = run(p, d, cut, &used, NULL);
+            ASSERT(cut == strlen(req) ? err == H11_OK : err == H11_NEED_MORE_DATA);
+            h11_parser_free(p);
+        }
+    }
+    h11_simd_force(lv_max);
+    munmap(m, 2 * page);
+    PASS();
+}
+
+static void test_sample_requests(void) {
+    TEST(sample_requests_parse_headers);
+    const char *files[] = {
+        "sample_requests/01_simple_get.txt", "sample_requests/02_get_with_headers.txt",
+        "sample_requests/09_options_request.txt", "sample_requests/12_get_with_cookies.txt",
+        "sample_requests/16_connect_request.txt", "sample_requests/22_many_headers.txt",
+        "sample_requests/25_utf8_headers.txt", "sample_requests/30_absolute_uri.txt",
+        "sample_requests/31_expect_continue.txt",
+    };
+    static char buf[65536];
+    for (usize i = 0; i < H11_ARRAY_LEN(files); i++) {
+        FILE *f = fopen(files[i], "rb");
+        if (f == NULL)
+            continue;
+        usize n = fread(buf, 1, sizeof(buf), f);
+        fclose(f);
+        h11_parser_t *p = h11_parser_new(NULL);
+        usize c = 0;
+        h11_error_t err = h11_parse(p, buf, n, &c);
+        ASSERT(err == H11_OK);
+        h11_state_t st = h11_get_state(p);
+        ASSERT(st == H11_STATE_COMPLETE || st == H11_STATE_BODY_IDENTITY);
+        h11_parser_free(p);
+    }
+    PASS();
+}
+
+int main(void) {
+    printf("=== request line ===\n");
+    test_simple_get();
+    test_incremental_bytes();
+    test_request_line_errors();
+    test_request_line_tolerant();
+    test_request_line_too_long();
+    test_targets();
+
+    printf("=== headers ===\n");
+    test_header_errors();
+    test_header_limits();
+    test_header_array_growth();
+
+    printf("=== header semantics ===\n");
+    test_host_rules();
+    test_content_length_rules();
+    test_transfer_encoding_rules();
+    test_te_cl_tolerant();
+    test_connection_tokens();
+    test_expect_response();
+
+    printf("=== body ===\n");
+    test_chunked_body();
+    test_chunked_errors();
+    test_body_advance();
+
+    printf("=== lifecycle ===\n");
+    test_pipelining();
+    test_error_is_sticky();
+    test_bare_lf_tolerant();
+    test_padded_input();
+    test_block_validate();
+    test_shape_cache();
+    test_lazy_headers();
+    test_guard_page();
+    test_sample_requests();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * test_range.c — Tests for Range header parsing and coalescing
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+static h11_error_t parse(const char *v, u64 size, h11_range_t *r, u32 max, u32 *n) {
+    h11_span_t span = { .off = 0, .len = (u32)strlen(v) };
+    return h11_range_parse(v, span, size, r, max, n);
+}
+
+static void test_range_sample(void) {
+    TEST(range_single_sample_request);
+    h11_range_t r[4];
+    u32 n = 0;
+    ASSERT(parse("bytes=0-1023", 1u << 20, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 0 && r[0].last == 1023);
+    ASSERT(parse("Bytes=0-1023", 512, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].last == 511);
+    PASS();
+}
+
+static void test_range_suffix_and_open(void) {
+    TEST(range_suffix_and_open_ended);
+    h11_range_t r[4];
+    u32 n = 0;
+    ASSERT(parse("bytes=-500", 10000, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 9500 && r[0].last == 9999);
+    ASSERT(parse("bytes=-20000", 10000, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 0 && r[0].last == 9999);
+    ASSERT(parse("bytes=9500-", 10000, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 9500 && r[0].last == 9999);
+    PASS();
+}
+
+static void test_range_sort_and_merge(void) {
+    TEST(range_sorted_and_coalesced);
+    h11_range_t r[4];
+    u32 n = 0;
+    ASSERT(parse("bytes=500-599, 0-99 ,100-199,\t50-150, 900-", 1000, r, 4, &n) == H11_OK);
+    ASSERT(n == 3);
+    ASSERT(r[0].first == 0 && r[0].last == 199);
+    ASSERT(r[1].first == 500 && r[1].last == 599);
+    ASSERT(r[2].first == 900 && r[2].last == 999);
+    ASSERT(parse("bytes=500-599,900-,0-99,600-899", 1000, r, 4, &n) == H11_OK);
+    ASSERT(n == 2 && r[0].last == 99 && r[1].first == 500 && r[1].last == 999);
+    PASS();
+}
+
+static void test_range_many_small_collapse(void) {
+    TEST(range_many_small_ranges_collapse);
+    static char v[65536];
+    usize o = (usize)snprintf(v, sizeof(v), "bytes=");
+    for (int i = 0; i < 4000; i++)
+        o += (usize)snprintf(v + o, sizeof(v) - o, "%d-%d,", i * 2, i * 2 + 1);
+    h11_range_t r[2];
+    u32 n = 0;
+    ASSERT(parse(v, 1u << 20, r, 2, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 0 && r[0].last == 7999);
+    PASS();
+}
+
+static void test_range_limit(void) {
+    TEST(range_too_many_after_merge);
+    h11_range_t r[2];
+    u32 n = 0;
+    ASSERT(parse("bytes=0-0,2-2,4-4", 100, r, 2, &n) == H11_ERR_TOO_MANY_RANGES);
+    ASSERT(n == 0);
+    ASSERT(parse("bytes=0-0,2-2,1-1", 100, r, 2, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].last == 2);
+    PASS();
+}
+
+static void test_range_unsatisfiable(void) {
+    TEST(range_not_satisfiable);
+    h11_range_t r[4];
+    u32 n = 0;
+    ASSERT(parse("bytes=1000-", 1000, r, 4, &n) == H11_ERR_RANGE_NOT_SATISFIABLE);
+    ASSERT(parse("bytes=-0", 1000, r, 4, &n) == H11_ERR_RANGE_NOT_SATISFIABLE);
+    ASSERT(parse("bytes=-10", 0, r, 4, &n) == H11_ERR_RANGE_NOT_SATISFIABLE);
+    ASSERT(parse("bytes=2000-3000, 10-19", 1000, r, 4, &n) == H11_OK);
+    ASSERT(n == 1 && r[0].first == 10);
+    PASS();
+}
+
+static void test_range_invalid(void) {
+    TEST(range_invalid_syntax);
+    h11_range_t r[4];
+    u32 n = 0;
+    const char *bad[] = {
+        "bytes=", "bytes= , ", "items=0-1", "bytes 0-1", "bytes=5-1",
+        "bytes=a-1", "bytes=1", "bytes=--1", "bytes=+1-2",
+        "bytes=0-99999999999999999999",
+    };
+    for (usize i = 0; i < H11_ARRAY_LEN(bad); i++)
+        ASSERT(parse(bad[i], 1000, r, 4, &n) == H11_ERR_INVALID_RANGE);
+    PASS();
+}
+
+int main(void) {
+    h11_init();
+
+    printf("=== range_parse ===\n");
+    test_range_sample();
+    test_range_suffix_and_open();
+    test_range_sort_and_merge();
+    test_range_many_small_collapse();
+    test_range_limit();
+    test_range_unsatisfiable();
+    test_range_invalid();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
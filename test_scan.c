@@ -0,0 +1,425 @@
+/*
+ * test_scan.c — Tests for CPU detection and SIMD byte scanners
+ */
+#define _DEFAULT_SOURCE
+#include "h11_internal.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define FOR_EACH_LEVEL(lv) \
+    for (int lv = H11_SIMD_SCALAR; lv <= (int)detected_level; lv++)
+
+static h11_simd_level_t detected_level;
+
+static usize ref_find_char(const char *d, usize len, char c) {
+    for (usize i = 0; i < len; i++)
+        if (d[i] == c) return i;
+    return len;
+}
+
+static usize ref_find_nonascii(const char *d, usize len) {
+    for (usize i = 0; i < len; i++)
+        if ((u8)d[i] >= 0x80) return i;
+    return len;
+}
+
+static usize ref_find_crlf(const char *d, usize len) {
+    for (usize i = 0; i + 1 < len; i++)
+        if (d[i] == '\r' && d[i + 1] == '\n') return i;
+    return len;
+}
+
+static void test_init_idempotent(void) {
+    TEST(init_idempotent);
+    h11_init();
+    h11_simd_level_t first = h11_simd_level;
+    h11_init();
+    ASSERT(h11_simd_level == first);
+    ASSERT(first >= H11_SIMD_SCALAR && first <= H11_SIMD_AVX512);
+    h11_simd_level_t cap;
+    if (h11_simd_from_name(getenv("H11_SIMD"), &cap))
+        ASSERT(first <= cap);
+    const char *env = getenv("H11_SIMD");
+    h11_simd_calibration_t cal;
+    if (env != NULL && strcmp(env, "auto") == 0)
+        ASSERT(h11_simd_calibration(&cal) && cal.chosen == first);
+    PASS();
+}
+
+static void test_simd_names(void) {
+    TEST(simd_name_round_trip);
+    for (int lv = H11_SIMD_SCALAR; lv <= H11_SIMD_AVX512; lv++) {
+        h11_simd_level_t parsed;
+        ASSERT(h11_simd_from_name(h11_simd_name((h11_simd_level_t)lv), &parsed));
+        ASSERT(parsed == (h11_simd_level_t)lv);
+    }
+    h11_simd_level_t parsed = H11_SIMD_AVX2;
+    ASSERT(!h11_simd_from_name("avx1024", &parsed));
+    ASSERT(!h11_simd_from_name("", &parsed));
+    ASSERT(parsed == H11_SIMD_AVX2);
+    ASSERT(strcmp(h11_simd_name((h11_simd_level_t)42), "unknown") == 0);
+    PASS();
+}
+
+static void test_simd_force(void) {
+    TEST(simd_force_clamps_to_supported);
+    ASSERT(h11_simd_force(H11_SIMD_SCALAR) == H11_SIMD_SCALAR);
+    ASSERT(h11_simd_active() == H11_SIMD_SCALAR);
+    h11_init();
+    ASSERT(h11_simd_active() == H11_SIMD_SCALAR);
+    ASSERT(h11_simd_force(H11_SIMD_AVX512) == detected_level);
+    ASSERT(h11_simd_force((h11_simd_level_t)42) == detected_level);
+    ASSERT(h11_simd_active() == detected_level);
+    PASS();
+}
+
+static void test_simd_calibrate(void) {
+    TEST(simd_calibrate_records_choice);
+    h11_simd_calibration_t c, rec;
+    h11_simd_level_t chosen = h11_simd_calibrate(&c);
+    ASSERT(chosen == c.chosen);
+    ASSERT(h11_simd_active() == chosen);
+    ASSERT(c.supported == detected_level);
+    ASSERT(c.chosen <= c.supported);
+    for (int lv = H11_SIMD_SCALAR; lv <= H11_SIMD_AVX512; lv++)
+        ASSERT(lv <= (int)c.supported ? c.mb_per_s[lv] > 0 : c.mb_per_s[lv] == 0);
+    ASSERT(c.elapsed_ns > 0 && c.elapsed_ns < 50000000u);
+    ASSERT(h11_simd_calibration(&rec));
+    ASSERT(memcmp(&rec, &c, sizeof(c)) == 0);
+    ASSERT(!h11_simd_calibration(NULL));
+    h11_simd_force(detected_level);
+    PASS();
+}
+
+static void test_find_char_every_position(void) {
+    TEST(find_char_every_position_and_offset);
+    char buf[300];
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize off = 0; off < 8; off++) {
+            for (usize len = 0; len < 200; len++) {
+                memset(buf, 'a', sizeof(buf));
+                ASSERT(h11_find_char(buf + off, len, ':') == len);
+                for (usize hit = 0; hit < len; hit += 7) {
+                    buf[off + hit] = ':';
+                    ASSERT(h11_find_char(buf + off, len, ':') == ref_find_char(buf + off, len, ':'));
+                }
+            }
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+static void test_find_char_nul_past_len(void) {
+    TEST(find_char_nul_never_matches_past_len);
+    char buf[160];
+    memset(buf, 'a', sizeof(buf));
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize len = 0; len < 100; len++) {
+            ASSERT(h11_find_char(buf, len, '\0') == len);
+            ASSERT(h11_find_char2(buf, len, '\0', 'b') == len);
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+/* Bytes drawn from a small alphabet around the targets (NUL, 0x80, 0xFF,
+ * CR, LF) so that every SWAR borrow and sign case is hit often. */
+static void test_scanners_random(void) {
+    TEST(scanners_match_reference_on_random_bytes);
+    static const char alphabet[] = { '\r', '\n', ':', ' ', '\0', (char)0x80, (char)0xFF,
+                                     (char)0x8D, 0x0C, 0x0E, 'a' };
+    char buf[160];
+    u32 seed = 12345;
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (int iter = 0; iter < 3000; iter++) {
+            usize len = (usize)(iter % 150);
+            for (usize i = 0; i < len; i++) {
+                seed = seed * 1103515245u + 12345u;
+                buf[i] = alphabet[(seed >> 16) % sizeof(alphabet)];
+            }
+            char c = alphabet[iter % sizeof(alphabet)];
+            char c2 = alphabet[(iter / 3) % sizeof(alphabet)];
+            usize want2 = ref_find_char(buf, len, c);
+            usize other = ref_find_char(buf, len, c2);
+            if (other < want2)
+                want2 = other;
+            ASSERT(h11_find_char(buf, len, c) == ref_find_char(buf, len, c));
+            ASSERT(h11_find_char2(buf, len, c, c2) == want2);
+            ASSERT(h11_find_crlf(buf, len) == ref_find_crlf(buf, len));
+            ASSERT(h11_find_nonascii(buf, len) == ref_find_nonascii(buf, len));
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+/* Per-byte reference for h11_classify_block. */
+static void ref_classify(const char *d, usize len, bool strict, bool obs, u64 *nt, u64 *bv,
+                         u64 *eol) {
+    memset(nt, 0, (len + 63) / 64 * 8);
+    memset(bv, 0, (len + 63) / 64 * 8);
+    memset(eol, 0, (len + 63) / 64 * 8);
+    for (usize i = 0; i < len; i++) {
+        u8 c = (u8)d[i];
+        u64 bit = 1ull << (i & 63);
+        if (!h11_is_tchar((char)c))
+            nt[i / 64] |= bit;
+        if (!h11_is_vchar((char)c) || (c >= 0x80 && !obs))
+            bv[i / 64] |= bit;
+        if (c == '\n' && (!strict || (i > 0 && d[i - 1] == '\r')))
+            eol[i / 64] |= bit;
+    }
+}
+
+static void test_classify_block(void) {
+    TEST(classify_block_matches_reference);
+    static const char alphabet[] = { '\r', '\n', ':', ' ', '\t', '\0', 0x7F, (char)0x80,
+                                     (char)0xFF, '"', '~', 'a', 'Z', '{' };
+    char buf[300];
+    u64 nt[5], bv[5], eol[5], rnt[5], rbv[5], reol[5];
+    u32 seed = 777;
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (int flags = 0; flags < 4; flags++) {
+            bool strict = flags & 1, obs = flags & 2;
+            /* Every byte value at every lane of a full and a partial word. */
+            for (usize i = 0; i < 256; i++)
+                buf[i] = (char)(i * 7 + 3);
+            for (usize len = 250; len <= 256; len += 6) {
+                h11_classify_block(buf, len, strict, obs, nt, bv, eol);
+                ref_classify(buf, len, strict, obs, rnt, rbv, reol);
+                ASSERT(memcmp(nt, rnt, (len + 63) / 64 * 8) == 0);
+                ASSERT(memcmp(bv, rbv, (len + 63) / 64 * 8) == 0);
+                ASSERT(memcmp(eol, reol, (len + 63) / 64 * 8) == 0);
+            }
+            for (int iter = 0; iter < 500; iter++) {
+                usize len = 1 + (usize)(iter * 37 % 299);
+                for (usize i = 0; i < len; i++) {
+                    seed = seed * 1103515245u + 12345u;
+                    buf[i] = alphabet[(seed >> 16) % sizeof(alphabet)];
+                }
+                h11_classify_block(buf, len, strict, obs, nt, bv, eol);
+                ref_classify(buf, len, strict, obs, rnt, rbv, reol);
+                ASSERT(memcmp(nt, rnt, (len + 63) / 64 * 8) == 0);
+                ASSERT(memcmp(bv, rbv, (len + 63) / 64 * 8) == 0);
+                ASSERT(memcmp(eol, reol, (len + 63) / 64 * 8) == 0);
+            }
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+static void test_find_char2(void) {
+    TEST(find_char2_first_of_either);
+    const char *s = "username=admin&password=1234";
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        ASSERT(h11_find_char2(s, strlen(s), '&', '=') == 8);
+        ASSERT(h11_find_char2(s + 9, strlen(s) - 9, '&', '=') == 5);
+        ASSERT(h11_find_char2(s, strlen(s), '%', '+') == strlen(s));
+        ASSERT(h11_find_char2(s, 0, '&', '=') == 0);
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+static void test_find_crlf_lone_cr(void) {
+    TEST(find_crlf_skips_lone_cr);
+    char buf[256];
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize len = 2; len < sizeof(buf); len++) {
+            memset(buf, 'x', sizeof(buf));
+            for (usize i = 0; i < len; i += 5)
+                buf[i] = '\r';
+            buf[len - 2] = '\r';
+            buf[len - 1] = '\n';
+            ASSERT(h11_find_crlf(buf, len) == ref_find_crlf(buf, len));
+            ASSERT(h11_find_crlf(buf, len - 1) == len - 1);
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+static void test_find_crlf_block_boundary(void) {
+    TEST(find_crlf_cr_lf_across_vector_boundary);
+    char buf[192];
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        const usize bounds[] = { 15, 31, 63, 127 };
+        for (usize b = 0; b < H11_ARRAY_LEN(bounds); b++) {
+            memset(buf, 'x', sizeof(buf));
+            buf[bounds[b]] = '\r';
+            buf[bounds[b] + 1] = '\n';
+            ASSERT(h11_find_crlf(buf, sizeof(buf)) == bounds[b]);
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+/* Padding full of targets must never produce a hit at or past len. */
+static void test_padded_scanners(void) {
+    TEST(padded_scanners_match_reference);
+    static const char pat[] = "ab:c\rd\r\nef:\n";
+    char buf[256 + H11_INPUT_PADDING];
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize len = 0; len <= 256; len++) {
+            for (usize i = 0; i < sizeof(buf); i++)
+                buf[i] = i < len ? pat[(i * 7 + len) % (sizeof(pat) - 1)] : (i & 1 ? '\n' : '\r');
+            for (usize off = 0; off + 1 <= len && off < 4; off++) {
+                ASSERT(h11_find_char_padded(buf + off, len - off, ':') ==
+                       ref_find_char(buf + off, len - off, ':'));
+                ASSERT(h11_find_crlf_padded(buf + off, len - off) ==
+                       ref_find_crlf(buf + off, len - off));
+            }
+            memset(buf, 'x', len);
+            ASSERT(h11_find_char_padded(buf, len, '\r') == len);
+            ASSERT(h11_find_crlf_padded(buf, len) == len);
+            if (len > 0) {
+                buf[len - 1] = '\r';
+                ASSERT(h11_find_crlf_padded(buf, len) == len);
+            }
+        }
+    }
+    h11_simd_level = detected_level;
+    PASS();
+}
+
+/* Two pages with one of them PROT_NONE: input placed flush against the
+ * guard must be scanned without touching it. */
+static char *map_guarded(bool guard_after, usize *page) {
+    long ps = sysconf(_SC_PAGESIZE);
+    *page = (usize)ps;
+    char *m = mmap(NULL, 2 * (usize)ps, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+        return NULL;
+    if (mprotect(guard_after ? m + ps : m, (usize)ps, PROT_NONE) != 0) {
+        munmap(m, 2 * (usize)ps);
+        return NULL;
+    }
+    return guard_after ? m : m + ps;
+}
+
+static void unmap_guarded(char *page_start, bool guard_after, usize page) {
+    munmap(guard_after ? page_start : page_start - page, 2 * page);
+}
+
+static void test_guard_page_end(void) {
+    TEST(scanners_stop_at_guard_page_after_input);
+    usize page;
+    char *pg = map_guarded(true, &page);
+    ASSERT(pg != NULL);
+    memset(pg, 'a', page);
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize len = 0; len <= 200; len++) {
+            char *d = pg + page - len;
+            ASSERT(h11_find_char(d, len, ':') == len);
+            ASSERT(h11_find_char2(d, len, ':', '\0') == len);
+            ASSERT(h11_find_crlf(d, len) == len);
+            ASSERT(h11_find_nonascii(d, len) == len);
+            if (len >= 2) {
+                d[len - 2] = '\r';
+                d[len - 1] = '\n';
+                ASSERT(h11_find_crlf(d, len) == len - 2);
+                ASSERT(h11_find_char(d, len, '\n') == len - 1);
+                d[len - 2] = d[len - 1] = 'a';
+            }
+            if (len >= 1) {
+                d[len - 1] = '\r';
+                ASSERT(h11_find_crlf(d, len) == len);
+                ASSERT(h11_find_char2(d, len, '\r', 'z') == len - 1);
+                d[len - 1] = (char)0xC3;
+                ASSERT(h11_find_nonascii(d, len) == len - 1);
+                d[len - 1] = 'a';
+            }
+        }
+    }
+    h11_simd_level = detected_level;
+    unmap_guarded(pg, true, page);
+    PASS();
+}
+
+static void test_guard_page_start(void) {
+    TEST(scanners_stop_at_guard_page_before_input);
+    usize page;
+    char *pg = map_guarded(false, &page);
+    ASSERT(pg != NULL);
+    memset(pg, 'a', page);
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_level = (h11_simd_level_t)lv;
+        for (usize len = 0; len <= 200; len++) {
+            ASSERT(h11_find_char(pg, len, ':') == len);
+            ASSERT(h11_find_char2(pg, len, ':', '\0') == len);
+            ASSERT(h11_find_crlf(pg, len) == len);
+            ASSERT(h11_find_nonascii(pg, len) == len);
+            if (len >= 1) {
+                pg[0] = ':';
+                ASSERT(h11_find_char(pg, len, ':') == 0);
+                pg[0] = 'a';
+            }
+        }
+    }
+    h11_simd_level = detected_level;
+    unmap_guarded(pg, false, page);
+    PASS();
+}
+
+int main(void) {
+    h11_init();
+    detected_level = h11_simd_supported();
+
+    printf("=== init ===\n");
+    test_init_idempotent();
+    test_simd_names();
+    test_simd_force();
+    test_simd_calibrate();
+
+    printf("=== find_char ===\n");
+    test_find_char_every_position();
+    test_find_char_nul_past_len();
+    test_scanners_random();
+    test_find_char2();
+
+    printf("=== find_crlf ===\n");
+    test_find_crlf_lone_cr();
+    test_find_crlf_block_boundary();
+
+    printf("=== padded input ===\n");
+    test_padded_scanners();
+
+    printf("=== header block ===\n");
+    test_classify_block();
+
+    printf("=== guard pages ===\n");
+    test_guard_page_end();
+    test_guard_page_start();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
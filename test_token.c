@@ -0,0 +1,132 @@
+/*
+ * test_token.c — Tests for comma-separated list iteration
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define SPAN_IS(base, s, lit) \
+    ((s).len == strlen(lit) && memcmp((base) + (s).off, (lit), (s).len) == 0)
+
+static h11_span_t whole(const char *s) {
+    return (h11_span_t){ .off = 0, .len = (u32)strlen(s) };
+}
+
+static void test_token_plain_list(void) {
+    TEST(token_plain_list_with_ows);
+    const char *v = " keep-alive ,Upgrade,\tclose\t";
+    h11_token_iter_t it;
+    h11_token_t t;
+    h11_token_iter_init(&it, v, whole(v));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "keep-alive"));
+    ASSERT(t.weight == 1000 && t.flags == 0 && t.params.len == 0);
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "Upgrade"));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "close"));
+    ASSERT(!h11_token_next(&it, &t));
+    PASS();
+}
+
+static void test_token_empty_elements(void) {
+    TEST(token_skips_empty_elements);
+    const char *v = ",, gzip ,, ,chunked,";
+    h11_token_iter_t it;
+    h11_token_t t;
+    h11_token_iter_init(&it, v, whole(v));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "gzip"));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "chunked"));
+    ASSERT(!h11_token_next(&it, &t));
+
+    /* Parameter-only elements carry no token and are skipped too. */
+    v = ";q=0.5, br ;q=1,; a=b , ;";
+    h11_token_iter_init(&it, v, whole(v));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "br") && t.weight == 1000);
+    ASSERT(!h11_token_next(&it, &t));
+    h11_token_iter_init(&it, v, (h11_span_t){ .off = 0, .len = 6 });
+    ASSERT(!h11_token_next(&it, &t));
+    PASS();
+}
+
+static void test_token_weights(void) {
+    TEST(token_q_weights_and_params);
+    const char *v = "br;q=1.0, gzip ; q=0.8, deflate;level=9;Q=0.125, identity;q=0";
+    h11_token_iter_t it;
+    h11_token_t t;
+    h11_token_iter_init(&it, v, whole(v));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "br") && t.weight == 1000);
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "gzip") && t.weight == 800);
+    ASSERT(SPAN_IS(v, t.params, "q=0.8"));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "deflate") && t.weight == 125);
+    ASSERT((t.flags & H11_TOKEN_F_HAS_PARAMS) && SPAN_IS(v, t.params, "level=9;Q=0.125"));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "identity") && t.weight == 0);
+    ASSERT(!(t.flags & H11_TOKEN_F_BAD_WEIGHT));
+    PASS();
+}
+
+static void test_token_bad_weights(void) {
+    TEST(token_invalid_q_values);
+    const char *bad[] = { "a;q=1.5", "a;q=2", "a;q=0.1234", "a;q=", "a;q=.5" };
+    for (usize i = 0; i < H11_ARRAY_LEN(bad); i++) {
+        h11_token_iter_t it;
+        h11_token_t t;
+        h11_token_iter_init(&it, bad[i], whole(bad[i]));
+        ASSERT(h11_token_next(&it, &t));
+        ASSERT(t.flags & H11_TOKEN_F_BAD_WEIGHT);
+        ASSERT(t.weight == 0);
+    }
+    PASS();
+}
+
+static void test_token_quoted_comma(void) {
+    TEST(token_quoted_string_hides_comma);
+    const char *v = "text/html;x=\"a,\\\"b\", */*;q=0.1";
+    h11_token_iter_t it;
+    h11_token_t t;
+    h11_token_iter_init(&it, v, whole(v));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "text/html"));
+    ASSERT(SPAN_IS(v, t.params, "x=\"a,\\\"b\""));
+    ASSERT(h11_token_next(&it, &t) && SPAN_IS(v, t.token, "*/*") && t.weight == 100);
+    ASSERT(!h11_token_next(&it, &t));
+    PASS();
+}
+
+static void test_token_list_has(void) {
+    TEST(token_list_has_case_insensitive);
+    const char *v = "Connection: keep-alive, Upgrade";
+    h11_span_t value = { .off = 12, .len = (u32)strlen(v) - 12 };
+    ASSERT(h11_token_list_has(v, value, "upgrade"));
+    ASSERT(h11_token_list_has(v, value, "KEEP-ALIVE"));
+    ASSERT(!h11_token_list_has(v, value, "close"));
+    ASSERT(!h11_token_list_has(v, value, "keep"));
+    ASSERT(!h11_token_list_has(NULL, value, "close"));
+    PASS();
+}
+
+int main(void) {
+    h11_init();
+
+    printf("=== token iterator ===\n");
+    test_token_plain_list();
+    test_token_empty_elements();
+    test_token_weights();
+    test_token_bad_weights();
+    test_token_quoted_comma();
+
+    printf("=== token_list_has ===\n");
+    test_token_list_has();
+
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
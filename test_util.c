@@ -246,6 +246,31 @@ static void test_find_header(void) {
     PASS();
 }
 
+static void test_find_header_next(void) {
+    TEST(find_header_next_repeated);
+    const char base[] =
+        "Cookie\0"
+        "a=1\0"
+        "Host\0"
+        "x\0"
+        "cookie\0"
+        "b=2\0";
+    h11_header_t hdrs[3] = {
+        { .name = { .off = 0, .len = 6 }, .value = { .off = 7, .len = 3 },
+          .name_id = H11_INDEX_NONE, .flags = 0 },
+        { .name = { .off = 11, .len = 4 }, .value = { .off = 16, .len = 1 },
+          .name_id = H11_KHDR_HOST, .flags = H11_HEADER_F_KNOWN_NAME },
+        { .name = { .off = 18, .len = 6 }, .value = { .off = 25, .len = 3 },
+          .name_id = H11_INDEX_NONE, .flags = 0 },
+    };
+    h11_request_t req = { .headers = hdrs, .header_count = 3 };
+    ASSERT(h11_find_header_next(&req, base, "COOKIE", -1) == 0);
+    ASSERT(h11_find_header_next(&req, base, "cookie", 0) == 2);
+    ASSERT(h11_find_header_next(&req, base, "cookie", 2) == -1);
+    ASSERT(h11_find_header_next(&req, base, "cookie", -2) == -1);
+    PASS();
+}
+
 static void test_find_header_empty(void) {
     TEST(find_header_empty_list);
     h11_request_t req = { .headers = NULL, .header_count = 0 };
@@ -319,6 +344,48 @@ static void test_error_all_non_null(void) {
     PASS();
 }
 
+static void test_error_status(void) {
+    TEST(error_status_mapping);
+    ASSERT(h11_error_status(H11_OK) == 0);
+    ASSERT(h11_error_status(H11_NEED_MORE_DATA) == 0);
+    ASSERT(h11_error_status(H11_ERR_INVALID_METHOD) == 400);
+    ASSERT(h11_error_status(H11_ERR_TE_CL_CONFLICT) == 400);
+    ASSERT(h11_error_status(H11_ERR_HEADERS_TOO_LARGE) == 431);
+    ASSERT(h11_error_status(H11_ERR_TOO_MANY_HEADERS) == 431);
+    ASSERT(h11_error_status(H11_ERR_BODY_TOO_LARGE) == 413);
+    ASSERT(h11_error_status(H11_ERR_UNKNOWN_TRANSFER_CODING) == 501);
+    ASSERT(h11_error_status(H11_ERR_RANGE_NOT_SATISFIABLE) == 416);
+    ASSERT(h11_error_status(H11_ERR_INVALID_RANGE) == 0);
+    ASSERT(h11_error_status(H11_ERR_INTERNAL) == 500);
+    ASSERT(h11_error_status((h11_error_t)999) == 0);
+    PASS();
+}
+
+static void test_error_response(void) {
+    TEST(error_response_bytes);
+    usize len = 99;
+    const char *r = h11_error_response(H11_ERR_BODY_TOO_LARGE, &len);
+    const char *want = "HTTP/1.1 413 Content Too Large\r\nConnection: close\r\n"
+                       "Content-Length: 0\r\n\r\n";
+    ASSERT(r != NULL && len == strlen(want) && memcmp(r, want, len) == 0);
+    ASSERT(h11_error_response(H11_OK, &len) == NULL && len == 0);
+    ASSERT(h11_error_response(H11_ERR_TOO_MANY_RANGES, NULL) == NULL);
+    ASSERT(h11_error_response((h11_error_t)-1, &len) == NULL);
+    for (int i = 0; i < H11_ERR__COUNT; i++) {
+        u16 status = h11_error_status((h11_error_t)i);
+        r = h11_error_response((h11_error_t)i, &len);
+        ASSERT((r == NULL) == (status == 0));
+        if (r == NULL)
+            continue;
+        char line[16];
+        snprintf(line, sizeof(line), "HTTP/1.1 %u ", status);
+        ASSERT(len == strlen(r) && strncmp(r, line, strlen(line)) == 0);
+        ASSERT(strstr(r, "\r\nConnection: close\r\n") != NULL);
+        ASSERT(len >= 4 && memcmp(r + len - 4, "\r\n\r\n", 4) == 0);
+    }
+    PASS();
+}
+
 int main(void) {
     printf("=== tchar table ===\n");
     test_tchar_special_symbols();
@@ -363,6 +430,7 @@ int main(void) {
 
     printf("=== find_header ===\n");
     test_find_header();
+    test_find_header_next();
     test_find_header_empty();
 
     printf("=== error_name / error_message ===\n");
@@ -373,6 +441,10 @@ int main(void) {
     test_error_out_of_range();
     test_error_all_non_null();
 
+    printf("=== error_status / error_response ===\n");
+    test_error_status();
+    test_error_response();
+
     printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
     return tests_failed ? 1 : 0;
 }
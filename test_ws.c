@@ -0,0 +1,383 @@
+/*
+ * test_ws.c — Tests for the WebSocket handshake and frame codec
+ */
+#include "h11_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) do { printf("  %-50s ", #name); } while (0)
+#define PASS() do { printf("OK\n"); tests_passed++; } while (0)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL (%s:%d: %s)\n", __FILE__, __LINE__, #cond); \
+        tests_failed++; \
+        return; \
+    } \
+} while (0)
+
+#define FOR_EACH_LEVEL(lv) \
+    for (int lv = H11_SIMD_SCALAR; lv <= (int)h11_simd_supported(); lv++)
+
+static h11_parser_t *parser;
+static const u8 mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+static h11_error_t accept_for(const char *raw, char *accept) {
+    usize used = 0;
+    h11_parser_reset(parser);
+    if (h11_parse(parser, raw, strlen(raw), &used) != H11_OK)
+        return H11_ERR_INTERNAL;
+    return h11_ws_accept(h11_get_request(parser), raw, accept);
+}
+
+#define WS_REQ(extra) \
+    "GET /chat HTTP/1.1\r\nHost: server.example.com\r\nUpgrade: websocket\r\n" \
+    "Connection: Upgrade\r\n" extra "\r\n"
+#define WS_KEY "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+#define WS_V13 "Sec-WebSocket-Version: 13\r\n"
+
+static void test_accept(void) {
+    TEST(handshake_accept_rfc_example);
+    char accept[H11_WS_ACCEPT_LEN];
+    ASSERT(accept_for(WS_REQ(WS_KEY WS_V13), accept) == H11_OK);
+    ASSERT(memcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", H11_WS_ACCEPT_LEN) == 0);
+    char resp[H11_WS_RESPONSE_LEN];
+    const char *want = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Accept: "
+                       "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+    ASSERT(h11_ws_response(accept, resp) == strlen(want));
+    ASSERT(memcmp(resp, want, strlen(want)) == 0);
+
+    const char *raw = "GET / HTTP/1.1\r\nHost: a\r\nConnection: keep-alive, Upgrade\r\n"
+                      "Upgrade: WebSocket\r\nSec-WebSocket-Version: 13\r\n"
+                      "Sec-WebSocket-Key: x3JJHMbDL1EzLkh9GBhXDw==\r\n\r\n";
+    ASSERT(accept_for(raw, accept) == H11_OK);
+    ASSERT(memcmp(accept, "HSmrc0sMlYUkAGmm5OPpG2HaGWk=", H11_WS_ACCEPT_LEN) == 0);
+    PASS();
+}
+
+static void test_handshake_rejects(void) {
+    TEST(handshake_rejects_invalid_requests);
+    char accept[H11_WS_ACCEPT_LEN];
+    static const char *const bad[] = {
+        "POST / HTTP/1.1\r\nHost: a\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        WS_KEY WS_V13 "Content-Length: 0\r\n\r\n",
+        "GET / HTTP/1.0\r\nHost: a\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        WS_KEY WS_V13 "\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nUpgrade: h2c\r\nConnection: Upgrade\r\n" WS_KEY WS_V13
+        "\r\n",
+        "GET / HTTP/1.1\r\nHost: a\r\nUpgrade: websocket\r\nConnection: keep-alive\r\n"
+        WS_KEY WS_V13 "\r\n",
+        WS_REQ(WS_V13),
+        WS_REQ(WS_KEY WS_KEY WS_V13),
+        WS_REQ(WS_V13 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ=\r\n"),
+        WS_REQ(WS_V13 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZR==\r\n"),
+        WS_REQ(WS_V13 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub2*jZQ==\r\n"),
+        WS_REQ(WS_KEY),
+    };
+    for (usize i = 0; i < H11_ARRAY_LEN(bad); i++)
+        ASSERT(accept_for(bad[i], accept) == H11_ERR_WS_HANDSHAKE);
+    ASSERT(accept_for(WS_REQ(WS_KEY "Sec-WebSocket-Version: 8\r\n"), accept) ==
+           H11_ERR_WS_VERSION);
+    ASSERT(accept_for(WS_REQ(WS_KEY WS_V13 WS_V13), accept) == H11_ERR_WS_VERSION);
+    ASSERT(h11_error_status(H11_ERR_WS_VERSION) == 426);
+    usize len = 0;
+    const char *r = h11_error_response(H11_ERR_WS_VERSION, &len);
+    ASSERT(r != NULL && strstr(r, "\r\nSec-WebSocket-Version: 13\r\n") != NULL);
+    PASS();
+}
+
+/* Appends one client frame (masked with the test mask) to buf. */
+static usize put_frame(char *buf, usize pos, h11_ws_opcode_t op, bool fin, const char *payload,
+                       usize len) {
+    pos += h11_ws_frame_header(buf + pos, op, fin, len, mask);
+    memcpy(buf + pos, payload, len);
+    h11_ws_mask(buf + pos, len, mask, 0);
+    return pos + len;
+}
+
+static void test_frame_header(void) {
+    TEST(frame_header_lengths);
+    char h[H11_WS_HEADER_MAX];
+    ASSERT(h11_ws_frame_header(h, H11_WS_TEXT, true, 5, NULL) == 2);
+    ASSERT((u8)h[0] == 0x81 && (u8)h[1] == 0x05);
+    ASSERT(h11_ws_frame_header(h, H11_WS_BINARY, false, 125, mask) == 6);
+    ASSERT((u8)h[0] == 0x02 && (u8)h[1] == 0xFD && memcmp(h + 2, mask, 4) == 0);
+    ASSERT(h11_ws_frame_header(h, H11_WS_BINARY, true, 126, NULL) == 4);
+    ASSERT((u8)h[1] == 126 && (u8)h[2] == 0 && (u8)h[3] == 126);
+    ASSERT(h11_ws_frame_header(h, H11_WS_BINARY, true, 65535, NULL) == 4);
+    ASSERT(h11_ws_frame_header(h, H11_WS_BINARY, true, 65536, mask) == H11_WS_HEADER_MAX);
+    ASSERT((u8)h[1] == 0xFF && (u8)h[7] == 1 && (u8)h[8] == 0 && (u8)h[9] == 0);
+    PASS();
+}
+
+static void test_parse_messages(void) {
+    TEST(parse_fragmented_text_with_ping);
+    static char buf[70000 + 256];
+    static char big[70000];
+    for (usize i = 0; i < sizeof(big); i++)
+        big[i] = (char)(i * 7 + 1);
+    usize n = 0;
+    n = put_frame(buf, n, H11_WS_TEXT, false, "Hel", 3);
+    n = put_frame(buf, n, H11_WS_PING, true, "p1", 2);
+    n = put_frame(buf, n, H11_WS_CONTINUATION, true, "lo \xE2\x82\xAC", 6);
+    n = put_frame(buf, n, H11_WS_BINARY, true, big, sizeof(big));
+    n = put_frame(buf, n, H11_WS_TEXT, true, "", 0);
+    n = put_frame(buf, n, H11_WS_CLOSE, true, "\x03\xE8" "bye", 5);
+
+    /* Whole buffer at once, then one byte per call. */
+    for (int pass = 0; pass < 2; pass++) {
+        char in[sizeof(buf)];
+        memcpy(in, buf, n);
+        h11_ws_t ws;
+        h11_ws_init(&ws, true, UINT64_MAX);
+        char text[16];
+        usize text_len = 0, bin_len = 0, off = 0;
+        int pings = 0, closes = 0, texts = 0;
+        bool bin_ok = true;
+        while (off < n) {
+            usize avail = pass == 0 ? n - off : 1;
+            usize used = 0;
+            h11_ws_frame_t f;
+            h11_error_t err = h11_ws_parse(&ws, in + off, avail, &used, &f);
+            off += used;
+            if (err == H11_NEED_MORE_DATA) {
+                ASSERT(used == avail);
+                continue;
+            }
+            ASSERT(err == H11_OK);
+            if (f.opcode == H11_WS_PING) {
+                ASSERT(f.len == 2 && memcmp(f.data, "p1", 2) == 0 && f.end);
+                pings++;
+            } else if (f.opcode == H11_WS_CLOSE) {
+                ASSERT(f.len == 5 && memcmp(f.data + 2, "bye", 3) == 0);
+                closes++;
+            } else if (f.message == H11_WS_TEXT) {
+                ASSERT(text_len + f.len <= sizeof(text));
+                memcpy(text + text_len, f.data, f.len);
+                text_len += f.len;
+                if (f.end && f.fin) {
+                    texts++;
+                    ASSERT(texts == 2 || text_len == 9);
+                    ASSERT(texts == 2 || memcmp(text, "Hello \xE2\x82\xAC", 9) == 0);
+                    text_len = 0;
+                }
+            } else {
+                ASSERT(f.message == H11_WS_BINARY && f.length == sizeof(big));
+                bin_ok = bin_ok && memcmp(f.data, big + bin_len, f.len) == 0;
+                bin_len += f.len;
+            }
+        }
+        ASSERT(pings == 1 && closes == 1 && texts == 2 && bin_ok && bin_len == sizeof(big));
+        usize used = 0;
+        h11_ws_frame_t f;
+        ASSERT(h11_ws_parse(&ws, in, 2, &used, &f) == H11_ERR_CONNECTION_CLOSED);
+    }
+
+    /* A client parser takes unmasked server frames. */
+    h11_ws_t ws;
+    h11_ws_init(&ws, false, 16);
+    n = h11_ws_frame_header(buf, H11_WS_BINARY, true, 4, NULL);
+    memcpy(buf + n, "abcd", 4);
+    usize used = 0;
+    h11_ws_frame_t f;
+    ASSERT(h11_ws_parse(&ws, buf, n + 2, &used, &f) == H11_OK && used == n + 2);
+    ASSERT(f.len == 2 && !f.end && memcmp(f.data, "ab", 2) == 0);
+    ASSERT(h11_ws_parse(&ws, buf + n + 2, 2, &used, &f) == H11_OK && f.end && f.len == 2);
+    PASS();
+}
+
+/* Parses one buffer of client frames and returns the first error, or OK
+ * once it is used up. */
+static h11_error_t parse_all(char *buf, usize n, u64 max) {
+    h11_ws_t ws;
+    h11_ws_init(&ws, true, max);
+    usize off = 0;
+    while (off < n) {
+        usize used = 0;
+        h11_ws_frame_t f;
+        h11_error_t err = h11_ws_parse(&ws, buf + off, n - off, &used, &f);
+        if (err != H11_OK && err != H11_NEED_MORE_DATA)
+            return err;
+        off += used;
+        if (err == H11_NEED_MORE_DATA)
+            break;
+    }
+    return H11_OK;
+}
+
+static void test_parse_errors(void) {
+    TEST(parse_protocol_violations);
+    char buf[512];
+    usize n;
+
+    n = h11_ws_frame_header(buf, H11_WS_TEXT, true, 0, NULL);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_TEXT, true, "a", 1);
+    buf[0] |= 0x40;
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, (h11_ws_opcode_t)0x3, true, "a", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, (h11_ws_opcode_t)0xB, true, "a", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_PING, false, "a", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    char pad[126] = { 0 };
+    n = put_frame(buf, 0, H11_WS_PING, true, pad, sizeof(pad));
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_CONTINUATION, true, "a", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_TEXT, false, "a", 1);
+    n = put_frame(buf, n, H11_WS_BINARY, true, "b", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    /* 16-bit length field carrying a 7-bit length. */
+    const char nonmin[] = { (char)0x82, (char)0xFE, 0, 5, 1, 2, 3, 4, 'a', 'b', 'c', 'd', 'e' };
+    memcpy(buf, nonmin, sizeof(nonmin));
+    ASSERT(parse_all(buf, sizeof(nonmin), UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+
+    n = put_frame(buf, 0, H11_WS_BINARY, false, "abcd", 4);
+    n = put_frame(buf, n, H11_WS_CONTINUATION, true, "efgh", 4);
+    ASSERT(parse_all(buf, n, 8) == H11_OK);
+    ASSERT(parse_all(buf, n, 7) == H11_ERR_WS_MESSAGE_TOO_LARGE);
+
+    n = put_frame(buf, 0, H11_WS_CLOSE, true, "\x03", 1);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_CLOSE, true, "\x03\xED", 2);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_PROTOCOL);
+    n = put_frame(buf, 0, H11_WS_CLOSE, true, "\x03\xE8\xC0\x80", 4);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_INVALID_UTF8);
+    n = put_frame(buf, 0, H11_WS_CLOSE, true, "\x0F\xA0", 2);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_OK);
+
+    /* A sequence split across frames is fine; one cut off at the end of
+     * the message is not. Errors stick. */
+    n = put_frame(buf, 0, H11_WS_TEXT, false, "\xF0\x9F", 2);
+    n = put_frame(buf, n, H11_WS_CONTINUATION, true, "\x98\x80", 2);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_OK);
+    n = put_frame(buf, 0, H11_WS_TEXT, true, "ok\xE2\x82", 4);
+    ASSERT(parse_all(buf, n, UINT64_MAX) == H11_ERR_WS_INVALID_UTF8);
+    n = put_frame(buf, 0, H11_WS_TEXT, false, "\xED\xA0\x80", 3);
+    h11_ws_t ws;
+    h11_ws_init(&ws, true, UINT64_MAX);
+    usize used = 0;
+    h11_ws_frame_t f;
+    ASSERT(h11_ws_parse(&ws, buf, n, &used, &f) == H11_ERR_WS_INVALID_UTF8);
+    ASSERT(h11_ws_parse(&ws, buf, n, &used, &f) == H11_ERR_WS_INVALID_UTF8 && used == 0);
+
+    ASSERT(h11_ws_close_code(H11_ERR_WS_PROTOCOL) == 1002);
+    ASSERT(h11_ws_close_code(H11_ERR_WS_INVALID_UTF8) == 1007);
+    ASSERT(h11_ws_close_code(H11_ERR_WS_MESSAGE_TOO_LARGE) == 1009);
+    ASSERT(h11_ws_close_code(H11_OK) == 0);
+    PASS();
+}
+
+/* Code-point decoder used as the reference validator. */
+static bool ref_utf8(const u8 *s, usize n) {
+    usize i = 0;
+    while (i < n) {
+        u32 c = s[i], need, min;
+        if (c < 0x80) {
+            i++;
+            continue;
+        } else if ((c & 0xE0) == 0xC0) {
+            need = 1, min = 0x80, c &= 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            need = 2, min = 0x800, c &= 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            need = 3, min = 0x10000, c &= 0x07;
+        } else {
+            return false;
+        }
+        if (i + need >= n)
+            return false;
+        for (u32 k = 1; k <= need; k++) {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return false;
+            c = c << 6 | (s[i + k] & 0x3F);
+        }
+        if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+            return false;
+        i += need + 1;
+    }
+    return true;
+}
+
+static void test_utf8_random(void) {
+    TEST(text_utf8_matches_reference_every_level);
+    static const u8 pieces[][4] = {
+        { 'a' }, { ' ' }, { 0xC3, 0xA9 }, { 0xE2, 0x82, 0xAC }, { 0xF0, 0x9F, 0x98, 0x80 },
+        { 0xED, 0x9F, 0xBF }, { 0xF4, 0x8F, 0xBF, 0xBF }, { 0x80 }, { 0xC0 }, { 0xED, 0xA0 },
+        { 0xF4, 0x90 }, { 0xFF }, { 0xE0, 0x9F },
+    };
+    static const u8 piece_len[] = { 1, 1, 2, 3, 4, 3, 4, 1, 1, 2, 2, 1, 2 };
+    u8 text[200];
+    char frame[256];
+    u32 seed = 7;
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_force((h11_simd_level_t)lv);
+        for (int iter = 0; iter < 2000; iter++) {
+            usize len = 0;
+            while (len < 180) {
+                seed = seed * 1103515245u + 12345u;
+                u32 r = (seed >> 16) % 64;
+                usize k = r < 40 ? 0 : 1 + r % 6;
+                if (r == 63 && iter % 8 == 0)
+                    k = 7 + (seed >> 8) % 6;
+                memcpy(text + len, pieces[k], piece_len[k]);
+                len += piece_len[k];
+            }
+            len -= (usize)(iter % 4);
+            usize n = put_frame(frame, 0, H11_WS_TEXT, true, (const char *)text, len);
+            bool ok = parse_all(frame, n, UINT64_MAX) == H11_OK;
+            ASSERT(ok == ref_utf8(text, len));
+        }
+    }
+    h11_simd_force(h11_simd_supported());
+    PASS();
+}
+
+static void test_mask_offsets(void) {
+    TEST(mask_matches_reference_every_level);
+    char data[300], want[300];
+    FOR_EACH_LEVEL(lv) {
+        h11_simd_force((h11_simd_level_t)lv);
+        for (usize len = 0; len <= 260; len += 1 + len / 16) {
+            for (u64 off = 0; off < 6; off++) {
+                for (usize i = 0; i < len; i++) {
+                    data[i] = (char)(i * 13 + off);
+                    want[i] = (char)(data[i] ^ mask[(off + i) & 3]);
+                }
+                h11_ws_mask(data, len, mask, off);
+                ASSERT(memcmp(data, want, len) == 0);
+            }
+        }
+    }
+    h11_simd_force(h11_simd_supported());
+    PASS();
+}
+
+int main(void) {
+    parser = h11_parser_new(NULL);
+    if (parser == NULL)
+        return 1;
+
+    printf("=== handshake ===\n");
+    test_accept();
+    test_handshake_rejects();
+
+    printf("=== frames ===\n");
+    test_frame_header();
+    test_parse_messages();
+    test_parse_errors();
+
+    printf("=== unmasking and utf-8 ===\n");
+    test_utf8_random();
+    test_mask_offsets();
+
+    h11_parser_free(parser);
+    printf("\n--- Results: %d passed, %d failed ---\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
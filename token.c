@@ -0,0 +1,138 @@
+/*
+ * token.c — Comma-separated list iteration (RFC 9110 S5.6.1) with optional
+ *           parameters and q-value weights (RFC 9110 S12.4.2)
+ */
+#include "h11_internal.h"
+#include <string.h>
+
+void h11_token_iter_init(h11_token_iter_t *it, const char *base, h11_span_t value) {
+    if (it == NULL)
+        return;
+    it->base = base;
+    it->pos = value.off;
+    it->end = value.off + value.len;
+}
+
+/* End of the list element starting at i: the next ',' outside a
+ * quoted-string, or end. Quoted-strings only occur inside parameters, so the
+ * common case is a single find_char2 jump. */
+static u32 element_end(const char *base, u32 i, u32 end) {
+    for (;;) {
+        i += (u32)h11_find_char2(base + i, end - i, ',', '"');
+        if (i >= end || base[i] == ',')
+            return i;
+        for (i++; i < end && base[i] != '"'; i++) {
+            if (base[i] == '\\' && i + 1 < end)
+                i++;
+        }
+        if (i >= end)
+            return end;
+        i++;
+    }
+}
+
+/* qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] ), in
+ * thousandths. */
+static bool parse_qvalue(const char *p, u32 len, u16 *out) {
+    if (len == 0 || len > 5 || (p[0] != '0' && p[0] != '1'))
+        return false;
+    u32 v = (u32)(p[0] - '0') * 1000;
+    if (len > 1) {
+        if (p[1] != '.')
+            return false;
+        u32 scale = 100;
+        for (u32 i = 2; i < len; i++, scale /= 10) {
+            if (!h11_is_digit(p[i]))
+                return false;
+            v += (u32)(p[i] - '0') * scale;
+        }
+    }
+    if (v > 1000)
+        return false;
+    *out = (u16)v;
+    return true;
+}
+
+/* Find a "q" parameter among the ';'-separated parameters in [i, end). */
+static void parse_weight(const char *base, u32 i, u32 end, h11_token_t *tok) {
+    while (i < end) {
+        u32 semi = i + (u32)h11_find_char(base + i, end - i, ';');
+        u32 s = i, e = semi;
+        i = semi + 1;
+        while (s < e && h11_is_ows(base[s]))
+            s++;
+        if (e - s < 2 || (base[s] | 0x20) != 'q')
+            continue;
+        u32 k = s + 1;
+        while (k < e && h11_is_ows(base[k]))
+            k++;
+        if (k == e || base[k] != '=')
+            continue;
+        k++;
+        while (k < e && h11_is_ows(base[k]))
+            k++;
+        while (e > k && h11_is_ows(base[e - 1]))
+            e--;
+        if (!parse_qvalue(base + k, e - k, &tok->weight)) {
+            tok->weight = 0;
+            tok->flags |= H11_TOKEN_F_BAD_WEIGHT;
+        }
+        return;
+    }
+}
+
+bool h11_token_next(h11_token_iter_t *it, h11_token_t *tok) {
+    if (it == NULL || tok == NULL || it->base == NULL)
+        return false;
+    const char *base = it->base;
+    while (it->pos < it->end) {
+        u32 s = it->pos;
+        u32 e = element_end(base, s, it->end);
+        it->pos = e < it->end ? e + 1 : it->end;
+        while (s < e && h11_is_ows(base[s]))
+            s++;
+        while (e > s && h11_is_ows(base[e - 1]))
+            e--;
+        if (s == e)
+            continue;
+        u32 semi = s + (u32)h11_find_char(base + s, e - s, ';');
+        u32 te = semi;
+        while (te > s && h11_is_ows(base[te - 1]))
+            te--;
+        /* A parameter with no token (";q=0.5") names nothing. */
+        if (te == s)
+            continue;
+        tok->token.off = s;
+        tok->token.len = te - s;
+        tok->weight = 1000;
+        tok->flags = 0;
+        if (semi < e) {
+            u32 ps = semi + 1;
+            while (ps < e && h11_is_ows(base[ps]))
+                ps++;
+            tok->params.off = ps;
+            tok->params.len = e - ps;
+            tok->flags |= H11_TOKEN_F_HAS_PARAMS;
+            parse_weight(base, ps, e, tok);
+        } else {
+            tok->params.off = e;
+            tok->params.len = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool h11_token_list_has(const char *base, h11_span_t value, const char *token) {
+    if (base == NULL || token == NULL)
+        return false;
+    usize tlen = strlen(token);
+    h11_token_iter_t it;
+    h11_token_t tok;
+    h11_token_iter_init(&it, base, value);
+    while (h11_token_next(&it, &tok)) {
+        if (h11_span_eq_case(base, tok.token, token, tlen))
+            return true;
+    }
+    return false;
+}
@@ -72,51 +72,87 @@ int h11_hexval(char c) {
 }
 
 #define H11_ERROR_LIST(X) \
-    X(H11_OK, "H11_OK", "Success") \
-    X(H11_NEED_MORE_DATA, "H11_NEED_MORE_DATA", "Need more data") \
-    X(H11_ERR_INVALID_METHOD, "H11_ERR_INVALID_METHOD", "Invalid HTTP method") \
-    X(H11_ERR_INVALID_TARGET, "H11_ERR_INVALID_TARGET", "Invalid request target") \
-    X(H11_ERR_INVALID_VERSION, "H11_ERR_INVALID_VERSION", "Invalid HTTP version") \
-    X(H11_ERR_REQUEST_LINE_TOO_LONG, "H11_ERR_REQUEST_LINE_TOO_LONG", "Request line too long") \
-    X(H11_ERR_INVALID_CRLF, "H11_ERR_INVALID_CRLF", "Invalid line ending") \
-    X(H11_ERR_INVALID_HEADER_NAME, "H11_ERR_INVALID_HEADER_NAME", "Invalid header name") \
-    X(H11_ERR_INVALID_HEADER_VALUE, "H11_ERR_INVALID_HEADER_VALUE", "Invalid header value") \
-    X(H11_ERR_HEADER_LINE_TOO_LONG, "H11_ERR_HEADER_LINE_TOO_LONG", "Header line too long") \
-    X(H11_ERR_TOO_MANY_HEADERS, "H11_ERR_TOO_MANY_HEADERS", "Too many headers") \
-    X(H11_ERR_HEADERS_TOO_LARGE, "H11_ERR_HEADERS_TOO_LARGE", "Headers section too large") \
-    X(H11_ERR_OBS_FOLD_REJECTED, "H11_ERR_OBS_FOLD_REJECTED", "Obsolete line folding rejected") \
-    X(H11_ERR_LEADING_WHITESPACE, "H11_ERR_LEADING_WHITESPACE", "Leading whitespace in header section") \
-    X(H11_ERR_MISSING_HOST, "H11_ERR_MISSING_HOST", "Missing Host header") \
-    X(H11_ERR_MULTIPLE_HOST, "H11_ERR_MULTIPLE_HOST", "Multiple Host headers") \
-    X(H11_ERR_INVALID_HOST, "H11_ERR_INVALID_HOST", "Invalid Host header value") \
-    X(H11_ERR_INVALID_CONTENT_LENGTH, "H11_ERR_INVALID_CONTENT_LENGTH", "Invalid Content-Length value") \
-    X(H11_ERR_MULTIPLE_CONTENT_LENGTH, "H11_ERR_MULTIPLE_CONTENT_LENGTH", "Conflicting Content-Length values") \
-    X(H11_ERR_CONTENT_LENGTH_OVERFLOW, "H11_ERR_CONTENT_LENGTH_OVERFLOW", "Content-Length value overflow") \
-    X(H11_ERR_INVALID_TRANSFER_ENCODING, "H11_ERR_INVALID_TRANSFER_ENCODING", "Invalid Transfer-Encoding") \
-    X(H11_ERR_TE_NOT_CHUNKED_FINAL, "H11_ERR_TE_NOT_CHUNKED_FINAL", "Transfer-Encoding final coding is not chunked") \
-    X(H11_ERR_TE_CL_CONFLICT, "H11_ERR_TE_CL_CONFLICT", "Transfer-Encoding and Content-Length both present") \
-    X(H11_ERR_UNKNOWN_TRANSFER_CODING, "H11_ERR_UNKNOWN_TRANSFER_CODING", "Unknown transfer coding") \
-    X(H11_ERR_BODY_TOO_LARGE, "H11_ERR_BODY_TOO_LARGE", "Body exceeds maximum size") \
-    X(H11_ERR_INVALID_CHUNK_SIZE, "H11_ERR_INVALID_CHUNK_SIZE", "Invalid chunk size") \
-    X(H11_ERR_CHUNK_SIZE_OVERFLOW, "H11_ERR_CHUNK_SIZE_OVERFLOW", "Chunk size overflow") \
-    X(H11_ERR_INVALID_CHUNK_EXT, "H11_ERR_INVALID_CHUNK_EXT", "Invalid chunk extension") \
-    X(H11_ERR_CHUNK_EXT_TOO_LONG, "H11_ERR_CHUNK_EXT_TOO_LONG", "Chunk extension too long") \
-    X(H11_ERR_INVALID_CHUNK_DATA, "H11_ERR_INVALID_CHUNK_DATA", "Invalid chunk data") \
-    X(H11_ERR_INVALID_TRAILER, "H11_ERR_INVALID_TRAILER", "Invalid trailer field") \
-    X(H11_ERR_CONNECTION_CLOSED, "H11_ERR_CONNECTION_CLOSED", "Connection closed") \
-    X(H11_ERR_INTERNAL, "H11_ERR_INTERNAL", "Internal error")
-
-#define H11_ERR_NAME(e, n, m) [e] = n,
+    X(H11_OK, "H11_OK", "Success", 0) \
+    X(H11_NEED_MORE_DATA, "H11_NEED_MORE_DATA", "Need more data", 0) \
+    X(H11_ERR_INVALID_METHOD, "H11_ERR_INVALID_METHOD", "Invalid HTTP method", 400) \
+    X(H11_ERR_INVALID_TARGET, "H11_ERR_INVALID_TARGET", "Invalid request target", 400) \
+    X(H11_ERR_INVALID_VERSION, "H11_ERR_INVALID_VERSION", "Invalid HTTP version", 400) \
+    X(H11_ERR_REQUEST_LINE_TOO_LONG, "H11_ERR_REQUEST_LINE_TOO_LONG", "Request line too long", 400) \
+    X(H11_ERR_INVALID_CRLF, "H11_ERR_INVALID_CRLF", "Invalid line ending", 400) \
+    X(H11_ERR_INVALID_HEADER_NAME, "H11_ERR_INVALID_HEADER_NAME", "Invalid header name", 400) \
+    X(H11_ERR_INVALID_HEADER_VALUE, "H11_ERR_INVALID_HEADER_VALUE", "Invalid header value", 400) \
+    X(H11_ERR_HEADER_LINE_TOO_LONG, "H11_ERR_HEADER_LINE_TOO_LONG", "Header line too long", 400) \
+    X(H11_ERR_TOO_MANY_HEADERS, "H11_ERR_TOO_MANY_HEADERS", "Too many headers", 431) \
+    X(H11_ERR_HEADERS_TOO_LARGE, "H11_ERR_HEADERS_TOO_LARGE", "Headers section too large", 431) \
+    X(H11_ERR_OBS_FOLD_REJECTED, "H11_ERR_OBS_FOLD_REJECTED", "Obsolete line folding rejected", 400) \
+    X(H11_ERR_LEADING_WHITESPACE, "H11_ERR_LEADING_WHITESPACE", "Leading whitespace in header section", 400) \
+    X(H11_ERR_MISSING_HOST, "H11_ERR_MISSING_HOST", "Missing Host header", 400) \
+    X(H11_ERR_MULTIPLE_HOST, "H11_ERR_MULTIPLE_HOST", "Multiple Host headers", 400) \
+    X(H11_ERR_INVALID_HOST, "H11_ERR_INVALID_HOST", "Invalid Host header value", 400) \
+    X(H11_ERR_INVALID_CONTENT_LENGTH, "H11_ERR_INVALID_CONTENT_LENGTH", "Invalid Content-Length value", 400) \
+    X(H11_ERR_MULTIPLE_CONTENT_LENGTH, "H11_ERR_MULTIPLE_CONTENT_LENGTH", "Conflicting Content-Length values", 400) \
+    X(H11_ERR_CONTENT_LENGTH_OVERFLOW, "H11_ERR_CONTENT_LENGTH_OVERFLOW", "Content-Length value overflow", 400) \
+    X(H11_ERR_INVALID_TRANSFER_ENCODING, "H11_ERR_INVALID_TRANSFER_ENCODING", "Invalid Transfer-Encoding", 400) \
+    X(H11_ERR_TE_NOT_CHUNKED_FINAL, "H11_ERR_TE_NOT_CHUNKED_FINAL", "Transfer-Encoding final coding is not chunked", 400) \
+    X(H11_ERR_TE_CL_CONFLICT, "H11_ERR_TE_CL_CONFLICT", "Transfer-Encoding and Content-Length both present", 400) \
+    X(H11_ERR_UNKNOWN_TRANSFER_CODING, "H11_ERR_UNKNOWN_TRANSFER_CODING", "Unknown transfer coding", 501) \
+    X(H11_ERR_BODY_TOO_LARGE, "H11_ERR_BODY_TOO_LARGE", "Body exceeds maximum size", 413) \
+    X(H11_ERR_INVALID_CHUNK_SIZE, "H11_ERR_INVALID_CHUNK_SIZE", "Invalid chunk size", 400) \
+    X(H11_ERR_CHUNK_SIZE_OVERFLOW, "H11_ERR_CHUNK_SIZE_OVERFLOW", "Chunk size overflow", 400) \
+    X(H11_ERR_INVALID_CHUNK_EXT, "H11_ERR_INVALID_CHUNK_EXT", "Invalid chunk extension", 400) \
+    X(H11_ERR_CHUNK_EXT_TOO_LONG, "H11_ERR_CHUNK_EXT_TOO_LONG", "Chunk extension too long", 400) \
+    X(H11_ERR_INVALID_CHUNK_DATA, "H11_ERR_INVALID_CHUNK_DATA", "Invalid chunk data", 400) \
+    X(H11_ERR_INVALID_TRAILER, "H11_ERR_INVALID_TRAILER", "Invalid trailer field", 400) \
+    X(H11_ERR_INVALID_FORM_ENCODING, "H11_ERR_INVALID_FORM_ENCODING", "Invalid form-urlencoded escape", 400) \
+    X(H11_ERR_FORM_FIELD_TOO_LONG, "H11_ERR_FORM_FIELD_TOO_LONG", "Form field exceeds decode buffer", 413) \
+    X(H11_ERR_INVALID_RANGE, "H11_ERR_INVALID_RANGE", "Invalid Range header", 0) \
+    X(H11_ERR_RANGE_NOT_SATISFIABLE, "H11_ERR_RANGE_NOT_SATISFIABLE", "Range not satisfiable", 416) \
+    X(H11_ERR_TOO_MANY_RANGES, "H11_ERR_TOO_MANY_RANGES", "Too many ranges after coalescing", 0) \
+    X(H11_ERR_WS_HANDSHAKE, "H11_ERR_WS_HANDSHAKE", "Invalid WebSocket handshake", 400) \
+    X(H11_ERR_WS_VERSION, "H11_ERR_WS_VERSION", "Unsupported WebSocket version", 426) \
+    X(H11_ERR_WS_PROTOCOL, "H11_ERR_WS_PROTOCOL", "WebSocket protocol violation", 0) \
+    X(H11_ERR_WS_INVALID_UTF8, "H11_ERR_WS_INVALID_UTF8", "Invalid UTF-8 in WebSocket text", 0) \
+    X(H11_ERR_WS_MESSAGE_TOO_LARGE, "H11_ERR_WS_MESSAGE_TOO_LARGE", "WebSocket message too large", 0) \
+    X(H11_ERR_CONNECTION_CLOSED, "H11_ERR_CONNECTION_CLOSED", "Connection closed", 0) \
+    X(H11_ERR_INTERNAL, "H11_ERR_INTERNAL", "Internal error", 500)
+
+#define H11_ERR_NAME(e, n, m, s) [e] = n,
 static const char *const error_names[H11_ERR__COUNT] = {
     H11_ERROR_LIST(H11_ERR_NAME)
 };
 #undef H11_ERR_NAME
 
-#define H11_ERR_MSG(e, n, m) [e] = m,
+#define H11_ERR_MSG(e, n, m, s) [e] = m,
 static const char *const error_messages[H11_ERR__COUNT] = {
     H11_ERROR_LIST(H11_ERR_MSG)
 };
 #undef H11_ERR_MSG
+
+/* One constant response per status in spec S8; errors that are not a
+ * rejection (status 0) have none. */
+#define H11_RESP(code, reason) \
+    "HTTP/1.1 " #code " " reason "\r\nConnection: close\r\nContent-Length: 0\r\n\r\n"
+#define H11_RESP_0   ""
+#define H11_RESP_400 H11_RESP(400, "Bad Request")
+#define H11_RESP_413 H11_RESP(413, "Content Too Large")
+#define H11_RESP_416 H11_RESP(416, "Range Not Satisfiable")
+#define H11_RESP_426 "HTTP/1.1 426 Upgrade Required\r\nUpgrade: websocket\r\n" \
+                     "Sec-WebSocket-Version: 13\r\nConnection: close\r\nContent-Length: 0\r\n\r\n"
+#define H11_RESP_431 H11_RESP(431, "Request Header Fields Too Large")
+#define H11_RESP_500 H11_RESP(500, "Internal Server Error")
+#define H11_RESP_501 H11_RESP(501, "Not Implemented")
+
+typedef struct {
+    const char *text;
+    u16         len;
+    u16         status;
+} error_response_t;
+
+#define H11_ERR_RESP(e, n, m, s) [e] = { H11_RESP_##s, sizeof(H11_RESP_##s) - 1, s },
+static const error_response_t error_responses[H11_ERR__COUNT] = {
+    H11_ERROR_LIST(H11_ERR_RESP)
+};
+#undef H11_ERR_RESP
 #undef H11_ERROR_LIST
 
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
@@ -124,6 +160,8 @@ _Static_assert(H11_ARRAY_LEN(error_names) == H11_ERR__COUNT,
                "error_names must match h11_error_t");
 _Static_assert(H11_ARRAY_LEN(error_messages) == H11_ERR__COUNT,
                "error_messages must match h11_error_t");
+_Static_assert(H11_ARRAY_LEN(error_responses) == H11_ERR__COUNT,
+               "error_responses must match h11_error_t");
 #endif
 
 const char *h11_error_name(h11_error_t error) {
@@ -138,6 +176,23 @@ const char *h11_error_message(h11_error_t error) {
     return error_messages[error];
 }
 
+u16 h11_error_status(h11_error_t error) {
+    if ((unsigned)error >= H11_ERR__COUNT)
+        return 0;
+    return error_responses[error].status;
+}
+
+const char *h11_error_response(h11_error_t error, usize *len) {
+    if ((unsigned)error >= H11_ERR__COUNT || error_responses[error].len == 0) {
+        if (len != NULL)
+            *len = 0;
+        return NULL;
+    }
+    if (len != NULL)
+        *len = error_responses[error].len;
+    return error_responses[error].text;
+}
+
 h11_config_t h11_config_default(void) {
     return (h11_config_t){
         .max_body_size = UINT64_MAX,
@@ -153,10 +208,6 @@ h11_config_t h11_config_default(void) {
     };
 }
 
-H11_INLINE u8 h11_ascii_fold(u8 c) {
-    return (c >= 'A' && c <= 'Z') ? (u8)(c | 0x20u) : c;
-}
-
 bool h11_span_eq_case(const char *base, h11_span_t a, const char *b, usize blen) {
     if (base == NULL || b == NULL || a.len != blen)
         return false;
@@ -174,13 +225,48 @@ bool h11_header_name_eq(const char *base, h11_span_t name, const char *cmp) {
 }
 
 int h11_find_header(const h11_request_t *req, const char *base, const char *name) {
+    return h11_find_header_next(req, base, name, -1);
+}
+
+int h11_find_header_next(const h11_request_t *req, const char *base, const char *name,
+                         int prev) {
     if (req == NULL || base == NULL || name == NULL || req->headers == NULL)
         return -1;
-    if (req->header_count > (u32)INT_MAX)
+    if (req->header_count > (u32)INT_MAX || prev < -1)
         return -1;
-    for (u32 i = 0; i < req->header_count; i++) {
-        if (h11_header_name_eq(base, req->headers[i].name, name))
-            return (int)i;
+    usize nlen = strlen(name);
+    for (u32 i = (u32)(prev + 1); i < req->header_count; i++) {
+        const h11_header_t *h = &req->headers[i];
+        if (!h11_span_eq_case(base, h->name, name, nlen))
+            continue;
+        /* A lazy field is checked when it matches; one that turns out
+         * malformed is skipped as if absent. */
+        if ((h->flags & H11_HEADER_F_LAZY) && h11_header_validate(req, base, i) != H11_OK)
+            continue;
+        return (int)i;
     }
     return -1;
 }
+
+void h11_header_iter_init(h11_header_iter_t *it, const h11_request_t *req, const char *base) {
+    if (it == NULL)
+        return;
+    it->req = req;
+    it->base = base;
+    it->pos = 0;
+}
+
+/* Yields every field in order; NULL at the end. A lazy field comes back as
+ * a checked copy in the iterator, with H11_HEADER_F_INVALID set when it is
+ * malformed. */
+const h11_header_t *h11_header_next(h11_header_iter_t *it) {
+    if (it == NULL || it->req == NULL || it->base == NULL || it->pos >= it->req->header_count)
+        return NULL;
+    u32 i = it->pos++;
+    const h11_header_t *h = &it->req->headers[i];
+    if (!(h->flags & H11_HEADER_F_LAZY))
+        return h;
+    it->cur = *h;
+    it->cur.flags = h11_header_validate(it->req, it->base, i) == H11_OK ? 0 : H11_HEADER_F_INVALID;
+    return &it->cur;
+}
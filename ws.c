@@ -0,0 +1,461 @@
+/*
+ * ws.c — WebSocket (RFC 6455): opening handshake validation with
+ *        Sec-WebSocket-Accept, a streaming frame parser that unmasks in
+ *        place and validates text as UTF-8, and frame header serialization
+ */
+#include "h11_internal.h"
+#include <string.h>
+
+enum { WS_HEADER = 0, WS_PAYLOAD, WS_CONTROL, WS_CLOSED, WS_ERROR };
+
+/* ---- SHA-1 and base64 (handshake only) ---- */
+
+H11_INLINE u32 rol32(u32 v, unsigned n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+static void sha1_block(u32 h[5], const u8 *p) {
+    u32 w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = (u32)p[4 * i] << 24 | (u32)p[4 * i + 1] << 16 | (u32)p[4 * i + 2] << 8 |
+               (u32)p[4 * i + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        u32 f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999u;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1u;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDCu;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6u;
+        }
+        u32 t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/* Digest of a message short enough to pad within two blocks. */
+static void sha1_short(const u8 *msg, usize len, u8 out[20]) {
+    u32 h[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+    u8 buf[128] = { 0 };
+    usize blocks = len + 9 <= 64 ? 1 : 2;
+    memcpy(buf, msg, len);
+    buf[len] = 0x80;
+    u64 bits = (u64)len * 8;
+    for (int i = 0; i < 8; i++)
+        buf[blocks * 64 - 1 - i] = (u8)(bits >> (8 * i));
+    for (usize i = 0; i < blocks; i++)
+        sha1_block(h, buf + 64 * i);
+    for (int i = 0; i < 20; i++)
+        out[i] = (u8)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static const char b64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int b64_value(char c) {
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    return c == '+' ? 62 : c == '/' ? 63 : -1;
+}
+
+/* 20 bytes -> 28 characters, the last one padding. */
+static void b64_digest(const u8 in[20], char *out) {
+    for (int i = 0, o = 0; i < 20; i += 3, o += 4) {
+        u32 v = (u32)in[i] << 16 | (u32)in[i + 1] << 8 | (i + 2 < 20 ? in[i + 2] : 0u);
+        out[o] = b64_alphabet[v >> 18];
+        out[o + 1] = b64_alphabet[(v >> 12) & 63];
+        out[o + 2] = b64_alphabet[(v >> 6) & 63];
+        out[o + 3] = i + 2 < 20 ? b64_alphabet[v & 63] : '=';
+    }
+}
+
+/* ---- handshake ---- */
+
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static const char ws_101[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                             "Upgrade: websocket\r\n"
+                             "Connection: Upgrade\r\n"
+                             "Sec-WebSocket-Accept: ";
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+_Static_assert(sizeof(ws_101) - 1 + H11_WS_ACCEPT_LEN + 4 == H11_WS_RESPONSE_LEN,
+               "H11_WS_RESPONSE_LEN must match the 101 reply");
+#endif
+
+static bool field_has_token(const h11_request_t *req, const char *base, const char *name,
+                            const char *token) {
+    for (int i = h11_find_header_next(req, base, name, -1); i >= 0;
+         i = h11_find_header_next(req, base, name, i)) {
+        if (h11_token_list_has(base, req->headers[i].value, token))
+            return true;
+    }
+    return false;
+}
+
+/* The only field value of name, or false when it is absent or repeated. */
+static bool field_once(const h11_request_t *req, const char *base, const char *name,
+                       h11_span_t *v) {
+    int i = h11_find_header(req, base, name);
+    if (i < 0 || h11_find_header_next(req, base, name, i) >= 0)
+        return false;
+    *v = req->headers[i].value;
+    return true;
+}
+
+/* A nonce is 16 bytes in canonical base64: 22 characters, the last one
+ * carrying no stray bits, then "==". */
+static bool ws_key_ok(const char *k, u32 len) {
+    if (len != 24 || k[22] != '=' || k[23] != '=')
+        return false;
+    for (int i = 0; i < 22; i++) {
+        if (b64_value(k[i]) < 0)
+            return false;
+    }
+    return (b64_value(k[21]) & 0x0F) == 0;
+}
+
+/* Checks an opening handshake (RFC 6455 S4.2.1) and writes the 28-byte
+ * Sec-WebSocket-Accept value. H11_ERR_WS_VERSION asks for the 426 reply
+ * that names version 13; every other failure is H11_ERR_WS_HANDSHAKE. */
+h11_error_t h11_ws_accept(const h11_request_t *req, const char *base, char *accept) {
+    if (req == NULL || base == NULL || accept == NULL)
+        return H11_ERR_INTERNAL;
+    h11_span_t key, version;
+    if (req->method.len != 3 || memcmp(base + req->method.off, "GET", 3) != 0 ||
+        req->version < 0x0101 || !field_has_token(req, base, "upgrade", "websocket") ||
+        !field_has_token(req, base, "connection", "upgrade") ||
+        !field_once(req, base, "sec-websocket-key", &key) ||
+        !ws_key_ok(base + key.off, key.len))
+        return H11_ERR_WS_HANDSHAKE;
+    if (!field_once(req, base, "sec-websocket-version", &version))
+        return h11_find_header(req, base, "sec-websocket-version") < 0 ? H11_ERR_WS_HANDSHAKE
+                                                                       : H11_ERR_WS_VERSION;
+    if (version.len != 2 || memcmp(base + version.off, "13", 2) != 0)
+        return H11_ERR_WS_VERSION;
+    u8 msg[24 + sizeof(ws_guid) - 1];
+    u8 digest[20];
+    memcpy(msg, base + key.off, 24);
+    memcpy(msg + 24, ws_guid, sizeof(ws_guid) - 1);
+    sha1_short(msg, sizeof(msg), digest);
+    b64_digest(digest, accept);
+    return H11_OK;
+}
+
+/* Writes the H11_WS_RESPONSE_LEN-byte 101 reply for an accept value. */
+usize h11_ws_response(const char *accept, char *out) {
+    if (accept == NULL || out == NULL)
+        return 0;
+    memcpy(out, ws_101, sizeof(ws_101) - 1);
+    memcpy(out + sizeof(ws_101) - 1, accept, H11_WS_ACCEPT_LEN);
+    memcpy(out + sizeof(ws_101) - 1 + H11_WS_ACCEPT_LEN, "\r\n\r\n", 4);
+    return H11_WS_RESPONSE_LEN;
+}
+
+/* ---- UTF-8 ----
+ *
+ * A byte-at-a-time DFA whose state survives frame and read boundaries. ASCII
+ * runs are skipped with h11_find_nonascii, so only multi-byte sequences go
+ * through the state machine. States 1-3 count continuation bytes still due;
+ * the others constrain the second byte (RFC 3629 S4). */
+
+enum { U8_OK = 0, U8_1, U8_2, U8_3, U8_E0, U8_ED, U8_F0, U8_F4, U8_BAD };
+
+static u8 utf8_step(u8 s, u8 c) {
+    switch (s) {
+    case U8_OK:
+        if (c < 0x80)
+            return U8_OK;
+        if (c >= 0xC2 && c <= 0xDF)
+            return U8_1;
+        if (c == 0xE0)
+            return U8_E0;
+        if (c == 0xED)
+            return U8_ED;
+        if (c >= 0xE1 && c <= 0xEF)
+            return U8_2;
+        if (c == 0xF0)
+            return U8_F0;
+        if (c >= 0xF1 && c <= 0xF3)
+            return U8_3;
+        return c == 0xF4 ? U8_F4 : U8_BAD;
+    case U8_E0: return c >= 0xA0 && c <= 0xBF ? U8_1 : U8_BAD;
+    case U8_ED: return c >= 0x80 && c <= 0x9F ? U8_1 : U8_BAD;
+    case U8_F0: return c >= 0x90 && c <= 0xBF ? U8_2 : U8_BAD;
+    case U8_F4: return c >= 0x80 && c <= 0x8F ? U8_2 : U8_BAD;
+    default:    return (c & 0xC0) == 0x80 ? (u8)(s - 1) : U8_BAD;
+    }
+}
+
+static u8 utf8_run(u8 s, const char *p, usize n) {
+    usize i = 0;
+    while (i < n) {
+        u8 c = (u8)p[i];
+        if (s == U8_OK && c < 0x80) {
+            i += h11_find_nonascii(p + i, n - i);
+            continue;
+        }
+        s = utf8_step(s, c);
+        if (s == U8_BAD)
+            return s;
+        i++;
+    }
+    return s;
+}
+
+/* ---- frames ---- */
+
+H11_INLINE u32 key_advance(u32 key, u64 n) {
+    unsigned sh = (unsigned)(n & 3) * 8;
+    return sh == 0 ? key : (key >> sh) | (key << (32 - sh));
+}
+
+void h11_ws_init(h11_ws_t *ws, bool server, u64 max_message) {
+    if (ws == NULL)
+        return;
+    h11_init();
+    memset(ws, 0, offsetof(h11_ws_t, ctrl));
+    ws->server = server;
+    ws->max_message = max_message;
+}
+
+static h11_error_t ws_fail(h11_ws_t *ws, h11_error_t err) {
+    ws->state = WS_ERROR;
+    ws->last_error = err;
+    return err;
+}
+
+static usize header_size(u8 b1) {
+    u8 l = b1 & 0x7F;
+    return 2 + (l == 126 ? 2 : l == 127 ? 8 : 0) + (b1 & 0x80 ? 4 : 0);
+}
+
+/* Decodes a complete header and sets up the frame (RFC 6455 S5.2). */
+static h11_error_t ws_begin(h11_ws_t *ws, const u8 *h) {
+    bool fin = (h[0] & 0x80) != 0;
+    u8 op = h[0] & 0x0F;
+    bool masked = (h[1] & 0x80) != 0;
+    if ((h[0] & 0x70) != 0 || masked != ws->server)
+        return H11_ERR_WS_PROTOCOL;
+    u64 len = h[1] & 0x7F;
+    const u8 *p = h + 2;
+    if (len == 126) {
+        len = (u64)p[0] << 8 | p[1];
+        p += 2;
+        if (len < 126)
+            return H11_ERR_WS_PROTOCOL;
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 0; i < 8; i++)
+            len = len << 8 | p[i];
+        p += 8;
+        if (len >> 63 || len <= 0xFFFF)
+            return H11_ERR_WS_PROTOCOL;
+    }
+    ws->key = masked ? (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24 : 0;
+    if (op >= H11_WS_CLOSE) {
+        if (op > H11_WS_PONG || !fin || len > H11_WS_CONTROL_MAX)
+            return H11_ERR_WS_PROTOCOL;
+        ws->ctrl_len = 0;
+        ws->state = WS_CONTROL;
+    } else {
+        if (op > H11_WS_BINARY || (op == H11_WS_CONTINUATION) != (ws->message != 0))
+            return H11_ERR_WS_PROTOCOL;
+        if (op != H11_WS_CONTINUATION) {
+            ws->message = op;
+            ws->message_len = 0;
+            ws->utf8 = U8_OK;
+        }
+        if (len > ws->max_message - ws->message_len)
+            return H11_ERR_WS_MESSAGE_TOO_LARGE;
+        ws->state = WS_PAYLOAD;
+    }
+    ws->opcode = op;
+    ws->fin = fin;
+    ws->length = ws->remaining = len;
+    return H11_OK;
+}
+
+/* Headers that arrive whole are decoded where they lie; split ones are
+ * gathered in ws->hdr first. */
+static h11_error_t ws_header(h11_ws_t *ws, const char *data, usize len, usize *pos) {
+    if (ws->hdr_len == 0 && len >= 2 && len >= header_size((u8)data[1])) {
+        *pos = header_size((u8)data[1]);
+        return ws_begin(ws, (const u8 *)data);
+    }
+    usize need = ws->hdr_len < 2 ? 2 : header_size(ws->hdr[1]);
+    while (ws->hdr_len < need) {
+        usize n = need - ws->hdr_len < len - *pos ? need - ws->hdr_len : len - *pos;
+        memcpy(ws->hdr + ws->hdr_len, data + *pos, n);
+        ws->hdr_len += (u8)n;
+        *pos += n;
+        if (ws->hdr_len < need)
+            return H11_NEED_MORE_DATA;
+        if (need == 2)
+            need = header_size(ws->hdr[1]);
+    }
+    ws->hdr_len = 0;
+    return ws_begin(ws, ws->hdr);
+}
+
+static bool close_code_ok(u16 code) {
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) ||
+           (code >= 3000 && code <= 4999);
+}
+
+/* Consumes frame bytes from data and reports at most one step in *frame:
+ * the payload bytes of the current data frame found in data (possibly none,
+ * for an empty frame), or a whole control frame. Payload is unmasked in
+ * place, so data must be writable.
+ *
+ * Returns H11_OK with *frame filled, H11_NEED_MORE_DATA once data is used
+ * up without a step to report (*consumed may still be non-zero: header and
+ * control bytes are kept in ws). Errors are sticky; h11_ws_close_code gives
+ * the close status to send. After a close frame every call returns
+ * H11_ERR_CONNECTION_CLOSED. */
+h11_error_t h11_ws_parse(h11_ws_t *ws, char *data, usize len, usize *consumed,
+                         h11_ws_frame_t *frame) {
+    if (consumed != NULL)
+        *consumed = 0;
+    if (ws == NULL || consumed == NULL || frame == NULL || (data == NULL && len > 0))
+        return H11_ERR_INTERNAL;
+    if (ws->state == WS_ERROR)
+        return ws->last_error;
+    if (ws->state == WS_CLOSED)
+        return H11_ERR_CONNECTION_CLOSED;
+    usize pos = 0;
+    if (ws->state == WS_HEADER) {
+        h11_error_t err = ws_header(ws, data, len, &pos);
+        *consumed = pos;
+        if (err == H11_NEED_MORE_DATA)
+            return err;
+        if (err != H11_OK)
+            return ws_fail(ws, err);
+    }
+    usize avail = len - pos;
+    usize n = ws->remaining < avail ? (usize)ws->remaining : avail;
+    char *p = data + pos;
+
+    if (ws->state == WS_CONTROL) {
+        memcpy(ws->ctrl + ws->ctrl_len, p, n);
+        if (ws->server)
+            h11_mask_xor(ws->ctrl + ws->ctrl_len, n, ws->key);
+        ws->key = key_advance(ws->key, n);
+        ws->ctrl_len += (u8)n;
+        ws->remaining -= n;
+        *consumed = pos + n;
+        if (ws->remaining > 0)
+            return H11_NEED_MORE_DATA;
+        if (ws->opcode == H11_WS_CLOSE && ws->ctrl_len > 0) {
+            u16 code = (u16)((u8)ws->ctrl[0] << 8 | (u8)ws->ctrl[1]);
+            if (ws->ctrl_len < 2 || !close_code_ok(code))
+                return ws_fail(ws, H11_ERR_WS_PROTOCOL);
+            if (utf8_run(U8_OK, ws->ctrl + 2, ws->ctrl_len - 2u) != U8_OK)
+                return ws_fail(ws, H11_ERR_WS_INVALID_UTF8);
+        }
+        *frame = (h11_ws_frame_t){ .data = ws->ctrl, .len = ws->ctrl_len,
+                                   .length = ws->ctrl_len, .opcode = ws->opcode,
+                                   .message = ws->opcode, .fin = true, .end = true };
+        ws->state = ws->opcode == H11_WS_CLOSE ? WS_CLOSED : WS_HEADER;
+        return H11_OK;
+    }
+
+    if (n == 0 && ws->remaining > 0)
+        return H11_NEED_MORE_DATA;
+    if (ws->server) {
+        h11_mask_xor(p, n, ws->key);
+        ws->key = key_advance(ws->key, n);
+    }
+    ws->remaining -= n;
+    ws->message_len += n;
+    bool end = ws->remaining == 0;
+    if (ws->message == H11_WS_TEXT) {
+        ws->utf8 = utf8_run(ws->utf8, p, n);
+        if (ws->utf8 == U8_BAD || (end && ws->fin && ws->utf8 != U8_OK))
+            return ws_fail(ws, H11_ERR_WS_INVALID_UTF8);
+    }
+    *frame = (h11_ws_frame_t){ .data = p, .len = n, .length = ws->length,
+                               .opcode = ws->opcode, .message = ws->message,
+                               .fin = ws->fin, .end = end };
+    if (end) {
+        if (ws->fin)
+            ws->message = 0;
+        ws->state = WS_HEADER;
+    }
+    *consumed = pos + n;
+    return H11_OK;
+}
+
+/* Writes a frame header (2 to H11_WS_HEADER_MAX bytes) and returns its
+ * length. A client passes its 4-byte mask and masks the payload with
+ * h11_ws_mask; a server passes NULL. */
+usize h11_ws_frame_header(char *out, h11_ws_opcode_t opcode, bool fin, u64 len,
+                          const u8 *mask) {
+    if (out == NULL)
+        return 0;
+    u8 *o = (u8 *)out;
+    u8 mbit = mask != NULL ? 0x80 : 0;
+    usize n = 2;
+    o[0] = (u8)((fin ? 0x80 : 0) | (opcode & 0x0F));
+    if (len < 126) {
+        o[1] = (u8)(mbit | len);
+    } else if (len <= 0xFFFF) {
+        o[1] = mbit | 126;
+        o[2] = (u8)(len >> 8);
+        o[3] = (u8)len;
+        n = 4;
+    } else {
+        o[1] = mbit | 127;
+        for (int i = 0; i < 8; i++)
+            o[2 + i] = (u8)(len >> (56 - 8 * i));
+        n = 10;
+    }
+    if (mask != NULL) {
+        memcpy(o + n, mask, 4);
+        n += 4;
+    }
+    return n;
+}
+
+/* Masks (or unmasks) len payload bytes that start offset bytes into the
+ * frame. */
+void h11_ws_mask(char *data, usize len, const u8 *mask, u64 offset) {
+    if (data == NULL || mask == NULL)
+        return;
+    h11_init();
+    u32 key = (u32)mask[0] | (u32)mask[1] << 8 | (u32)mask[2] << 16 | (u32)mask[3] << 24;
+    h11_mask_xor(data, len, key_advance(key, offset));
+}
+
+/* Close status for a parse error (RFC 6455 S7.4.1); 0 if it is not one. */
+u16 h11_ws_close_code(h11_error_t error) {
+    switch (error) {
+    case H11_ERR_WS_PROTOCOL:          return 1002;
+    case H11_ERR_WS_INVALID_UTF8:      return 1007;
+    case H11_ERR_WS_MESSAGE_TOO_LARGE: return 1009;
+    case H11_ERR_INTERNAL:             return 1011;
+    default:                           return 0;
+    }
+}